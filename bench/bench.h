@@ -0,0 +1,162 @@
+#pragma once
+
+// Shared helpers for the scheduler benchmarks. Include after one of the scheduler
+// headers. Every benchmark prints CSV rows to stdout:
+//
+//   benchmark,policy,jobs,samples,mean,p50,p99,max,unit
+//
+// so the output of two builds can be joined on (benchmark, policy, jobs) and compared.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <math.h>
+
+static const int bench_job_counts[] = {10, 1000, 100000};
+#define BENCH_JOB_COUNTS (int)(sizeof(bench_job_counts) / sizeof(bench_job_counts[0]))
+
+typedef struct {
+    uint64_t *values;
+    int count;
+    int capacity;
+} BenchSamples;
+
+void bench_add(BenchSamples *s, uint64_t value) {
+    if (s->count == s->capacity) {
+        s->capacity = s->capacity ? s->capacity * 2 : 256;
+        s->values = (uint64_t *)realloc(s->values, s->capacity * sizeof(uint64_t));
+    }
+    s->values[s->count++] = value;
+}
+
+int bench_compare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+void bench_print_header() {
+    printf("benchmark,policy,jobs,samples,mean,p50,p99,max,unit\n");
+    fflush(stdout);
+}
+
+// Function to print one result row and release the samples
+void bench_report(const char *benchmark, const char *policy, int jobs, BenchSamples *s, const char *unit) {
+    if (s->count == 0) {
+        return;
+    }
+    qsort(s->values, s->count, sizeof(uint64_t), bench_compare);
+    double sum = 0;
+    for (int i = 0; i < s->count; i++) {
+        sum += (double)s->values[i];
+    }
+    printf("%s,%s,%d,%d,%.1f,%lu,%lu,%lu,%s\n", benchmark, policy, jobs, s->count, sum / s->count,
+           s->values[s->count / 2], s->values[(int)((s->count - 1) * 0.99)], s->values[s->count - 1], unit);
+    fflush(stdout);
+    free(s->values);
+    s->values = NULL;
+    s->count = s->capacity = 0;
+}
+
+// Function to report a single measurement
+void bench_report_value(const char *benchmark, const char *policy, int jobs, uint64_t value, const char *unit) {
+    BenchSamples s = {0};
+    bench_add(&s, value);
+    bench_report(benchmark, policy, jobs, &s, unit);
+}
+
+// Number of repetitions for probes that fork real processes (BENCH_SAMPLES, default 200)
+int bench_samples() {
+    const char *env = getenv("BENCH_SAMPLES");
+    return env != NULL && atoi(env) > 0 ? atoi(env) : 200;
+}
+
+uint64_t bench_cpu_ns() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * NS_PER_SEC +
+           (uint64_t)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000;
+}
+
+// Scheduler runs write their CSVs to the working directory and print every context
+// switch, so each run happens in a scratch directory with stdout sent to a file.
+typedef struct {
+    int saved_stdout;
+    char path[64];
+} BenchCapture;
+
+void bench_enter_scratch_dir() {
+    char dir[] = "/tmp/sched_bench_XXXXXX";
+    if (mkdtemp(dir) == NULL || chdir(dir) != 0) {
+        perror("scratch directory");
+        exit(1);
+    }
+}
+
+void bench_capture_begin(BenchCapture *c) {
+    fflush(stdout);
+    strcpy(c->path, "context_switches.txt");
+    int fd = open(c->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    c->saved_stdout = dup(STDOUT_FILENO);
+    dup2(fd, STDOUT_FILENO);
+    close(fd);
+}
+
+// Function to restore stdout, returns the number of context switches printed meanwhile
+uint64_t bench_capture_end(BenchCapture *c) {
+    fflush(stdout);
+    dup2(c->saved_stdout, STDOUT_FILENO);
+    close(c->saved_stdout);
+
+    uint64_t lines = 0;
+    char buffer[65536];
+    FILE *fp = fopen(c->path, "r");
+    size_t n;
+    while (fp != NULL && (n = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            lines += buffer[i] == '\n';
+        }
+    }
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    unlink(c->path);
+    return lines;
+}
+
+// Function to build a synthetic profile: exponential bursts (mean 15 ms) and
+// exponential inter-arrival gaps (mean 20 ms) over 50 distinct commands. The
+// generator is a fixed LCG so every build benchmarks the same workload.
+void bench_make_profile(SimProfile *profile, int n) {
+    uint64_t state = 42;
+    uint64_t arrival_ns = 0;
+    profile->jobs = (SimJob *)calloc(n, sizeof(SimJob));
+    profile->count = n;
+    profile->next_arrival = 0;
+    profile->switch_cost_ns = 0;
+
+    for (int i = 0; i < n; i++) {
+        double u1, u2;
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        u1 = ((state >> 11) + 1.0) / 9007199254740993.0;
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        u2 = ((state >> 11) + 1.0) / 9007199254740993.0;
+
+        char command[32];
+        snprintf(command, sizeof(command), "./job %d", i % 50);
+        arrival_ns += (uint64_t)(-20.0 * NS_PER_MS * log(u1));
+        profile->jobs[i].command = strdup(command);
+        profile->jobs[i].arrival_ns = arrival_ns;
+        profile->jobs[i].burst_ns = (uint64_t)(-15.0 * NS_PER_MS * log(u2));
+        profile->jobs[i].exit_status = 0;
+    }
+}
+
+void bench_free_profile(SimProfile *profile) {
+    for (int i = 0; i < profile->count; i++) {
+        free(profile->jobs[i].command);
+    }
+    free(profile->jobs);
+}
@@ -0,0 +1,130 @@
+// Process-control and queue micro-benchmarks shared by every policy:
+// spawn latency, SIGSTOP->stopped, SIGCONT->running, quantum overshoot of run_slice()
+// and Queue enqueue/dequeue cost at several depths.
+#define _GNU_SOURCE
+#include "../offline_schedulers.h"
+#include "bench.h"
+
+#include <sched.h>
+#include <sys/mman.h>
+
+// fork() until the child has exec'd /bin/sh: the close-on-exec pipe reports EOF then
+void bench_spawn(int samples) {
+    BenchSamples s = {0};
+    for (int i = 0; i < samples; i++) {
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) != 0) {
+            perror("pipe2");
+            return;
+        }
+        uint64_t start = sched_now_ns();
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            execute_command("exit 0", NULL);
+        }
+        close(fds[1]);
+        char byte;
+        while (read(fds[0], &byte, 1) > 0) {
+        }
+        bench_add(&s, sched_now_ns() - start);
+        close(fds[0]);
+        waitpid(pid, NULL, 0);
+    }
+    bench_report("spawn_latency", "all", 1, &s, "ns");
+}
+
+// The child spins on a shared counter, so "running again" is observed directly
+void bench_stop_continue(int samples) {
+    volatile uint64_t *counter = (volatile uint64_t *)mmap(NULL, sizeof(uint64_t), PROT_READ | PROT_WRITE,
+                                                           MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    *counter = 0;
+    pid_t pid = fork();
+    if (pid == 0) {
+        while (1) {
+            (*counter)++;
+        }
+    }
+    while (*counter == 0) {
+    }
+
+    BenchSamples stop = {0}, cont = {0};
+    for (int i = 0; i < samples; i++) {
+        int status;
+        uint64_t start = sched_now_ns();
+        kill(pid, SIGSTOP);
+        waitpid(pid, &status, WUNTRACED);
+        bench_add(&stop, sched_now_ns() - start);
+
+        uint64_t seen = *counter;
+        start = sched_now_ns();
+        kill(pid, SIGCONT);
+        while (*counter == seen) {
+            sched_yield();
+        }
+        bench_add(&cont, sched_now_ns() - start);
+        waitpid(pid, &status, WCONTINUED | WNOHANG);
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    munmap((void *)counter, sizeof(uint64_t));
+
+    bench_report("sigstop_to_stopped", "all", 1, &stop, "ns");
+    bench_report("sigcont_to_running", "all", 1, &cont, "ns");
+}
+
+// How far past the requested quantum run_slice() returns for a CPU-bound job
+void bench_overshoot(int samples) {
+    static const int quanta_ms[] = {1, 10};
+    job_output_mode = JOB_OUTPUT_DISCARD;
+    for (int q = 0; q < 2; q++) {
+        BenchSamples s = {0};
+        pid_t pid = -1;
+        uint64_t quantum_ns = ms_to_ns(quanta_ms[q]);
+        int rounds = samples < 50 ? samples : 50;
+        for (int i = 0; i < rounds; i++) {
+            SliceResult r = run_slice(0, &pid, "while :; do :; done", quantum_ns);
+            uint64_t length = r.end_ns - r.start_ns;
+            bench_add(&s, length > quantum_ns ? length - quantum_ns : 0);
+        }
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+
+        char name[64];
+        snprintf(name, sizeof(name), "quantum_overshoot_%dms", quanta_ms[q]);
+        bench_report(name, "all", 1, &s, "ns");
+    }
+}
+
+// Cost of one enqueue + dequeue pair while the queue holds `depth` entries
+void bench_queue_ops() {
+    for (int c = 0; c < BENCH_JOB_COUNTS; c++) {
+        int depth = bench_job_counts[c];
+        Queue *q = create_queue();
+        for (int i = 0; i < depth; i++) {
+            enqueue(q, i);
+        }
+
+        BenchSamples s = {0};
+        for (int round = 0; round < 20; round++) {
+            int ops = 100000;
+            uint64_t start = sched_now_ns();
+            for (int i = 0; i < ops; i++) {
+                enqueue(q, dequeue(q));
+            }
+            bench_add(&s, (sched_now_ns() - start) / ops);
+        }
+        free_queue(q);
+        bench_report("queue_enqueue_dequeue", "FIFO", depth, &s, "ns");
+    }
+}
+
+int main() {
+    int samples = bench_samples();
+    bench_print_header();
+    bench_spawn(samples);
+    bench_stop_continue(samples);
+    bench_overshoot(samples);
+    bench_queue_ops();
+    return 0;
+}
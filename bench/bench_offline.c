@@ -0,0 +1,196 @@
+// Scheduler overhead of the offline policies (FCFS, RR, MLFQ).
+//
+// sim_cpu_per_switch: dispatcher CPU time per context switch on the virtual clock,
+// i.e. the pure policy + bookkeeping + output cost, at 10, 1k and 100k jobs.
+// sim_cpu_per_switch_binary: the same with SCHED_SWITCH_OUTPUT=binary, context switches
+// going to the trace ring instead of stdout.
+// real_cpu_per_switch / real_wall_per_switch: the same for a small real workload,
+// where the cost of process control and of polling for the quantum shows up.
+// real_syscalls_per_switch: system calls made to run each slice (fork, signals, waits);
+// the <policy>-uring rows run the same workload on the io_uring backend (sched_uring.h).
+// real_overshoot_p99: how far the slices of CPU-bound jobs run past a 10 ms RR quantum,
+// on both backends, then again in the low-jitter mode (sched_jitter.h, -lowjitter rows;
+// the default backend only when the dispatcher gets a core of its own).
+// sim_cpu_per_switch_quiet: RR and MLFQ configured at run time against the same
+// configurations compiled in as static tables (RR-static, MLFQ-static), without any
+// context-switch output so the dispatcher loop itself is measured.
+#include "../offline_schedulers.h"
+#include "bench.h"
+
+typedef enum { RUN_FCFS, RUN_RR, RUN_MLFQ, RUN_STATIC_RR, RUN_STATIC_MLFQ } OfflinePolicy;
+static const char *policy_names[] = {"FCFS", "RR", "MLFQ", "RR-static", "MLFQ-static"};
+
+static const MlfqConfig bench_mlfq = {3, {MLFQ_MS(10), MLFQ_MS(20), MLFQ_MS(30)}, MLFQ_MS(500)};
+DEFINE_OFFLINE_MLFQ(StaticMLFQ, bench_mlfq)
+DEFINE_OFFLINE_ROUND_ROBIN(StaticRR, 10)
+
+void run_policy(OfflinePolicy policy, Process *p, int n) {
+    switch (policy) {
+        case RUN_FCFS:
+            FCFS(p, n);
+            break;
+        case RUN_RR:
+            RoundRobin(p, n, 10);
+            break;
+        case RUN_MLFQ:
+            MultiLevelFeedbackQueue(p, n, 10, 20, 30, 500);
+            break;
+        case RUN_STATIC_RR:
+            StaticRR(p, n);
+            break;
+        case RUN_STATIC_MLFQ:
+            StaticMLFQ(p, n);
+            break;
+    }
+}
+
+void bench_simulated(OfflinePolicy policy, int n, SwitchOutputMode mode) {
+    SimProfile profile;
+    bench_make_profile(&profile, n);
+    Process *p = (Process *)calloc(n, sizeof(Process));
+    for (int i = 0; i < n; i++) {
+        p[i].command = profile.jobs[i].command;
+    }
+
+    BenchCapture capture;
+    bench_capture_begin(&capture);
+    switch_output_mode = mode;
+    begin_simulation(&profile);
+    uint64_t cpu = bench_cpu_ns();
+    run_policy(policy, p, n);
+    cpu = bench_cpu_ns() - cpu;
+    end_simulation();
+    if (mode != SWITCH_OUTPUT_TEXT) {
+        trace_close();
+        unlink(TRACE_DEFAULT_PATH);
+        switch_output_mode = SWITCH_OUTPUT_TEXT;
+    }
+    uint64_t lines = bench_capture_end(&capture);
+    uint64_t switches = mode == SWITCH_OUTPUT_TEXT ? lines : sched_stats.groups[0].metrics[STAT_SLICE]->total;
+
+    bench_report_value(mode == SWITCH_OUTPUT_TEXT ? "sim_cpu_per_switch" : "sim_cpu_per_switch_binary",
+                       policy_names[policy], n, switches ? cpu / switches : 0, "ns");
+    free(p);
+    bench_free_profile(&profile);
+}
+
+void bench_real(OfflinePolicy policy, int n, bool uring) {
+    Process *p = (Process *)calloc(n, sizeof(Process));
+    for (int i = 0; i < n; i++) {
+        p[i].command = i % 2 ? "true" : "sleep 0.02";
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%s%s", policy_names[policy], uring ? "-uring" : "");
+    uring_select(uring);
+    if (uring && !uring_enabled()) {
+        free(p);
+        return;
+    }
+
+    BenchCapture capture;
+    bench_capture_begin(&capture);
+    uint64_t syscalls = slice_syscalls;
+    uint64_t cpu = bench_cpu_ns();
+    uint64_t wall = sched_now_ns();
+    run_policy(policy, p, n);
+    wall = sched_now_ns() - wall;
+    cpu = bench_cpu_ns() - cpu;
+    syscalls = slice_syscalls - syscalls;
+    uint64_t switches = bench_capture_end(&capture);
+    uring_select(false);
+
+    bench_report_value("real_cpu_per_switch", name, n, switches ? cpu / switches : 0, "ns");
+    bench_report_value("real_wall_per_switch", name, n, switches ? wall / switches : 0, "ns");
+    bench_report_value("real_syscalls_per_switch", name, n, switches ? syscalls / switches : 0, "calls");
+    free(p);
+}
+
+// Function to run CPU-bound jobs under RR and report the p99 quantum overshoot
+void bench_overshoot(const char *name, int n, bool uring) {
+    Process *p = (Process *)calloc(n, sizeof(Process));
+    for (int i = 0; i < n; i++) {
+        p[i].command = "i=0; while [ $i -lt 20000 ]; do i=$((i + 1)); done";
+    }
+    uring_select(uring);
+    if (uring && !uring_enabled()) {
+        free(p);
+        return;
+    }
+
+    BenchCapture capture;
+    bench_capture_begin(&capture);
+    RoundRobin(p, n, 10);
+    bench_capture_end(&capture);
+    uring_select(false);
+
+    Histogram *overshoot = sched_stats.groups[0].metrics[STAT_OVERSHOOT];
+    if (overshoot != NULL && overshoot->total > 0) {
+        bench_report_value("real_overshoot_p99", name, n, histogram_percentile(overshoot, 99), "ns");
+    }
+    free(p);
+}
+
+// Function to measure the overshoot in the default mode, then in the low-jitter mode,
+// which cannot be left again and so comes last
+void bench_low_jitter(int n) {
+    bench_overshoot("RR", n, false);
+    bench_overshoot("RR-uring", n, true);
+    uring_select(true);         // SCHED_FIFO on a shared core needs the io_uring backend
+    setenv("SCHED_LOW_JITTER", "1", 1);
+    low_jitter.state = 0;       // Read again by the next run
+    low_jitter_enabled();
+    if (low_jitter.cpu != -1) {
+        bench_overshoot("RR-lowjitter", n, false);
+    }
+    bench_overshoot("RR-uring-lowjitter", n, true);
+}
+
+// Runtime-configured against compile-time-configured RR and MLFQ, alternating the two
+// variants each round so drift affects both alike
+void bench_specialized(int n) {
+    static const OfflinePolicy pairs[][2] = {{RUN_RR, RUN_STATIC_RR}, {RUN_MLFQ, RUN_STATIC_MLFQ}};
+    SimProfile profile;
+    bench_make_profile(&profile, n);
+    Process *p = (Process *)calloc(n, sizeof(Process));
+    for (int i = 0; i < n; i++) {
+        p[i].command = profile.jobs[i].command;
+    }
+
+    for (int pair = 0; pair < 2; pair++) {
+        BenchSamples s[2] = {{0}, {0}};
+        for (int round = 0; round < 10; round++) {
+            for (int variant = 0; variant < 2; variant++) {
+                switch_output_mode = SWITCH_OUTPUT_NONE;
+                begin_simulation(&profile);
+                uint64_t cpu = bench_cpu_ns();
+                run_policy(pairs[pair][variant], p, n);
+                cpu = bench_cpu_ns() - cpu;
+                end_simulation();
+                uint64_t switches = sched_stats.groups[0].metrics[STAT_SLICE]->total;
+                bench_add(&s[variant], switches ? cpu / switches : 0);
+            }
+        }
+        for (int variant = 0; variant < 2; variant++) {
+            bench_report("sim_cpu_per_switch_quiet", policy_names[pairs[pair][variant]], n, &s[variant], "ns");
+        }
+    }
+    switch_output_mode = SWITCH_OUTPUT_TEXT;
+    free(p);
+    bench_free_profile(&profile);
+}
+
+int main() {
+    bench_print_header();
+    bench_enter_scratch_dir();
+    for (int policy = RUN_FCFS; policy <= RUN_MLFQ; policy++) {
+        for (int c = 0; c < BENCH_JOB_COUNTS; c++) {
+            bench_simulated((OfflinePolicy)policy, bench_job_counts[c], SWITCH_OUTPUT_TEXT);
+            bench_simulated((OfflinePolicy)policy, bench_job_counts[c], SWITCH_OUTPUT_BINARY);
+        }
+        bench_real((OfflinePolicy)policy, bench_job_counts[0], false);
+        bench_real((OfflinePolicy)policy, bench_job_counts[0], true);
+    }
+    bench_specialized(bench_job_counts[BENCH_JOB_COUNTS - 1]);
+    bench_low_jitter(bench_job_counts[0]);
+    return 0;
+}
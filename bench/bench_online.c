@@ -0,0 +1,117 @@
+// Scheduler overhead of the online policies (SJF, MLFQ), plus the SJF ready-set cost.
+//
+// sim_cpu_per_switch: dispatcher CPU time per context switch on the virtual clock at
+// 10, 1k and 100k submitted jobs. real_cpu_per_switch / real_wall_per_switch: the
+// same for a small real workload fed through stdin.
+#include "../online_schedulers.h"
+#include "bench.h"
+
+typedef enum { RUN_SJF, RUN_MLFQ } OnlinePolicy;
+static const char *policy_names[] = {"SJF", "MLFQ"};
+
+void run_policy(OnlinePolicy policy) {
+    // Each run starts from an empty process list and history
+    clear_process_list(&process_list);
+    historical_data.count = 0;
+    if (policy == RUN_SJF) {
+        ShortestJobFirst();
+    } else {
+        MultiLevelFeedbackQueue(10, 20, 30, 500);
+    }
+}
+
+void bench_simulated(OnlinePolicy policy, int n) {
+    SimProfile profile;
+    bench_make_profile(&profile, n);
+    if (max_processes < n) {
+        max_processes = n;
+    }
+
+    BenchCapture capture;
+    bench_capture_begin(&capture);
+    begin_simulation(&profile);
+    uint64_t cpu = bench_cpu_ns();
+    run_policy(policy);
+    cpu = bench_cpu_ns() - cpu;
+    end_simulation();
+    uint64_t switches = bench_capture_end(&capture);
+
+    bench_report_value("sim_cpu_per_switch", policy_names[policy], n, switches ? cpu / switches : 0, "ns");
+    bench_free_profile(&profile);
+}
+
+void bench_real(OnlinePolicy policy, int n) {
+    // Submit the whole workload up front through a pipe standing in for stdin
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        const char *line = i % 2 ? "true\n" : "sleep 0.02\n";
+        if (write(fds[1], line, strlen(line)) < 0) {
+            perror("write");
+        }
+    }
+    close(fds[1]);
+    int saved_stdin = dup(STDIN_FILENO);
+    dup2(fds[0], STDIN_FILENO);
+    close(fds[0]);
+    clearerr(stdin);
+
+    BenchCapture capture;
+    bench_capture_begin(&capture);
+    uint64_t cpu = bench_cpu_ns();
+    uint64_t wall = sched_now_ns();
+    run_policy(policy);
+    wall = sched_now_ns() - wall;
+    cpu = bench_cpu_ns() - cpu;
+    uint64_t switches = bench_capture_end(&capture);
+
+    dup2(saved_stdin, STDIN_FILENO);
+    close(saved_stdin);
+    clearerr(stdin);
+
+    bench_report_value("real_cpu_per_switch", policy_names[policy], n, switches ? cpu / switches : 0, "ns");
+    bench_report_value("real_wall_per_switch", policy_names[policy], n, switches ? wall / switches : 0, "ns");
+}
+
+// Cost of one add + pop on the SJF ready set while it holds `depth` jobs
+void bench_ready_set() {
+    for (int c = 0; c < BENCH_JOB_COUNTS; c++) {
+        int depth = bench_job_counts[c];
+        JobGroupTable ready = {0};
+        char command[32];
+        for (int i = 0; i < depth; i++) {
+            snprintf(command, sizeof(command), "./job %d", i % 50);
+            add_ready_job(&ready, i, command);
+        }
+
+        BenchSamples s = {0};
+        for (int round = 0; round < 20; round++) {
+            int ops = 100000;
+            uint64_t start = sched_now_ns();
+            for (int i = 0; i < ops; i++) {
+                int job = pop_shortest_job(&ready);
+                snprintf(command, sizeof(command), "./job %d", job % 50);
+                add_ready_job(&ready, job, command);
+            }
+            bench_add(&s, (sched_now_ns() - start) / ops);
+        }
+        free_job_groups(&ready);
+        bench_report("sjf_ready_add_pop", "SJF", depth, &s, "ns");
+    }
+}
+
+int main() {
+    bench_print_header();
+    bench_enter_scratch_dir();
+    bench_ready_set();
+    for (int policy = RUN_SJF; policy <= RUN_MLFQ; policy++) {
+        for (int c = 0; c < BENCH_JOB_COUNTS; c++) {
+            bench_simulated((OnlinePolicy)policy, bench_job_counts[c]);
+        }
+        bench_real((OnlinePolicy)policy, bench_job_counts[0]);
+    }
+    return 0;
+}
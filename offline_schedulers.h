@@ -12,467 +12,392 @@
 #include <stdint.h>
 #include <time.h>
 
-// Structure to represent a process
-typedef struct {
-    char *command;
-    bool finished;
-    bool error;
-    uint64_t start_time;
-    uint64_t completion_time;
-    uint64_t turnaround_time;
-    uint64_t waiting_time;
-    uint64_t response_time;
-    uint64_t last_executed_time;
-    uint64_t burst_time;           
-    bool started;
-    int process_id;
-} Process;
-
-// Function to execute a command
-void execute_command(const char* command) {
-    // Redirect output to /dev/null
-    int devnull = open("/dev/null", O_WRONLY);
-    if (devnull == -1) {
-        exit(1);
+#include "sched_engine.h"
+#include "sched_policies.h"
+#include "sched_history.h"
+#include "sched_remote.h"
+
+#define RESULT_CSV_HEADER "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time\n"
+
+// Function to run an offline policy over the caller's processes, all present at the start
+static inline __attribute__((always_inline))
+void run_offline(const EngineConfig *config, Process p[], int n, const PolicyOps *ops, void *policy) {
+    ProcessList jobs = {p, n, n};
+    Engine e = {.config = config, .jobs = &jobs, .max_jobs = n};
+    if (config->distributable && remote_enabled() && run_engine_remote(&e, ops, policy)) {
+        return;
     }
-    
-    dup2(devnull, STDOUT_FILENO);
-    dup2(devnull, STDERR_FILENO);
-    close(devnull);
-
-    // Execute the command using /bin/sh
-    char *args[] = {"/bin/sh", "-c", (char*)command, NULL};
-    execvp(args[0], args);
-    exit(1);
+    run_engine(&e, ops, policy);
 }
 
-// Function to get current time in milliseconds
-uint64_t get_current_time_ms() {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+// First-Come, First-Served (FCFS) scheduling algorithm
+void FCFS(Process p[], int n) {
+    static const EngineConfig config = {
+        .policy = POLICY_FCFS, .name = "FCFS", .levels = 1, .params = {0, 0, 0, 0}, .online = false,
+        .input_order_csv = true, .csv_file = "result_offline_FCFS.csv", .csv_header = RESULT_CSV_HEADER,
+        .columnar_file = "result_offline_FCFS.cols", .distributable = true
+    };
+    // Each process runs to completion in input order
+    RoundRobinPolicy fifo = {create_queue(), UINT64_MAX};
+    run_offline(&config, p, n, &round_robin_ops, &fifo);
+    free_queue(fifo.queue);
 }
 
-// Queue node structure for process queue
-typedef struct QueueNode {
-    int process_index;
-    struct QueueNode *next;
-} QueueNode;
-
-// Queue structure
-typedef struct Queue {
-    QueueNode *front;
-    QueueNode *rear;
-} Queue;
-
-// Function to create a new queue
-Queue* create_queue() {
-    Queue *q = (Queue *)malloc(sizeof(Queue));
-    q->front = NULL;
-    q->rear = NULL;
-    return q;
+// Round Robin (RR) scheduling algorithm
+void RoundRobin(Process p[], int n, int quantum) {
+    EngineConfig config = {
+        .policy = POLICY_RR, .name = "RR", .levels = 1, .params = {(uint64_t)quantum, 0, 0, 0}, .online = false,
+        .input_order_csv = true, .csv_file = "result_offline_RR.csv", .csv_header = RESULT_CSV_HEADER,
+        .columnar_file = "result_offline_RR.cols", .distributable = true
+    };
+    RoundRobinPolicy rr = {create_queue(), ms_to_ns(quantum)};
+    run_offline(&config, p, n, &round_robin_ops, &rr);
+    free_queue(rr.queue);
 }
 
-// Function to add a process to the queue
-void enqueue(Queue *q, int process_index) {
-    QueueNode *new_node = (QueueNode *)malloc(sizeof(QueueNode));
-    new_node->process_index = process_index;
-    new_node->next = NULL;
-    if (q->rear == NULL) {
-        q->front = new_node;
-        q->rear = new_node;
-    } else {
-        q->rear->next = new_node;
-        q->rear = new_node;
+// Multi-Level Feedback Queue (MLFQ) scheduling algorithm with any number of levels,
+// configured at run time
+void ConfiguredMultiLevelFeedbackQueue(Process p[], int n, const MlfqConfig *mlfq_configuration) {
+    if (!mlfq_config_valid(mlfq_configuration)) {
+        return;
     }
+    EngineConfig config = {
+        .policy = POLICY_MLFQ, .name = "MLFQ", .levels = mlfq_configuration->levels, .params = {0, 0, 0, 0},
+        .online = false, .input_order_csv = true, .csv_file = "result_offline_MLFQ.csv",
+        .csv_header = RESULT_CSV_HEADER, .columnar_file = "result_offline_MLFQ.cols", .distributable = true
+    };
+    mlfq_trace_params(mlfq_configuration, config.params);
+    MlfqPolicy mlfq;
+    mlfq_init(&mlfq, mlfq_configuration);
+    run_offline(&config, p, n, &mlfq_ops, &mlfq);
+    mlfq_free(&mlfq);
 }
 
-// Function to remove and return a process from the queue
-int dequeue(Queue *q) {
-    if (q->front == NULL) {
-        return -1;
-    }
-    QueueNode *temp = q->front;
-    int process_index = temp->process_index;
-    q->front = q->front->next;
-    if (q->front == NULL) {
-        q->rear = NULL;
-    }
-    free(temp);
-    return process_index;
+// Multi-Level Feedback Queue (MLFQ) scheduling algorithm, called as
+// MultiLevelFeedbackQueue(p, n, quantum0, quantum1, quantum2, boostTime)
+void OfflineMultiLevelFeedbackQueue(Process p[], int n, int quantum0, int quantum1, int quantum2, int boostTime) {
+    MlfqConfig mlfq_configuration = mlfq_config(quantum0, quantum1, quantum2, boostTime);
+    ConfiguredMultiLevelFeedbackQueue(p, n, &mlfq_configuration);
 }
 
-// Function to free the memory used by the queue
-void free_queue(Queue *q) {
-    QueueNode *current = q->front;
-    QueueNode *next;
-    while (current != NULL) {
-        next = current->next;
-        free(current);
-        current = next;
-    }
-    free(q);
+// Completely Fair Scheduler (CFS), called as
+// CompletelyFairScheduler(p, n, target_latency, min_granularity). Jobs are weighted by p[i].nice.
+void OfflineCompletelyFairScheduler(Process p[], int n, int target_latency, int min_granularity) {
+    EngineConfig config = {
+        .policy = POLICY_CFS, .name = "CFS", .levels = 1,
+        .params = {(uint64_t)target_latency, (uint64_t)min_granularity, 0, 0}, .online = false,
+        .input_order_csv = true, .csv_file = "result_offline_CFS.csv", .csv_header = RESULT_CSV_HEADER,
+        .columnar_file = "result_offline_CFS.cols"
+    };
+    CfsPolicy cfs;
+    cfs_init(&cfs, target_latency, min_granularity);
+    run_offline(&config, p, n, &cfs_ops, &cfs);
+    cfs_free(&cfs);
 }
 
-// Function to write results to a CSV file
-void write_results_to_csv(Process p[], int n, const char *filename) {
-    FILE *fp = fopen(filename, "w");
-    if (fp == NULL) {
-        return;
-    }
-
-    fprintf(fp, "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time\n");
-
-    for (int i = 0; i < n; i++) {
-        fprintf(fp, "\"%s\",%s,%s,%lu,%lu,%lu,%lu\n",
-                p[i].command,
-                p[i].finished && !p[i].error ? "Yes" : "No",
-                p[i].error ? "Yes" : "No",
-                p[i].burst_time,
-                p[i].turnaround_time,
-                p[i].waiting_time,
-                p[i].response_time);
-    }
-
-    fclose(fp);
+// Stride scheduling, called as StrideScheduling(p, n, quantum). CPU time follows
+// p[i].tickets (or TICKETS=<n> in front of the command).
+void OfflineStrideScheduling(Process p[], int n, int quantum) {
+    EngineConfig config = {
+        .policy = POLICY_STRIDE, .name = "stride", .levels = 1, .params = {(uint64_t)quantum, 0, 0, 0},
+        .online = false, .input_order_csv = true, .csv_file = "result_offline_stride.csv",
+        .csv_header = RESULT_CSV_HEADER, .columnar_file = "result_offline_stride.cols"
+    };
+    StridePolicy stride;
+    stride_init(&stride, quantum);
+    run_offline(&config, p, n, &stride_ops, &stride);
+    stride_free(&stride);
 }
 
-// Function to print context switch information
-void print_context_switch(const char* command, uint64_t start_time, uint64_t end_time) {
-    printf("%s|%lu|%lu\n", command, start_time, end_time);
+// Lottery scheduling, called as LotteryScheduling(p, n, quantum[, seed])
+void OfflineLotteryScheduling(Process p[], int n, int quantum, int seed) {
+    EngineConfig config = {
+        .policy = POLICY_LOTTERY, .name = "lottery", .levels = 1,
+        .params = {(uint64_t)quantum, (uint64_t)seed, 0, 0}, .online = false, .input_order_csv = true,
+        .csv_file = "result_offline_lottery.csv", .csv_header = RESULT_CSV_HEADER,
+        .columnar_file = "result_offline_lottery.cols"
+    };
+    LotteryPolicy lottery;
+    lottery_init(&lottery, quantum, seed);
+    run_offline(&config, p, n, &lottery_ops, &lottery);
+    lottery_free(&lottery);
 }
 
-// First-Come, First-Served (FCFS) scheduling algorithm
-void FCFS(Process p[], int n) {
-    uint64_t start_time = get_current_time_ms();
-    uint64_t current_time = 0;
-
-    pid_t *process_pids = (pid_t *)malloc(n * sizeof(pid_t));
-
-    // Initialize process data
-    for (int i = 0; i < n; i++) {
-        p[i].started = false;
-        p[i].finished = false;
-        p[i].completion_time = 0;
-        p[i].turnaround_time = 0;
-        p[i].waiting_time = 0;
-        p[i].response_time = 0;
-        p[i].burst_time = 0;
-        process_pids[i] = -1;
-    }
-
-    // Execute processes in order
-    for (int i = 0; i < n; i++) {
-        p[i].start_time = current_time;
-        p[i].response_time = p[i].start_time;
-        p[i].started = true;
-
-        uint64_t process_start_time = get_current_time_ms() - start_time;
-
-        // Fork and execute the process
-        process_pids[i] = fork();
-        if (process_pids[i] == 0) {
-            execute_command(p[i].command);
-        } else if (process_pids[i] < 0) {
-            p[i].finished = false;
-            p[i].error = true;
-            continue;
-        }
-
-        int status;
-        uint64_t execution_start_time = get_current_time_ms();
-        waitpid(process_pids[i], &status, 0);
-        uint64_t execution_end_time = get_current_time_ms();
-
-        // Calculate process metrics
-        p[i].completion_time = execution_end_time - start_time;
-        p[i].turnaround_time = p[i].completion_time;
-        p[i].waiting_time = p[i].response_time;
-        p[i].burst_time = execution_end_time - execution_start_time;
+// MLFQ with quanta and boost period tuned from the completed bursts, called as
+// AdaptiveMultiLevelFeedbackQueue(p, n, min_quantum, max_quantum). The configurations it
+// goes through are logged to result_offline_MLFQ_tuning.csv.
+void OfflineAdaptiveMultiLevelFeedbackQueue(Process p[], int n, int min_quantum, int max_quantum) {
+    EngineConfig config = {
+        .policy = POLICY_ADAPTIVE_MLFQ, .name = "MLFQ", .levels = MLFQ_LEVELS,
+        .params = {(uint64_t)min_quantum, (uint64_t)max_quantum, 0, 0}, .online = false,
+        .input_order_csv = true, .csv_file = "result_offline_MLFQ.csv", .csv_header = RESULT_CSV_HEADER,
+        .columnar_file = "result_offline_MLFQ.cols", .distributable = true
+    };
+    AdaptiveMlfqPolicy adaptive;
+    adaptive_mlfq_init(&adaptive, min_quantum, max_quantum, "result_offline_MLFQ_tuning.csv");
+    run_offline(&config, p, n, &adaptive_mlfq_ops, &adaptive);
+    adaptive_mlfq_free(&adaptive);
+}
 
-        // Check process exit status
-        if (WIFEXITED(status)) {
-            if (WEXITSTATUS(status) == 0) {
-                p[i].finished = true;
-                p[i].error = false;
-            } else {
-                p[i].finished = false;
-                p[i].error = true;
+// Dependency graph of an offline run, from "AFTER=<i>[,<j>...] command" options that
+// name the input indices of the jobs a job waits for
+typedef struct {
+    int *first_successor;       // Per job, into successors (n + 1 entries)
+    int *successors;
+    int *waiting_on;            // Per job, dependencies not yet succeeded; -1 once the job is done
+    uint64_t *critical_path_ns; // Per job, its estimated burst plus the longest chain after it
+} JobGraph;
+
+// Function to build the graph of the n jobs from their AFTER options, false on a cycle
+bool build_job_graph(JobGraph *g, Process p[], int n) {
+    int *from = NULL, *to = NULL;
+    int edges = 0, capacity = 0;
+    g->waiting_on = (int *)calloc(n, sizeof(int));
+    g->first_successor = (int *)calloc(n + 1, sizeof(int));
+    for (int job = 0; job < n; job++) {
+        const char *s = p[job].command;
+        const char *name, *value;
+        size_t length;
+        while (next_job_option(&s, &name, &length, &value)) {
+            if (length != 5 || strncmp(name, "AFTER", 5) != 0) {
+                continue;
+            }
+            for (const char *v = value; *v != '\0' && *v != ' ' && *v != '\t'; v += *v == ',') {
+                char *end;
+                long dependency = strtol(v, &end, 10);
+                if (end == v || dependency < 0 || dependency >= n || dependency == job) {
+                    fprintf(stderr, "Job %d: ignoring invalid dependency in %s\n", job, p[job].command);
+                    break;
+                }
+                if (edges == capacity) {
+                    capacity = capacity ? capacity * 2 : 64;
+                    from = (int *)realloc(from, capacity * sizeof(int));
+                    to = (int *)realloc(to, capacity * sizeof(int));
+                }
+                from[edges] = (int)dependency;
+                to[edges++] = job;
+                g->waiting_on[job]++;
+                g->first_successor[dependency + 1]++;
+                v = end;
             }
-        } else {
-            p[i].finished = false;
-            p[i].error = true;
         }
-
-        uint64_t process_end_time = get_current_time_ms() - start_time;
-        print_context_switch(p[i].command, process_start_time, process_end_time);
-
-        current_time = p[i].completion_time;
     }
 
-    free(process_pids);
-    write_results_to_csv(p, n, "result_offline_FCFS.csv");
-}
-
-// Round Robin (RR) scheduling algorithm
-void RoundRobin(Process p[], int n, int quantum) {
-    uint64_t start_time = get_current_time_ms();
-    uint64_t current_time = 0;
-    int completed = 0;
-    Queue *ready_queue = create_queue();
-
-    pid_t *process_pids = (pid_t *)malloc(n * sizeof(pid_t));
-
-    // Initialize process data and queue
-    for (int i = 0; i < n; i++) {
-        p[i].started = false;
-        p[i].finished = false;
-        p[i].last_executed_time = 0;
-        p[i].burst_time = 0;
-        p[i].waiting_time = 0;
-        process_pids[i] = -1;
-        enqueue(ready_queue, i);
+    // Successors grouped by job (counting sort on the edge source)
+    for (int job = 0; job < n; job++) {
+        g->first_successor[job + 1] += g->first_successor[job];
     }
-
-    // Execute processes in round-robin fashion
-    while (completed < n) {
-        int i = dequeue(ready_queue);
-        if (i == -1) break;
-
-        if (p[i].finished) {
-            continue;
-        }
-
-        if (!p[i].started) {
-            p[i].start_time = current_time;
-            p[i].response_time = current_time;
-            p[i].started = true;
-            p[i].last_executed_time = current_time;
+    g->successors = (int *)malloc((edges > 0 ? edges : 1) * sizeof(int));
+    int *next = (int *)malloc((n > 0 ? n : 1) * sizeof(int));
+    memcpy(next, g->first_successor, n * sizeof(int));
+    for (int i = 0; i < edges; i++) {
+        g->successors[next[from[i]]++] = to[i];
+    }
+    free(from);
+    free(to);
+
+    // Topological order (Kahn), then the critical paths from the sinks back
+    int *order = next;
+    int *pending = (int *)malloc((n > 0 ? n : 1) * sizeof(int));
+    memcpy(pending, g->waiting_on, n * sizeof(int));
+    int ordered = 0;
+    for (int job = 0; job < n; job++) {
+        if (pending[job] == 0) {
+            order[ordered++] = job;
         }
-
-        uint64_t process_start_time = get_current_time_ms() - start_time;
-
-        // Fork or continue the process
-        if (process_pids[i] == -1) {
-            process_pids[i] = fork();
-            if (process_pids[i] == 0) {
-                execute_command(p[i].command);
-            } else if (process_pids[i] < 0) {
-                p[i].finished = true;
-                p[i].error = true;
-                completed++;
-                continue;
+    }
+    for (int i = 0; i < ordered; i++) {
+        for (int k = g->first_successor[order[i]]; k < g->first_successor[order[i] + 1]; k++) {
+            if (--pending[g->successors[k]] == 0) {
+                order[ordered++] = g->successors[k];
             }
-        } else {
-            kill(process_pids[i], SIGCONT);
         }
-
-        int status;
-        uint64_t start_execution = get_current_time_ms();
-        uint64_t elapsed_time = 0;
-        bool process_finished = false;
-
-        // Execute the process for the quantum or until it finishes
-        while (elapsed_time < quantum) {
-            pid_t result = waitpid(process_pids[i], &status, WNOHANG);
-            if (result > 0) {
-                process_finished = true;
-                if (WIFEXITED(status)) {
-                    if (WEXITSTATUS(status) == 0) {
-                        p[i].finished = true;
-                        p[i].error = false;
-                    } else {
-                        p[i].finished = false;
-                        p[i].error = true;
-                    }
-                } else {
-                    p[i].finished = false;
-                    p[i].error = true;
-                }
-                elapsed_time = get_current_time_ms() - start_execution;
-                break;
-            } else if (result < 0) {
-                p[i].finished = false;
-                p[i].error = true;
-                process_finished = true;
-                elapsed_time = get_current_time_ms() - start_execution;
-                break;
+    }
+    g->critical_path_ns = (uint64_t *)calloc(n > 0 ? n : 1, sizeof(uint64_t));
+    for (int i = ordered - 1; i >= 0; i--) {
+        int job = order[i];
+        uint64_t longest = 0;
+        for (int k = g->first_successor[job]; k < g->first_successor[job + 1]; k++) {
+            if (g->critical_path_ns[g->successors[k]] > longest) {
+                longest = g->critical_path_ns[g->successors[k]];
             }
-            elapsed_time = get_current_time_ms() - start_execution;
         }
+        const char *command = read_job_options(&p[job]);
+        g->critical_path_ns[job] = ms_to_ns(get_historical_burst_time(&historical_data, command)) + longest;
+    }
+    free(order);
+    free(pending);
+    return ordered == n;
+}
 
-        uint64_t time_spent = elapsed_time;
-        p[i].burst_time += time_spent;
-
-        current_time += elapsed_time;
-
-        uint64_t process_end_time = get_current_time_ms() - start_time;
-        print_context_switch(p[i].command, process_start_time, process_end_time);
+void free_job_graph(JobGraph *g) {
+    free(g->first_successor);
+    free(g->successors);
+    free(g->waiting_on);
+    free(g->critical_path_ns);
+}
 
-        // If process didn't finish, stop it and requeue
-        if (!process_finished) {
-            kill(process_pids[i], SIGSTOP);
-            enqueue(ready_queue, i);
-            p[i].last_executed_time = current_time;
-        } else {
-            p[i].completion_time = current_time;
-            p[i].turnaround_time = p[i].completion_time;
-            p[i].waiting_time = p[i].turnaround_time - p[i].burst_time;
-            completed++;
+// Function to make the successors of a finished job ready, or when it failed to fail
+// every job that depends on it (directly or not) without running them
+void release_successors(Engine *e, JobGraph *g, KeyHeap *ready, int job, bool failed, int *stack) {
+    int depth = 0;
+    stack[depth++] = job;
+    g->waiting_on[job] = -1;
+    while (depth > 0) {
+        int done = stack[--depth];
+        for (int k = g->first_successor[done]; k < g->first_successor[done + 1]; k++) {
+            int successor = g->successors[k];
+            if (g->waiting_on[successor] < 0) {
+                continue;
+            }
+            if (failed) {
+                g->waiting_on[successor] = -1;
+                engine_reject(e, successor);
+                stack[depth++] = successor;
+            } else if (--g->waiting_on[successor] == 0) {
+                key_heap_push(ready, successor, UINT64_MAX - g->critical_path_ns[successor]);
+            }
         }
     }
-
-    free_queue(ready_queue);
-    free(process_pids);
-    write_results_to_csv(p, n, "result_offline_RR.csv");
 }
 
-// Multi-Level Feedback Queue (MLFQ) scheduling algorithm
-void MultiLevelFeedbackQueue(Process p[], int n, int quantum0, int quantum1, int quantum2, int boostTime) {
-    uint64_t start_time = get_current_time_ms();
-    uint64_t current_time = 0;
-    int completed = 0;
-    int *current_queue = (int *)calloc(n, sizeof(int));
-    uint64_t last_boost_time = 0;
-
-    // Create three priority queues
-    Queue *queues[3];
-    for (int i = 0; i < 3; i++) {
-        queues[i] = create_queue();
+// Dependency-aware scheduling, called as DependencyScheduling(p, n, parallelism). A job
+// "AFTER=2,5 command" starts once jobs 2 and 5 (input indices) have succeeded; when one
+// of them fails, the job and everything after it are reported as errors without running.
+// Jobs run to completion, up to parallelism at a time. Whenever one finishes, the ready
+// jobs with the longest critical path (estimated burst plus the longest chain of
+// estimates depending on it) start first, so the chain that bounds the makespan is never
+// kept waiting behind short side branches. Estimates come from the command's burst
+// history (sched_history.h), 1000 ms for commands not seen yet.
+void DependencyScheduling(Process p[], int n, int parallelism) {
+    if (parallelism < 1) {
+        parallelism = 1;
+    }
+    EngineConfig config = {
+        .policy = POLICY_DAG, .name = "DAG", .levels = 1, .params = {(uint64_t)parallelism, 0, 0, 0},
+        .online = false, .input_order_csv = true, .csv_file = "result_offline_DAG.csv",
+        .csv_header = RESULT_CSV_HEADER, .columnar_file = "result_offline_DAG.cols"
+    };
+    ProcessList jobs = {p, n, n};
+    Engine e = {.config = &config, .jobs = &jobs, .max_jobs = n};
+    if (!engine_begin_run(&e)) {
+        return;
     }
+    engine_submit_all(&e);
 
-    pid_t *process_pids = (pid_t *)malloc(n * sizeof(pid_t));
-    
-    // Initialize process data and queue
-    for (int i = 0; i < n; i++) {
-        p[i].started = false;
-        p[i].finished = false;
-        p[i].burst_time = 0;
-        p[i].waiting_time = 0;
-        current_queue[i] = 0;
-        enqueue(queues[0], i);
-        process_pids[i] = -1;
+    JobGraph g;
+    if (!build_job_graph(&g, p, n)) {
+        fprintf(stderr, "Dependency cycle: the jobs on it and after it are not run\n");
+    }
+    KeyHeap ready = {0};
+    for (int job = 0; job < n; job++) {
+        if (g.waiting_on[job] == 0) {
+            key_heap_push(&ready, job, UINT64_MAX - g.critical_path_ns[job]);
+        }
     }
 
-    while (completed < n) {
-        // Check if it's time to boost all processes to the highest priority queue
-        if (current_time - last_boost_time >= boostTime) {
-            // Move all unfinished processes to the highest priority queue (queue 0)
-            for (int i = 0; i < n; i++) {
-                if (!p[i].finished) {
-                    current_queue[i] = 0;  // Reset process queue to the highest priority
-                    enqueue(queues[0], i);  // Add process to the highest priority queue
-                }
+    int *running = (int *)malloc(parallelism * sizeof(int));
+    pid_t *pids = (pid_t *)malloc(parallelism * sizeof(pid_t));
+    uint64_t *start_ns = (uint64_t *)malloc(parallelism * sizeof(uint64_t));
+    int *stack = (int *)malloc((n > 0 ? n : 1) * sizeof(int));
+    int count = 0;
+    uint64_t makespan_ns = 0;
+    while (true) {
+        int job;
+        while (count < parallelism && (job = key_heap_pop(&ready)) != -1) {
+            live_set_queue_depth(0, ready.size);
+            live_slice_begin(job, -1, p[job].command);
+            if (!start_job(job, &p[job].process_id, p[job].command, &start_ns[count])) {
+                SliceResult r = {start_ns[count], start_ns[count], true, true};
+                engine_record_slice(&e, job, -1, UINT64_MAX, r);
+                engine_complete(&e, job, r);
+                release_successors(&e, &g, &ready, job, true, stack);
+                continue;
             }
-            last_boost_time = current_time;  // Update the time of the last boost
+            running[count] = job;
+            pids[count++] = p[job].process_id;
+        }
+        if (count == 0) {
+            break;
         }
 
-        // Process each queue in order, from the highest priority (queue 0) to the lowest (queue 2)
-        for (int queue = 0; queue < 3 && completed < n; queue++) {
-            // Determine the quantum time for the current queue
-            int quantum = (queue == 0) ? quantum0 : (queue == 1) ? quantum1 : quantum2;
-
-            // Process all processes in the current queue
-            while (queues[queue]->front != NULL) {
-                int i = dequeue(queues[queue]);  // Get the process at the front of the queue
-                if (i == -1 || p[i].finished) continue;  // Skip if invalid or process is finished
-
-                // If the process has not started, record its start time and response time
-                if (!p[i].started) {
-                    p[i].start_time = current_time;
-                    p[i].response_time = current_time;
-                    p[i].started = true;
-                }
-
-                // Get the current time relative to when the scheduler started
-                uint64_t process_start_time = get_current_time_ms() - start_time;
-
-                // Fork or continue the process
-                if (process_pids[i] == -1) {
-                    // Fork a new process if it hasn't been created yet
-                    process_pids[i] = fork();
-                    if (process_pids[i] == 0) {
-                        execute_command(p[i].command);  // Child process executes the command
-                    } else if (process_pids[i] < 0) {
-                        // If the fork failed, mark the process as finished with an error
-                        p[i].finished = true;
-                        p[i].error = true;
-                        completed++;
-                        continue;
-                    }
-                } else {
-                    // Resume the suspended process
-                    kill(process_pids[i], SIGCONT);
-                }
-
-                int status;
-                uint64_t start_execution = get_current_time_ms();  // Start measuring execution time
-                uint64_t elapsed_time = 0;
-                bool process_finished = false;
-
-                // Allow the process to execute for a duration up to the quantum
-                while (elapsed_time < quantum) {
-                    // Check if the process has finished
-                    pid_t result = waitpid(process_pids[i], &status, WNOHANG);
-                    if (result > 0) {
-                        process_finished = true;  // Process finished successfully
-                        if (WIFEXITED(status)) {
-                            if (WEXITSTATUS(status) == 0) {
-                                p[i].finished = true;  // Process completed without error
-                                p[i].error = false;
-                            } else {
-                                p[i].finished = false;  // Process finished with an error
-                                p[i].error = true;
-                            }
-                        } else {
-                            p[i].finished = false;  // Process ended abnormally
-                            p[i].error = true;
-                        }
-                        elapsed_time = get_current_time_ms() - start_execution;
-                        break;
-                    } else if (result < 0) {
-                        // Error occurred while waiting for the process to finish
-                        p[i].finished = false;
-                        p[i].error = true;
-                        process_finished = true;
-                        elapsed_time = get_current_time_ms() - start_execution;
-                        break;
-                    }
-                    elapsed_time = get_current_time_ms() - start_execution;  // Update elapsed time
-                }
-
-                p[i].burst_time += elapsed_time;  // Update burst time for the process
-                current_time += elapsed_time;  // Update current time
-
-                // Record the time the process finished or was suspended
-                uint64_t process_end_time = get_current_time_ms() - start_time;
-                print_context_switch(p[i].command, process_start_time, process_end_time);  // Print context switch details
+        SliceResult r;
+        int position = wait_for_job_exit(running, pids, start_ns, count, &r);
+        job = running[position];
+        count--;
+        running[position] = running[count];
+        pids[position] = pids[count];
+        start_ns[position] = start_ns[count];
+
+        engine_record_slice(&e, job, -1, UINT64_MAX, r);
+        engine_complete(&e, job, r);
+        makespan_ns = r.end_ns - sched_epoch_ns;
+        release_successors(&e, &g, &ready, job, r.error, stack);
+    }
 
-                // If the process has not finished, suspend it and move it to the next queue
-                if (!process_finished) {
-                    kill(process_pids[i], SIGSTOP);  // Suspend the process
-                    if (current_queue[i] < 2) {
-                        current_queue[i]++;  // Move to the next lower priority queue
-                    }
-                    enqueue(queues[current_queue[i]], i);  // Add the process back to the queue
-                } else {
-                    // Process has finished; update its completion and turnaround times
-                    p[i].completion_time = current_time;
-                    p[i].turnaround_time = p[i].completion_time;
-                    p[i].waiting_time = p[i].turnaround_time - p[i].burst_time;
-                    completed++;
-                }
-            }
+    // Left over: the jobs on a dependency cycle and those waiting on them
+    for (int job = 0; job < n; job++) {
+        if (g.waiting_on[job] >= 0) {
+            g.waiting_on[job] = -1;
+            engine_reject(&e, job);
         }
     }
+    engine_end_run(&e);
+    fprintf(stderr, "DAG: makespan %lu ms, %d jobs, parallelism %d\n", ns_to_ms(makespan_ns), n, parallelism);
+
+    free(running);
+    free(pids);
+    free(start_ns);
+    free(stack);
+    free(ready.entries);
+    free_job_graph(&g);
+}
 
-    // Free the memory allocated for the queues and other structures
-    for (int i = 0; i < 3; i++) {
-        free_queue(queues[i]);  // Free each queue
+// Schedulers for fixed production configurations. The configuration is a static const
+// table, so its level count, quanta and boost period are compile-time constants in the
+// dispatcher loop instead of run-time parameters:
+//
+//   static const MlfqConfig production_mlfq = {3, {MLFQ_MS(10), MLFQ_MS(20), MLFQ_MS(30)}, MLFQ_MS(500)};
+//   DEFINE_OFFLINE_MLFQ(ProductionMLFQ, production_mlfq)         // void ProductionMLFQ(Process p[], int n)
+//   DEFINE_OFFLINE_ROUND_ROBIN(ProductionRR, 10)                 // void ProductionRR(Process p[], int n)
+//
+// They write the same results and trace as MultiLevelFeedbackQueue() and RoundRobin().
+#define DEFINE_OFFLINE_MLFQ(scheduler, mlfq_configuration)                                          \
+    DEFINE_MLFQ_STEPS(scheduler, mlfq_configuration)                                                \
+    static const PolicyOps scheduler##_ops = {                                                      \
+        .admit = mlfq_admit, .pick = scheduler##_pick,                                              \
+        .requeue = scheduler##_requeue, .resume = mlfq_resume                                       \
+    };                                                                                              \
+    void scheduler(Process p[], int n) {                                                            \
+        if (!mlfq_config_valid(&(mlfq_configuration))) {                                            \
+            return;                                                                                 \
+        }                                                                                           \
+        EngineConfig config = {                                                                     \
+            .policy = POLICY_MLFQ, .name = "MLFQ", .levels = (mlfq_configuration).levels,           \
+            .params = {0, 0, 0, 0}, .online = false, .input_order_csv = true,                       \
+            .csv_file = "result_offline_MLFQ.csv", .csv_header = RESULT_CSV_HEADER,                 \
+            .columnar_file = "result_offline_MLFQ.cols", .distributable = true                      \
+        };                                                                                          \
+        mlfq_trace_params(&(mlfq_configuration), config.params);                                    \
+        MlfqPolicy mlfq;                                                                            \
+        mlfq_init(&mlfq, &(mlfq_configuration));                                                    \
+        run_offline(&config, p, n, &scheduler##_ops, &mlfq);                                        \
+        mlfq_free(&mlfq);                                                                           \
     }
-    free(current_queue);  // Free the queue tracker
-    free(process_pids);   // Free the process IDs array
 
-    // Write the results to a CSV file
-    write_results_to_csv(p, n, "result_offline_MLFQ.csv");
-}
+#define DEFINE_OFFLINE_ROUND_ROBIN(scheduler, quantum_ms)                                           \
+    DEFINE_ROUND_ROBIN_STEPS(scheduler, quantum_ms)                                                 \
+    static const PolicyOps scheduler##_ops = {                                                      \
+        .admit = round_robin_admit, .pick = scheduler##_pick, .requeue = round_robin_requeue        \
+    };                                                                                              \
+    void scheduler(Process p[], int n) {                                                            \
+        static const EngineConfig config = {                                                        \
+            .policy = POLICY_RR, .name = "RR", .levels = 1, .params = {(quantum_ms), 0, 0, 0},      \
+            .online = false, .input_order_csv = true, .csv_file = "result_offline_RR.csv",          \
+            .csv_header = RESULT_CSV_HEADER, .columnar_file = "result_offline_RR.cols",             \
+            .distributable = true                                                                   \
+        };                                                                                          \
+        RoundRobinPolicy rr = {create_queue(), MLFQ_MS(quantum_ms)};                                \
+        run_offline(&config, p, n, &scheduler##_ops, &rr);                                          \
+        free_queue(rr.queue);                                                                       \
+    }
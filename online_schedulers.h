@@ -13,490 +13,839 @@
 #include <stdint.h>
 #include <errno.h>  
 
-#define MAX_PROCESSES 100
-#define MAX_COMMAND_LENGTH 256
+#include "sched_engine.h"
+#include "sched_policies.h"
+#include "sched_history.h"
+#include "sched_remote.h"
 
-typedef struct {
-    char command[MAX_COMMAND_LENGTH];
-    bool finished;
-    bool error;
-    uint64_t arrival_time;
-    uint64_t start_time;
-    uint64_t completion_time;
-    uint64_t turnaround_time;
-    uint64_t waiting_time;
-    uint64_t response_time;
-    uint64_t burst_time;
-    bool started;
-    int process_id;
-    int priority;
-    uint64_t remaining_time;
-} Process;
+#define MAX_PROCESSES 100
 
-typedef struct {
-    Process processes[MAX_PROCESSES];
-    int count;
-} ProcessList;
+ProcessList process_list = {0};
+int max_processes = MAX_PROCESSES;  // Raised by simulations, which submit their whole profile
 
+// SJF ready set: pending jobs grouped by command. Every job of a command shares one
+// burst estimate, so the groups are kept in a min-heap on (estimate, oldest pending
+// index) and picking the next job is O(log n) instead of a scan over every process.
 typedef struct {
     char command[MAX_COMMAND_LENGTH];
-    uint64_t avg_burst_time;
-    int count;
-} HistoricalData;
+    uint64_t hash;
+    Queue *pending;
+    uint64_t estimate;
+    int heap_pos;   // -1 while the group has no pending jobs
+} JobGroup;
 
 typedef struct {
-    HistoricalData data[MAX_PROCESSES];
+    JobGroup *groups;
     int count;
-} HistoricalDataList;
-
-typedef struct QueueNode {
-    int process_index;
-    struct QueueNode *next;
-} QueueNode;
-
-typedef struct Queue {
-    QueueNode *front;
-    QueueNode *rear;
-} Queue;
-
-Queue* create_queue() {
-    Queue *q = (Queue *)malloc(sizeof(Queue));
-    q->front = NULL;
-    q->rear = NULL;
-    return q;
-}
-
-void enqueue(Queue *q, int process_index) {
-    QueueNode *new_node = (QueueNode *)malloc(sizeof(QueueNode));
-    new_node->process_index = process_index;
-    new_node->next = NULL;
-    if (q->rear == NULL) {
-        q->front = new_node;
-        q->rear = new_node;
-    } else {
-        q->rear->next = new_node;
-        q->rear = new_node;
+    int capacity;
+    int *buckets;   // Open-addressing index from command hash to group, -1 when empty
+    int bucket_count;
+    int *heap;
+    int heap_size;
+    int pending_jobs;   // Over all groups
+} JobGroupTable;
+
+uint64_t command_hash(const char *command) {
+    uint64_t h = 1469598103934665603ULL;  // FNV-1a
+    for (const unsigned char *c = (const unsigned char *)command; *c; c++) {
+        h = (h ^ *c) * 1099511628211ULL;
     }
+    return h;
 }
 
-int dequeue(Queue *q) {
-    if (q->front == NULL) {
-        return -1;
+JobGroup* find_job_group(JobGroupTable *t, const char *command, bool create) {
+    uint64_t h = command_hash(command);
+    if (t->bucket_count > 0) {
+        for (int b = h & (t->bucket_count - 1); t->buckets[b] != -1; b = (b + 1) & (t->bucket_count - 1)) {
+            JobGroup *g = &t->groups[t->buckets[b]];
+            if (g->hash == h && strcmp(g->command, command) == 0) {
+                return g;
+            }
+        }
     }
-    QueueNode *temp = q->front;
-    int process_index = temp->process_index;
-    q->front = q->front->next;
-    if (q->front == NULL) {
-        q->rear = NULL;
+    if (!create) {
+        return NULL;
     }
-    free(temp);
-    return process_index;
+
+    // Keep the index at most half full
+    if (2 * (t->count + 1) > t->bucket_count) {
+        t->bucket_count = t->bucket_count ? t->bucket_count * 2 : 64;
+        t->buckets = (int *)realloc(t->buckets, t->bucket_count * sizeof(int));
+        memset(t->buckets, -1, t->bucket_count * sizeof(int));
+        for (int i = 0; i < t->count; i++) {
+            int b = t->groups[i].hash & (t->bucket_count - 1);
+            while (t->buckets[b] != -1) b = (b + 1) & (t->bucket_count - 1);
+            t->buckets[b] = i;
+        }
+    }
+    if (t->count == t->capacity) {
+        t->capacity = t->capacity ? t->capacity * 2 : 64;
+        t->groups = (JobGroup *)realloc(t->groups, t->capacity * sizeof(JobGroup));
+        t->heap = (int *)realloc(t->heap, t->capacity * sizeof(int));
+    }
+
+    JobGroup *g = &t->groups[t->count];
+    strncpy(g->command, command, MAX_COMMAND_LENGTH - 1);
+    g->command[MAX_COMMAND_LENGTH - 1] = '\0';
+    g->hash = h;
+    g->pending = create_queue();
+    g->estimate = get_historical_burst_time(&historical_data, command);
+    g->heap_pos = -1;
+
+    int b = h & (t->bucket_count - 1);
+    while (t->buckets[b] != -1) b = (b + 1) & (t->bucket_count - 1);
+    t->buckets[b] = t->count++;
+    return g;
 }
 
-void free_queue(Queue *q) {
-    QueueNode *current = q->front;
-    QueueNode *next;
-    while (current != NULL) {
-        next = current->next;
-        free(current);
-        current = next;
+bool job_group_before(JobGroupTable *t, int a, int b) {
+    JobGroup *ga = &t->groups[a], *gb = &t->groups[b];
+    if (ga->estimate != gb->estimate) {
+        return ga->estimate < gb->estimate;
     }
-    free(q);
+    return ga->pending->front->process_index < gb->pending->front->process_index;
 }
 
-ProcessList process_list = {0};
-HistoricalDataList historical_data = {0};
-uint64_t scheduler_start_time;
+void job_heap_swap(JobGroupTable *t, int i, int j) {
+    int tmp = t->heap[i];
+    t->heap[i] = t->heap[j];
+    t->heap[j] = tmp;
+    t->groups[t->heap[i]].heap_pos = i;
+    t->groups[t->heap[j]].heap_pos = j;
+}
 
-uint64_t get_current_time_ms() {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000) - scheduler_start_time;
+// Restore the heap order around position i after its key changed
+void job_heap_fix(JobGroupTable *t, int i) {
+    while (i > 0 && job_group_before(t, t->heap[i], t->heap[(i - 1) / 2])) {
+        job_heap_swap(t, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    while (1) {
+        int smallest = i, l = 2 * i + 1, r = 2 * i + 2;
+        if (l < t->heap_size && job_group_before(t, t->heap[l], t->heap[smallest])) smallest = l;
+        if (r < t->heap_size && job_group_before(t, t->heap[r], t->heap[smallest])) smallest = r;
+        if (smallest == i) break;
+        job_heap_swap(t, i, smallest);
+        i = smallest;
+    }
 }
 
-void print_context_switch(Process *p, uint64_t start_time, uint64_t end_time) {
-    printf("%s|%lu|%lu\n", p->command, start_time, end_time);
+void add_ready_job(JobGroupTable *t, int process_index, const char *command) {
+    JobGroup *g = find_job_group(t, command, true);
+    enqueue(g->pending, process_index);
+    t->pending_jobs++;
+    if (g->heap_pos == -1) {
+        g->heap_pos = t->heap_size;
+        t->heap[t->heap_size++] = (int)(g - t->groups);
+        job_heap_fix(t, g->heap_pos);
+    }
 }
 
-void update_historical_data(HistoricalDataList *list, const char *command, uint64_t burst_time) {
-    for (int i = 0; i < list->count; i++) {
-        if (strcmp(list->data[i].command, command) == 0) {
-            list->data[i].avg_burst_time = (list->data[i].avg_burst_time * list->data[i].count + burst_time) / (list->data[i].count + 1);
-            list->data[i].count++;
-            return;
+// Remove and return the pending job with the smallest estimated burst, -1 if none
+int pop_shortest_job(JobGroupTable *t) {
+    if (t->heap_size == 0) {
+        return -1;
+    }
+    JobGroup *g = &t->groups[t->heap[0]];
+    int process_index = dequeue(g->pending);
+    t->pending_jobs--;
+    if (g->pending->front == NULL) {
+        g->heap_pos = -1;
+        t->heap_size--;
+        if (t->heap_size > 0) {
+            t->heap[0] = t->heap[t->heap_size];
+            t->groups[t->heap[0]].heap_pos = 0;
+            job_heap_fix(t, 0);
         }
+    } else {
+        job_heap_fix(t, 0);
     }
+    return process_index;
+}
 
-    if (list->count < MAX_PROCESSES) {
-        strcpy(list->data[list->count].command, command);
-        list->data[list->count].avg_burst_time = burst_time;
-        list->data[list->count].count = 1;
-        list->count++;
+// Called after the history of a command changed so its pending jobs are re-ranked
+void refresh_job_estimate(JobGroupTable *t, const char *command) {
+    JobGroup *g = find_job_group(t, command, false);
+    if (g == NULL) {
+        return;
+    }
+    g->estimate = get_historical_burst_time(&historical_data, command);
+    if (g->heap_pos != -1) {
+        job_heap_fix(t, g->heap_pos);
     }
 }
 
-uint64_t get_historical_burst_time(HistoricalDataList *list, const char *command) {
+void free_job_groups(JobGroupTable *t) {
+    for (int i = 0; i < t->count; i++) {
+        free_queue(t->groups[i].pending);
+    }
+    free(t->groups);
+    free(t->buckets);
+    free(t->heap);
+}
+
+// Function to drop every submitted process, e.g. between independent runs
+void clear_process_list(ProcessList *list) {
     for (int i = 0; i < list->count; i++) {
-        if (strcmp(list->data[i].command, command) == 0) {
-            return list->data[i].avg_burst_time;
-        }
+        free(list->processes[i].command);
     }
-    return 1000; // Default 1000 if no historical data
+    list->count = 0;
 }
 
-Process* add_process(ProcessList *list, const char *command, HistoricalDataList *historical_data, uint64_t arrival_time) {
-    if (list->count >= MAX_PROCESSES) {
-        printf("Maximum number of processes reached.\n");
-        return NULL;
+// Function to run an online policy over the submissions, appending them to process_list.
+// Processes submitted in earlier runs stay in the list (finished) and keep their indices.
+static inline __attribute__((always_inline))
+void run_online(const EngineConfig *config, const PolicyOps *ops, void *policy) {
+    Engine e = {.config = config, .jobs = &process_list, .max_jobs = max_processes};
+    if (config->distributable && remote_enabled() && run_engine_remote(&e, ops, policy)) {
+        return;
     }
+    run_engine(&e, ops, policy);
+}
 
-    Process *p = &list->processes[list->count];
-    strncpy(p->command, command, MAX_COMMAND_LENGTH - 1);
-    p->command[MAX_COMMAND_LENGTH - 1] = '\0';
-    p->finished = false;
-    p->error = false;
-    p->arrival_time = arrival_time;
-    p->start_time = 0;
-    p->completion_time = 0;
-    p->turnaround_time = 0;
-    p->waiting_time = 0;
-    p->response_time = 0;
-    p->burst_time = 0;
-    p->started = false;
-    p->process_id = -1;
-    p->priority = 1;  // Medium priority for MLFQ
-    p->remaining_time = get_historical_burst_time(historical_data, command);
-
-    list->count++;
-    return p;
-}
-
-void update_process_times(Process *p, uint64_t current_time) {
-    if (!p->started) {
-        p->start_time = current_time;
-        // p->response_time = p->start_time - p->arrival_time;
-        p->started = true;
-    }
-    // p->completion_time = current_time;
-    // p->turnaround_time = p->completion_time - p->arrival_time;
-    p->waiting_time = p->response_time;
-}
-
-void execute_process(Process *p, uint64_t quantum) {
-    pid_t pid;
-
-    if (p->process_id == -1) {
-        // If it's a new process, fork it
-        pid = fork();
-        if (pid == 0) {
-            // Child process
-            char *args[] = {"/bin/sh", "-c", p->command, NULL};
-            execvp(args[0], args);
-            fprintf(stderr, "Error executing command: %s\n", p->command);
-            exit(1);  // Exit if execvp fails
-        } else if (pid > 0) {
-            p->process_id = pid;
-        } else {
-            perror("fork failed");
-            p->finished = true;
-            p->error = true;
-            return;
-        }
-    } else {
-        // If process was previously stopped, resume it
-        if (kill(p->process_id, SIGCONT) < 0) {
-            if (errno == ESRCH) {
-                // Process doesn't exist anymore
-                p->finished = true;
-                p->error = true;
-                return;
-            }
-        }
+// Shortest Job First: pending jobs ranked by the average burst of their command so far
+typedef struct {
+    JobGroupTable ready;
+} SjfPolicy;
+
+void sjf_admit(void *policy, Engine *e, int job) {
+    Process *p = &e->jobs->processes[job];
+    const char *command = read_job_options(p);
+    p->remaining_time = get_historical_burst_time(&historical_data, command);
+    add_ready_job(&((SjfPolicy *)policy)->ready, job, command);
+}
+
+int sjf_pick(void *policy, Engine *e, uint64_t now_ns, int *level, uint64_t *quantum_ns) {
+    (void)e;
+    (void)now_ns;
+    SjfPolicy *sjf = (SjfPolicy *)policy;
+    int job = pop_shortest_job(&sjf->ready);
+    live_set_queue_depth(0, sjf->ready.pending_jobs);
+    *level = -1;
+    *quantum_ns = UINT64_MAX;
+    return job;
+}
+
+void sjf_requeue(void *policy, Engine *e, int job, int level) {
+    (void)level;
+    add_ready_job(&((SjfPolicy *)policy)->ready, job, read_job_options(&e->jobs->processes[job]));
+}
+
+void sjf_finish(void *policy, Engine *e, int job) {
+    Process *p = &e->jobs->processes[job];
+    if (!p->error) {
+        refresh_job_estimate(&((SjfPolicy *)policy)->ready, read_job_options(p));
     }
+}
 
-    uint64_t start_time = get_current_time_ms();
-    int status;
-    uint64_t elapsed_time = 0;
-
-    while (elapsed_time < quantum) {
-        pid_t result = waitpid(p->process_id, &status, WNOHANG);
-        if (result > 0) {
-            // Process finished
-            if (WIFEXITED(status)) {
-                p->finished = true;
-                p->error = (WEXITSTATUS(status) != 0);
-            } else if (WIFSIGNALED(status)) {
-                p->finished = true;
-                p->error = true;
-            }
-            break;
-        } else if (result < 0) {
-            if (errno == ECHILD) {
-                // No child process
-                p->finished = true;
-                p->error = true;
-            } else {
-                perror("waitpid");
-            }
-            break;
+static const PolicyOps sjf_ops = {
+    .admit = sjf_admit, .pick = sjf_pick, .requeue = sjf_requeue, .finish = sjf_finish
+};
+
+void ShortestJobFirst() {
+    static const EngineConfig config = {
+        .policy = POLICY_SJF, .name = "SJF", .levels = 1, .params = {0, 0, 0, 0}, .online = true,
+        .input_order_csv = false, .csv_file = "result_online_SJF.csv",
+        .csv_header = "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time\n",
+        .columnar_file = "result_online_SJF.cols", .distributable = true
+    };
+    SjfPolicy sjf = {{0}};
+    run_online(&config, &sjf_ops, &sjf);
+    free_job_groups(&sjf.ready);
+}
+
+// Online MLFQ: the shared MLFQ policy, except that a new job starts at the level its
+// command's average burst fits in (level 1 for commands never seen before)
+void online_mlfq_admit(void *policy, Engine *e, int job) {
+    MlfqPolicy *m = (MlfqPolicy *)policy;
+    Process *p = &e->jobs->processes[job];
+    const char *command = read_job_options(p);
+    uint64_t avg_burst_time = get_historical_burst_time(&historical_data, command);
+    int priority;
+    if (is_new_command(&historical_data, command)) {  // No historical data
+        priority = 1;  // Medium priority
+    } else {
+        // Assign priority based on average burst time
+        priority = 0;
+        while (priority < m->config->levels - 1 && ms_to_ns(avg_burst_time) > m->config->quantum_ns[priority]) {
+            priority++;
         }
-        elapsed_time = get_current_time_ms() - start_time;
     }
+    if (priority >= m->config->levels) {
+        priority = m->config->levels - 1;
+    }
+    p->priority = priority;
+    p->remaining_time = avg_burst_time;
+    mlfq_enqueue(m, job, priority);
+}
+
+static const PolicyOps online_mlfq_ops = {
+    .admit = online_mlfq_admit, .pick = mlfq_pick, .requeue = mlfq_requeue, .resume = mlfq_resume
+};
 
-    // If the process is still running after the quantum, stop it
-    if (!p->finished && elapsed_time >= quantum) {
-        kill(p->process_id, SIGSTOP);
+// Online MLFQ with any number of levels, configured at run time
+void ConfiguredOnlineMultiLevelFeedbackQueue(const MlfqConfig *mlfq_configuration) {
+    if (!mlfq_config_valid(mlfq_configuration)) {
+        return;
     }
+    EngineConfig config = {
+        .policy = POLICY_ONLINE_MLFQ, .name = "MLFQ", .levels = mlfq_configuration->levels,
+        .params = {0, 0, 0, 0}, .online = true, .input_order_csv = false, .csv_file = "result_online_MLFQ.csv",
+        .csv_header = "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time, Arrival time\n",
+        .columnar_file = "result_online_MLFQ.cols", .distributable = true
+    };
+    mlfq_trace_params(mlfq_configuration, config.params);
+    MlfqPolicy mlfq;
+    mlfq_init(&mlfq, mlfq_configuration);
+    run_online(&config, &online_mlfq_ops, &mlfq);
+    mlfq_free(&mlfq);
+}
 
-    // Update process times after execution
-    p->burst_time += elapsed_time;
-    p->remaining_time -= elapsed_time;
+// Called as MultiLevelFeedbackQueue(quantum0, quantum1, quantum2, boostTime)
+void OnlineMultiLevelFeedbackQueue(int quantum0, int quantum1, int quantum2, int boostTime) {
+    MlfqConfig mlfq_configuration = mlfq_config(quantum0, quantum1, quantum2, boostTime);
+    ConfiguredOnlineMultiLevelFeedbackQueue(&mlfq_configuration);
+}
 
-    uint64_t end_time = get_current_time_ms();
-    p->turnaround_time= p->response_time+p->burst_time;
-    // Print context switch only once
-    print_context_switch(p, start_time, end_time);
+static const PolicyOps online_adaptive_mlfq_ops = {
+    .admit = online_mlfq_admit, .pick = mlfq_pick, .requeue = mlfq_requeue, .finish = adaptive_mlfq_finish, .resume = mlfq_resume
+};
+
+// Online MLFQ with quanta and boost period tuned from the completed bursts, called as
+// AdaptiveMultiLevelFeedbackQueue(min_quantum, max_quantum). The configurations it goes
+// through are logged to result_online_MLFQ_tuning.csv.
+void OnlineAdaptiveMultiLevelFeedbackQueue(int min_quantum, int max_quantum) {
+    EngineConfig config = {
+        .policy = POLICY_ONLINE_ADAPTIVE_MLFQ, .name = "MLFQ", .levels = MLFQ_LEVELS,
+        .params = {(uint64_t)min_quantum, (uint64_t)max_quantum, 0, 0}, .online = true,
+        .input_order_csv = false, .csv_file = "result_online_MLFQ.csv",
+        .csv_header = "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time, Arrival time\n",
+        .columnar_file = "result_online_MLFQ.cols", .distributable = true
+    };
+    AdaptiveMlfqPolicy adaptive;
+    adaptive_mlfq_init(&adaptive, min_quantum, max_quantum, "result_online_MLFQ_tuning.csv");
+    run_online(&config, &online_adaptive_mlfq_ops, &adaptive);
+    adaptive_mlfq_free(&adaptive);
 }
 
+// Completely Fair Scheduler over the submissions, called as
+// CompletelyFairScheduler(target_latency, min_granularity)
+void OnlineCompletelyFairScheduler(int target_latency, int min_granularity) {
+    EngineConfig config = {
+        .policy = POLICY_ONLINE_CFS, .name = "CFS", .levels = 1,
+        .params = {(uint64_t)target_latency, (uint64_t)min_granularity, 0, 0}, .online = true,
+        .input_order_csv = false, .csv_file = "result_online_CFS.csv",
+        .csv_header = "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time\n",
+        .columnar_file = "result_online_CFS.cols"
+    };
+    CfsPolicy cfs;
+    cfs_init(&cfs, target_latency, min_granularity);
+    run_online(&config, &cfs_ops, &cfs);
+    cfs_free(&cfs);
+}
 
-void check_for_new_input_nonblocking(ProcessList *list, HistoricalDataList *historical_data, uint64_t arrival_time) {
-    char new_command[MAX_COMMAND_LENGTH];
-    int flags = fcntl(STDIN_FILENO, F_GETFL, 0);  // Get the current flags
-    fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);  // Set stdin to non-blocking mode
-    while (fgets(new_command, MAX_COMMAND_LENGTH, stdin)) {
-        new_command[strcspn(new_command, "\n")] = 0;  // Remove newline
-        if (strlen(new_command) > 0) {
-            add_process(list, new_command, historical_data, arrival_time);
-        }
-    }
+// Stride scheduling over the submissions, called as StrideScheduling(quantum). A line
+// "TICKETS=<n> command" gives the job n tickets.
+void OnlineStrideScheduling(int quantum) {
+    EngineConfig config = {
+        .policy = POLICY_ONLINE_STRIDE, .name = "stride", .levels = 1, .params = {(uint64_t)quantum, 0, 0, 0},
+        .online = true, .input_order_csv = false, .csv_file = "result_online_stride.csv",
+        .csv_header = "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time\n",
+        .columnar_file = "result_online_stride.cols"
+    };
+    StridePolicy stride;
+    stride_init(&stride, quantum);
+    run_online(&config, &stride_ops, &stride);
+    stride_free(&stride);
+}
 
-    fcntl(STDIN_FILENO, F_SETFL, flags);  // Restore original stdin flags
+// Lottery scheduling over the submissions, called as LotteryScheduling(quantum[, seed])
+void OnlineLotteryScheduling(int quantum, int seed) {
+    EngineConfig config = {
+        .policy = POLICY_ONLINE_LOTTERY, .name = "lottery", .levels = 1,
+        .params = {(uint64_t)quantum, (uint64_t)seed, 0, 0}, .online = true, .input_order_csv = false,
+        .csv_file = "result_online_lottery.csv",
+        .csv_header = "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time\n",
+        .columnar_file = "result_online_lottery.cols"
+    };
+    LotteryPolicy lottery;
+    lottery_init(&lottery, quantum, seed);
+    run_online(&config, &lottery_ops, &lottery);
+    lottery_free(&lottery);
 }
 
-void ShortestJobFirst() {
-    scheduler_start_time = get_current_time_ms();
-    uint64_t current_time = 0;
-    int completed = 0;
-    FILE *csv_file = fopen("result_online_SJF.csv", "w");
-    if (csv_file == NULL) {
-        perror("Error opening CSV file");
-        return;
+// Earliest Deadline First over the submissions, for jobs submitted as "DEADLINE=<ms> command"
+// (relative to their arrival). The runnable jobs are a heap on the absolute deadline and
+// the earliest one runs; jobs without a deadline run when no deadline job is runnable, in
+// arrival order. A submission ends the running slice (in a simulation, slices end at the
+// next arrival), so a job that arrives with an earlier deadline preempts the running one
+// at once, within the dispatcher's wakeup latency. Otherwise slices last quantum ms
+// (0 = until the job exits or the next submission comes in).
+//
+// A job is admitted if, going by the average burst of its command without the options
+// (new commands are assumed to fit), it and every runnable job due after it still finish by their deadlines
+// when run in deadline order. Otherwise it is rejected (reported as an error without
+// running) or, with reject_infeasible = 0, kept behind every feasible deadline job.
+#define EDF_LATE_CLASS (1ULL << 62)     // Key offset of jobs admitted past the feasibility test
+
+typedef struct {
+    KeyHeap runnable;       // Keyed on the absolute deadline
+    uint64_t *key;          // Per job
+    int job_capacity;
+    KeyHeapEntry *scratch;  // For the admission test
+    int scratch_capacity;
+    uint64_t quantum_ns;
+    bool reject_infeasible;
+    int deadlines;          // Jobs with a deadline, and what happened to them
+    int rejected;
+    int deprioritized;
+    int missed;
+    uint64_t max_lateness_ns;
+} EdfPolicy;
+
+void edf_init(EdfPolicy *d, int quantum, bool reject_infeasible) {
+    memset(d, 0, sizeof(*d));
+    d->quantum_ns = quantum > 0 ? ms_to_ns(quantum) : UINT64_MAX;
+    d->reject_infeasible = reject_infeasible;
+}
+
+void edf_free(EdfPolicy *d) {
+    free(d->runnable.entries);
+    free(d->key);
+    free(d->scratch);
+}
+
+int compare_heap_keys(const void *a, const void *b) {
+    return key_heap_before((KeyHeapEntry *)a, (KeyHeapEntry *)b) ? -1 : 1;
+}
+
+// Function to check whether every runnable deadline job still finishes in time once the
+// job (due at deadline_ns) is added, going by their estimated remaining bursts
+bool edf_feasible(EdfPolicy *d, Engine *e, int job, uint64_t deadline_ns) {
+    uint64_t now_ns = sched_now_ns();
+    uint64_t demand_ns = ms_to_ns(e->jobs->processes[job].remaining_time);
+    if (d->scratch_capacity < d->runnable.size) {
+        d->scratch_capacity = d->runnable.capacity;
+        d->scratch = (KeyHeapEntry *)realloc(d->scratch, d->scratch_capacity * sizeof(KeyHeapEntry));
     }
-    fprintf(csv_file, "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time\n");
-    while (1) {
-        // uint64_t arrival_time = get_current_time_ms();
-        check_for_new_input_nonblocking(&process_list, &historical_data,current_time);
-        int shortest_job = -1;
-        uint64_t min_burst_time = UINT64_MAX;
-
-        for (int i = 0; i < process_list.count; i++) {
-            if (!process_list.processes[i].finished) {
-                uint64_t estimated_burst_time = get_historical_burst_time(&historical_data, process_list.processes[i].command);
-                if (estimated_burst_time < min_burst_time) {
-                    shortest_job = i;
-                    min_burst_time = estimated_burst_time;
-                }
-            }
-        }
 
-        if (shortest_job != -1) {
-            Process *p = &process_list.processes[shortest_job];
-            p->response_time = current_time-(p->arrival_time);
-            execute_process(p, UINT64_MAX);
-            // current_time = get_current_time_ms();
-            update_process_times(p, current_time);
-
-            if (p->finished || p->error) {
-                completed++;
-                if (!p->error) {
-                    update_historical_data(&historical_data, p->command, p->burst_time);
-                }
-                fprintf(csv_file, "\"%s\",%s,%s,%lu,%lu,%lu,%lu\n",
-                        p->command,
-                        p->finished && !p->error ? "Yes" : "No",
-                        p->error ? "Yes" : "No",
-                        p->burst_time,
-                        p->turnaround_time,
-                        p->waiting_time,
-                        p->response_time);
-                fflush(csv_file);
-            }
-            current_time+=p->burst_time;
+    // Work due before the job runs ahead of it, work due after it is delayed by it
+    int later = 0;
+    for (int i = 0; i < d->runnable.size; i++) {
+        KeyHeapEntry *entry = &d->runnable.entries[i];
+        if (entry->key <= deadline_ns) {
+            demand_ns += ms_to_ns(e->jobs->processes[entry->job].remaining_time);
+        } else if (entry->key < EDF_LATE_CLASS) {
+            d->scratch[later++] = *entry;
         }
-
-        if (completed == process_list.count && feof(stdin)) {
-            break;
+    }
+    if (now_ns + demand_ns > deadline_ns) {
+        return false;
+    }
+    qsort(d->scratch, later, sizeof(KeyHeapEntry), compare_heap_keys);
+    for (int i = 0; i < later; i++) {
+        demand_ns += ms_to_ns(e->jobs->processes[d->scratch[i].job].remaining_time);
+        if (now_ns + demand_ns > d->scratch[i].key) {
+            return false;
         }
     }
-
-    fclose(csv_file);
+    return true;
 }
 
-bool is_new_command(HistoricalDataList *list, const char *command) {
-    for (int i = 0; i < list->count; i++) {
-        if (strcmp(list->data[i].command, command) == 0) {
-            return false;  // Command found in historical data
-        }
+void edf_admit(void *policy, Engine *e, int job) {
+    EdfPolicy *d = (EdfPolicy *)policy;
+    Process *p = &e->jobs->processes[job];
+    if (job >= d->job_capacity) {
+        d->job_capacity = e->jobs->capacity > job ? e->jobs->capacity : job + 1;
+        d->key = (uint64_t *)realloc(d->key, d->job_capacity * sizeof(uint64_t));
     }
-    return true;  // Command not found, so it's new
-}
-
-bool check_and_enqueue_new_processes(ProcessList *list, HistoricalDataList *historical_data, Queue *queues[], int quantum0, int quantum1) {
-    char new_command[MAX_COMMAND_LENGTH];
-    int flags = fcntl(STDIN_FILENO, F_GETFL, 0);  // Get the current flags
-    fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);  // Set stdin to non-blocking mode
-
-    bool new_process_added = false;
-    uint16_t arrival_time = get_current_time_ms();
-    while (fgets(new_command, MAX_COMMAND_LENGTH, stdin)) {
-        new_command[strcspn(new_command, "\n")] = 0;  // Remove newline
-        if (strlen(new_command) > 0) {
-            Process *new_p = add_process(list, new_command,historical_data,arrival_time);
-            if (new_p != NULL) {
-                uint64_t avg_burst_time = get_historical_burst_time(historical_data, new_command);
-                int priority;
-                bool check_new = is_new_command(historical_data, new_command);
-                if (check_new) {  // No historical data
-                    priority = 1;  // Medium priority
-                } else {
-                    // Assign priority based on average burst time
-                    if (avg_burst_time <= quantum0) priority = 0;
-                    else if (avg_burst_time <= quantum1) priority = 1;
-                    else priority = 2;
-                }
-
-                new_p->priority = priority;
-                enqueue(queues[priority], list->count - 1);  // Enqueue the index of the new process
-                new_process_added = true;
+    const char *command = read_job_options(p);
+    p->remaining_time = is_new_command(&historical_data, command)
+        ? 0 : get_historical_burst_time(&historical_data, command);
+
+    if (p->deadline_ns == 0) {
+        d->key[job] = UINT64_MAX;
+    } else {
+        d->deadlines++;
+        d->key[job] = p->arrival_ns + p->deadline_ns;
+        if (!edf_feasible(d, e, job, d->key[job])) {
+            if (d->reject_infeasible) {
+                d->rejected++;
+                engine_reject(e, job);
+                return;
             }
+            d->deprioritized++;
+            d->key[job] += EDF_LATE_CLASS;
         }
     }
+    key_heap_push(&d->runnable, job, d->key[job]);
+    live_set_queue_depth(0, d->runnable.size);
+}
 
-    fcntl(STDIN_FILENO, F_SETFL, flags);  // Restore original stdin flags
-    return new_process_added;
+int edf_pick(void *policy, Engine *e, uint64_t now_ns, int *level, uint64_t *quantum_ns) {
+    (void)e;
+    EdfPolicy *d = (EdfPolicy *)policy;
+    int job = key_heap_pop(&d->runnable);
+    live_set_queue_depth(0, d->runnable.size);
+    *level = -1;
+    *quantum_ns = d->quantum_ns;
+    uint64_t next_arrival_ns = next_submission_ns();
+    if (next_arrival_ns != UINT64_MAX && next_arrival_ns > now_ns && next_arrival_ns - now_ns < *quantum_ns) {
+        *quantum_ns = next_arrival_ns - now_ns;
+    }
+    return job;
+}
+
+void edf_requeue(void *policy, Engine *e, int job, int level) {
+    (void)e;
+    (void)level;
+    EdfPolicy *d = (EdfPolicy *)policy;
+    key_heap_push(&d->runnable, job, d->key[job]);
+}
+
+void edf_finish(void *policy, Engine *e, int job) {
+    EdfPolicy *d = (EdfPolicy *)policy;
+    Process *p = &e->jobs->processes[job];
+    uint64_t lateness_ns = deadline_lateness_ns(p);
+    if (lateness_ns > 0) {
+        d->missed++;
+        if (lateness_ns > d->max_lateness_ns) {
+            d->max_lateness_ns = lateness_ns;
+        }
+    }
 }
 
+static const PolicyOps edf_ops = {
+    .admit = edf_admit, .pick = edf_pick, .requeue = edf_requeue, .finish = edf_finish
+};
+
+// Called as EarliestDeadlineFirst(quantum, reject_infeasible). The CSV gets a Deadline column
+// (Met, Missed, Rejected or None) and the Lateness in ms.
+void EarliestDeadlineFirst(int quantum, int reject_infeasible) {
+    EngineConfig config = {
+        .policy = POLICY_EDF, .name = "EDF", .levels = 1,
+        .params = {(uint64_t)quantum, (uint64_t)reject_infeasible, 0, 0}, .online = true,
+        .input_order_csv = false, .csv_file = "result_online_EDF.csv",
+        .csv_header = "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time,Deadline,Lateness\n",
+        .columnar_file = "result_online_EDF.cols", .deadline_columns = true, .submission_preempts = true
+    };
+    EdfPolicy edf;
+    edf_init(&edf, quantum, reject_infeasible != 0);
+    run_online(&config, &edf_ops, &edf);
+    fprintf(stderr, "EDF: %d jobs with a deadline, %d missed (max lateness %lu ms), %d rejected, %d deprioritized\n",
+            edf.deadlines, edf.missed, ns_to_ms(edf.max_lateness_ns), edf.rejected, edf.deprioritized);
+    edf_free(&edf);
+}
 
-void handle_finished_process(Process *p, FILE *csv_file, int *completed, HistoricalDataList *historical_data) {
-    (*completed)++;
-    p->completion_time = get_current_time_ms() - scheduler_start_time;
-    p->turnaround_time = p->completion_time - (p->arrival_time - scheduler_start_time);
-    p->waiting_time = p->turnaround_time - p->burst_time;
+// Hierarchical fair share: submissions belong to tenants ("TENANT=<name> command", the
+// "default" tenant without one) and every slice first picks the tenant with the least
+// decayed CPU usage per share of weight ("SHARES=<n>" on any of its submissions sets the
+// tenant's weight, 1 by default), then the job within that tenant by the tenant's own
+// SJF, MLFQ or Round Robin queue. A tenant flooding the scheduler with jobs only gets
+// its share of the CPU; the others keep theirs. Usage decays by half every half_life ms,
+// so a tenant that was busy an hour ago is not penalised now (0 = never decays).
+//
+// Jobs are preempted every quantum ms so the tenant choice is revisited (MLFQ tenants
+// use quanta of 1x, 2x and 3x quantum with a 5x boost period instead); with quantum 0
+// every inner policy runs each job to completion. Per-tenant throughput and latency go
+// to stderr at the end.
+typedef enum {
+    TENANT_SJF,
+    TENANT_MLFQ,
+    TENANT_RR
+} TenantPolicy;
+
+#define TENANT_NAME_LENGTH 32
 
-    fprintf(csv_file, "\"%s\",%s,%s,%lu,%lu,%lu,%lu\n",
-            p->command,
-            p->finished && !p->error ? "Yes" : "No",
-            p->error ? "Yes" : "No",
-            p->burst_time,
-            p->turnaround_time,
-            p->waiting_time,
-            p->response_time);
-    fflush(csv_file);
+typedef struct {
+    char name[TENANT_NAME_LENGTH];
+    uint64_t weight;
+    uint64_t usage_ns;          // Decayed CPU time as of usage_stamp_ns
+    uint64_t usage_stamp_ns;
+    int runnable;
+    union {
+        SjfPolicy sjf;
+        MlfqPolicy mlfq;
+        RoundRobinPolicy rr;
+    } queue;
+    uint64_t completed;
+    uint64_t errors;
+    uint64_t cpu_ns;
+    Histogram *turnaround;
+    Histogram *response;
+} Tenant;
 
-    if (!p->error) {
-        update_historical_data(historical_data, p->command, p->burst_time);
+typedef struct {
+    TenantPolicy inner;
+    MlfqConfig mlfq_config;     // Shared by the MLFQ tenants
+    uint64_t quantum_ns;
+    uint64_t half_life_ns;
+    Tenant *tenants;
+    int count;
+    int capacity;
+    int *job_tenant;            // Per job
+    int job_capacity;
+    uint64_t picked_cpu_ns;     // cpu_ns of the running job when it was picked
+} FairSharePolicy;
+
+// 2^(-i/16) in 16-bit fixed point, for the fractional part of a half-life
+static const uint32_t half_life_fractions[17] = {
+    65536, 62757, 60097, 57549, 55109, 52773, 50535, 48393, 46341,
+    44376, 42495, 40693, 38968, 37316, 35734, 34219, 32768
+};
+
+// Function to decay a usage over elapsed_ns, halving it every half_life_ns
+uint64_t decayed_usage(uint64_t usage_ns, uint64_t elapsed_ns, uint64_t half_life_ns) {
+    if (half_life_ns == 0) {
+        return usage_ns;
+    }
+    uint64_t halvings = elapsed_ns / half_life_ns;
+    if (halvings >= 64) {
+        return 0;
     }
+    usage_ns >>= halvings;
+    uint32_t fraction = half_life_fractions[(elapsed_ns % half_life_ns) * 16 / half_life_ns];
+    return usage_ns / 65536 * fraction + usage_ns % 65536 * fraction / 65536;
 }
 
-void MultiLevelFeedbackQueue(int quantum0, int quantum1, int quantum2, int boostTime) {
-    scheduler_start_time = get_current_time_ms();
-    uint64_t current_time = 0;
-    int completed = 0;
-    uint64_t last_boost_time = 0;
-    FILE *csv_file = fopen("result_online_MLFQ.csv", "w");
-    if (csv_file == NULL) {
-        perror("Error opening CSV file");
-        return;
+void fair_share_init(FairSharePolicy *f, TenantPolicy inner, int quantum, int half_life) {
+    memset(f, 0, sizeof(*f));
+    f->inner = inner;
+    f->quantum_ns = quantum > 0 ? ms_to_ns(quantum) : UINT64_MAX;
+    f->half_life_ns = half_life > 0 ? ms_to_ns(half_life) : 0;
+    if (quantum > 0) {
+        f->mlfq_config = mlfq_config(quantum, 2 * quantum, 3 * quantum, 5 * quantum);
+    } else {
+        // Run to completion at every level, never boosted, as RR and SJF tenants do
+        MlfqConfig run_to_completion = {MLFQ_LEVELS, {UINT64_MAX, UINT64_MAX, UINT64_MAX}, UINT64_MAX};
+        f->mlfq_config = run_to_completion;
     }
-    fprintf(csv_file, "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time, Arrival time\n");
+}
 
-    Queue *queues[3];
-    for (int i = 0; i < 3; i++) {
-        queues[i] = create_queue();
+void fair_share_free(FairSharePolicy *f) {
+    for (int i = 0; i < f->count; i++) {
+        Tenant *t = &f->tenants[i];
+        if (f->inner == TENANT_SJF) {
+            free_job_groups(&t->queue.sjf.ready);
+        } else if (f->inner == TENANT_MLFQ) {
+            mlfq_free(&t->queue.mlfq);
+        } else {
+            free_queue(t->queue.rr.queue);
+        }
+        free(t->turnaround);
+        free(t->response);
     }
+    free(f->tenants);
+    free(f->job_tenant);
+}
 
-    while (1) {
-        current_time = get_current_time_ms() - scheduler_start_time;
-        
-        // Check and enqueue new processes if available
-        bool new_process_added = check_and_enqueue_new_processes(&process_list, &historical_data, queues, quantum0, quantum1);
-
-        // Boost process priorities if required
-        if (current_time - last_boost_time >= boostTime) {
-            for (int i = 0; i < process_list.count; i++) {
-                if (!process_list.processes[i].finished) {
-                    process_list.processes[i].priority = 0;
-                    enqueue(queues[0], i);  // Move all processes back to the highest priority queue
-                }
-            }
-            last_boost_time = current_time;
+// Function to find the tenant of a job from its options, creating it on first sight
+int find_tenant(FairSharePolicy *f, Process *p) {
+    char name[TENANT_NAME_LENGTH] = "default";
+    uint64_t shares = 0;
+    const char *s = p->command;
+    const char *option, *value;
+    size_t length;
+    while (next_job_option(&s, &option, &length, &value)) {
+        size_t value_length = strcspn(value, " \t");
+        if (length == 6 && strncmp(option, "TENANT", 6) == 0 && value_length > 0) {
+            snprintf(name, sizeof(name), "%.*s", (int)value_length, value);
+        } else if (length == 6 && strncmp(option, "SHARES", 6) == 0) {
+            shares = strtoull(value, NULL, 10);
         }
+    }
 
-        // Main loop over the priority queues
-        bool process_handled = false;  // Flag to track if any process was handled
-
-        for (int priority = 0; priority < 3; priority++) {
-            int quantum = (priority == 0) ? quantum0 : (priority == 1) ? quantum1 : quantum2;
-
-            // Process each queue until it's empty
-            while (queues[priority]->front != NULL) {
-                int i = dequeue(queues[priority]);
-                Process *p = &process_list.processes[i];
-
-                // Skip already finished processes
-                if (p->finished) continue;
-
-                // If the process hasn't started yet, set start time and response time
-                if (!p->started) {
-                    p->start_time = current_time;
-                    p->response_time = p->start_time - (p->arrival_time - scheduler_start_time);
-                    p->started = true;
-                }
-
-                uint64_t process_start_time = get_current_time_ms() - scheduler_start_time;
-                execute_process(p, quantum);
-                uint64_t process_end_time = get_current_time_ms() - scheduler_start_time;
-                current_time = process_end_time;
-
-                // Mark process as finished or enqueue in the next priority queue if not
-                if (p->finished || p->error) {
-                    handle_finished_process(p, csv_file, &completed, &historical_data);
-                } else {
-                    int next_priority = (priority < 2) ? priority + 1 : 2;
-                    p->priority = next_priority;
-                    enqueue(queues[next_priority], i);
-                }
-
-                // Boost priority check again after processing
-                if (current_time - last_boost_time >= boostTime) {
-                    for (int j = 0; j < process_list.count; j++) {
-                        if (!process_list.processes[j].finished) {
-                            process_list.processes[j].priority = 0;
-                            enqueue(queues[0], j);  // Boost all to highest priority
-                        }
-                    }
-                    last_boost_time = current_time;
-                }
-
-                process_handled = true;  // A process was handled, so the loop will continue
-
-                // If a new process was added, restart the priority loop from the beginning
-                if (new_process_added) {
-                    priority = -1;  // Reset priority to -1, so it becomes 0 in the next iteration
-                    break;  // Break out of the current priority loop to restart from highest priority
-                }
-            }
+    int i = 0;
+    while (i < f->count && strcmp(f->tenants[i].name, name) != 0) {
+        i++;
+    }
+    if (i == f->count) {
+        if (f->count == f->capacity) {
+            f->capacity = f->capacity ? f->capacity * 2 : 8;
+            f->tenants = (Tenant *)realloc(f->tenants, f->capacity * sizeof(Tenant));
         }
+        Tenant *t = &f->tenants[f->count++];
+        memset(t, 0, sizeof(*t));
+        strcpy(t->name, name);
+        t->weight = 1;
+        t->usage_stamp_ns = sched_now_ns();
+        t->turnaround = (Histogram *)calloc(1, sizeof(Histogram));
+        t->response = (Histogram *)calloc(1, sizeof(Histogram));
+        if (f->inner == TENANT_SJF) {
+            t->queue.sjf = (SjfPolicy){{0}};
+        } else if (f->inner == TENANT_MLFQ) {
+            mlfq_init(&t->queue.mlfq, &f->mlfq_config);
+        } else {
+            t->queue.rr = (RoundRobinPolicy){create_queue(), f->quantum_ns};
+        }
+    }
+    if (shares > 0) {
+        f->tenants[i].weight = shares;
+    }
+    return i;
+}
 
-        // If no processes were handled and no more input is available, break the loop
-        if (completed == process_list.count && feof(stdin) && !process_handled) {
-            break;
+// Function to charge the running job's tenant for the slice it just ran
+void fair_share_account(FairSharePolicy *f, Engine *e, int job) {
+    Tenant *t = &f->tenants[f->job_tenant[job]];
+    uint64_t now_ns = sched_now_ns();
+    uint64_t used_ns = e->jobs->processes[job].cpu_ns - f->picked_cpu_ns;
+    t->usage_ns = decayed_usage(t->usage_ns, now_ns - t->usage_stamp_ns, f->half_life_ns) + used_ns;
+    t->usage_stamp_ns = now_ns;
+    t->cpu_ns += used_ns;
+}
+
+void fair_share_admit(void *policy, Engine *e, int job) {
+    FairSharePolicy *f = (FairSharePolicy *)policy;
+    if (job >= f->job_capacity) {
+        f->job_capacity = e->jobs->capacity > job ? e->jobs->capacity : job + 1;
+        f->job_tenant = (int *)realloc(f->job_tenant, f->job_capacity * sizeof(int));
+    }
+    int tenant = find_tenant(f, &e->jobs->processes[job]);
+    Tenant *t = &f->tenants[tenant];
+    f->job_tenant[job] = tenant;
+    t->runnable++;
+    if (f->inner == TENANT_SJF) {
+        sjf_admit(&t->queue.sjf, e, job);
+    } else if (f->inner == TENANT_MLFQ) {
+        online_mlfq_admit(&t->queue.mlfq, e, job);
+    } else {
+        round_robin_admit(&t->queue.rr, e, job);
+    }
+}
+
+int fair_share_pick(void *policy, Engine *e, uint64_t now_ns, int *level, uint64_t *quantum_ns) {
+    FairSharePolicy *f = (FairSharePolicy *)policy;
+
+    // The runnable tenant furthest below its share: least usage / weight
+    Tenant *chosen = NULL;
+    uint64_t chosen_usage = 0;
+    for (int i = 0; i < f->count; i++) {
+        Tenant *t = &f->tenants[i];
+        if (t->runnable == 0) {
+            continue;
+        }
+        uint64_t usage = decayed_usage(t->usage_ns, now_ns - t->usage_stamp_ns, f->half_life_ns);
+        if (chosen == NULL || (unsigned __int128)usage * chosen->weight < (unsigned __int128)chosen_usage * t->weight) {
+            chosen = t;
+            chosen_usage = usage;
         }
     }
+    if (chosen == NULL) {
+        return -1;
+    }
+
+    int job;
+    chosen->runnable--;
+    if (f->inner == TENANT_SJF) {
+        job = sjf_pick(&chosen->queue.sjf, e, now_ns, level, quantum_ns);
+        *quantum_ns = f->quantum_ns;
+    } else if (f->inner == TENANT_MLFQ) {
+        job = mlfq_pick(&chosen->queue.mlfq, e, now_ns, level, quantum_ns);
+    } else {
+        job = round_robin_pick(&chosen->queue.rr, e, now_ns, level, quantum_ns);
+    }
+    if (job != -1) {
+        f->picked_cpu_ns = e->jobs->processes[job].cpu_ns;
+    }
+    return job;
+}
+
+void fair_share_requeue(void *policy, Engine *e, int job, int level) {
+    FairSharePolicy *f = (FairSharePolicy *)policy;
+    fair_share_account(f, e, job);
+    Tenant *t = &f->tenants[f->job_tenant[job]];
+    t->runnable++;
+    if (f->inner == TENANT_SJF) {
+        sjf_requeue(&t->queue.sjf, e, job, level);
+    } else if (f->inner == TENANT_MLFQ) {
+        mlfq_requeue(&t->queue.mlfq, e, job, level);
+    } else {
+        round_robin_requeue(&t->queue.rr, e, job, level);
+    }
+}
 
-    // Free all queues
-    for (int i = 0; i < 3; i++) {
-        free_queue(queues[i]);
+void fair_share_finish(void *policy, Engine *e, int job) {
+    FairSharePolicy *f = (FairSharePolicy *)policy;
+    Process *p = &e->jobs->processes[job];
+    fair_share_account(f, e, job);
+    Tenant *t = &f->tenants[f->job_tenant[job]];
+    t->completed++;
+    t->errors += p->error;
+    histogram_record(t->turnaround, p->completion_ns - p->arrival_ns);
+    histogram_record(t->response, p->first_run_ns - p->arrival_ns);
+    if (f->inner == TENANT_SJF) {
+        sjf_finish(&t->queue.sjf, e, job);
     }
-    fclose(csv_file);
 }
+
+static const PolicyOps fair_share_ops = {
+    .admit = fair_share_admit, .pick = fair_share_pick, .requeue = fair_share_requeue, .finish = fair_share_finish
+};
+
+// Function to print the throughput, CPU share and latency of every tenant
+void print_tenant_summary(FairSharePolicy *f, FILE *fp) {
+    uint64_t elapsed_ns = sched_now_ns() - sched_epoch_ns;
+    uint64_t total_cpu_ns = 0;
+    for (int i = 0; i < f->count; i++) {
+        total_cpu_ns += f->tenants[i].cpu_ns;
+    }
+    fprintf(fp, "Fair share tenants (ms)\n");
+    fprintf(fp, "%-20s %7s %8s %7s %10s %6s %8s %10s %10s %10s %10s\n", "tenant", "weight", "jobs", "errors",
+            "cpu", "share", "jobs/s", "turn p50", "turn p99", "resp p50", "resp p99");
+    for (int i = 0; i < f->count; i++) {
+        Tenant *t = &f->tenants[i];
+        bool done = t->completed > 0;
+        fprintf(fp, "%-20s %7lu %8lu %7lu %10.0f %5.1f%% %8.2f %10.1f %10.1f %10.1f %10.1f\n", t->name, t->weight,
+                t->completed, t->errors, (double)t->cpu_ns / NS_PER_MS,
+                total_cpu_ns ? 100.0 * t->cpu_ns / total_cpu_ns : 0.0,
+                elapsed_ns ? (double)t->completed * NS_PER_SEC / elapsed_ns : 0.0,
+                done ? (double)histogram_percentile(t->turnaround, 50.0) / NS_PER_MS : 0.0,
+                done ? (double)histogram_percentile(t->turnaround, 99.0) / NS_PER_MS : 0.0,
+                done ? (double)histogram_percentile(t->response, 50.0) / NS_PER_MS : 0.0,
+                done ? (double)histogram_percentile(t->response, 99.0) / NS_PER_MS : 0.0);
+    }
+}
+
+// Called as FairShareScheduler(inner, quantum, half_life), inner being TENANT_SJF,
+// TENANT_MLFQ or TENANT_RR
+void FairShareScheduler(TenantPolicy inner, int quantum, int half_life) {
+    EngineConfig config = {
+        .policy = POLICY_FAIR_SHARE, .name = "fair share", .levels = inner == TENANT_MLFQ ? MLFQ_LEVELS : 1,
+        .params = {(uint64_t)inner, (uint64_t)quantum, (uint64_t)half_life, 0}, .online = true,
+        .input_order_csv = false, .csv_file = "result_online_fair_share.csv",
+        .csv_header = "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time\n",
+        .columnar_file = "result_online_fair_share.cols"
+    };
+    FairSharePolicy fair_share;
+    fair_share_init(&fair_share, inner, quantum, half_life);
+    run_online(&config, &fair_share_ops, &fair_share);
+    print_tenant_summary(&fair_share, stderr);
+    fair_share_free(&fair_share);
+}
+
+// Online MLFQ for a fixed configuration in a static const table, see DEFINE_OFFLINE_MLFQ:
+//   DEFINE_ONLINE_MLFQ(ProductionOnlineMLFQ, production_mlfq)    // void ProductionOnlineMLFQ()
+#define DEFINE_ONLINE_MLFQ(scheduler, mlfq_configuration)                                           \
+    DEFINE_MLFQ_STEPS(scheduler, mlfq_configuration)                                                \
+    static const PolicyOps scheduler##_ops = {                                                      \
+        .admit = online_mlfq_admit, .pick = scheduler##_pick,                                       \
+        .requeue = scheduler##_requeue, .resume = mlfq_resume                                       \
+    };                                                                                              \
+    void scheduler() {                                                                              \
+        if (!mlfq_config_valid(&(mlfq_configuration))) {                                            \
+            return;                                                                                 \
+        }                                                                                           \
+        EngineConfig config = {                                                                     \
+            .policy = POLICY_ONLINE_MLFQ, .name = "MLFQ", .levels = (mlfq_configuration).levels,    \
+            .params = {0, 0, 0, 0}, .online = true, .input_order_csv = false,                       \
+            .csv_file = "result_online_MLFQ.csv",                                                   \
+            .csv_header = "Command,Finished,Error,Burst Time,Turnaround Time,Waiting Time,Response Time, Arrival time\n", \
+            .columnar_file = "result_online_MLFQ.cols", .distributable = true                       \
+        };                                                                                          \
+        mlfq_trace_params(&(mlfq_configuration), config.params);                                    \
+        MlfqPolicy mlfq;                                                                            \
+        mlfq_init(&mlfq, &(mlfq_configuration));                                                    \
+        run_online(&config, &scheduler##_ops, &mlfq);                                               \
+        mlfq_free(&mlfq);                                                                           \
+    }
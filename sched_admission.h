@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "sched_clock.h"
+#include "sched_live.h"
+
+// Admission control for the online schedulers. Without it every submission is accepted
+// until the process list is full, and under overload the wait of each new job grows
+// without bound. A submission is over budget when
+//
+//   SCHED_ADMIT_MAX_QUEUE=<n>     n jobs are already waiting or running, or
+//   SCHED_ADMIT_MAX_WAIT_MS=<ms>  its predicted wait exceeds ms. By Little's law the wait
+//                                 is the jobs in the system times the mean service time,
+//                                 the moving average of the completed jobs' bursts.
+//
+// and is then rejected (SCHED_ADMIT_ACTION=reject, the default: it completes at once as
+// an error) or deferred (defer: it waits outside the scheduler, in submission order,
+// until the budget has room again). Either way the submitter gets a "Rejected: ..." or
+// "Deferred: ..." line on stdout. The counters go to the live page and the summary.
+
+typedef enum {
+    ADMIT_ACCEPT,
+    ADMIT_DEFER,
+    ADMIT_REJECT
+} AdmissionDecision;
+
+typedef struct {
+    uint64_t max_queue;         // 0 = no limit
+    uint64_t max_wait_ns;       // 0 = no limit
+    bool defer;
+    uint64_t mean_burst_ns;     // Moving average over the completed jobs, 0 before the first
+    uint64_t in_system;         // Admitted and not finished yet
+    uint64_t deferred;          // Waiting for admission right now
+    uint64_t max_deferred;
+    uint64_t total_rejected;
+    uint64_t total_deferred;
+} Admission;
+
+Admission admission = {0};
+
+uint64_t admission_env(const char *name) {
+    const char *value = getenv(name);
+    return value != NULL ? strtoull(value, NULL, 10) : 0;
+}
+
+// Function to read the budget and reset the counters at the start of a run
+void admission_begin_run() {
+    memset(&admission, 0, sizeof(admission));
+    admission.max_queue = admission_env("SCHED_ADMIT_MAX_QUEUE");
+    admission.max_wait_ns = ms_to_ns(admission_env("SCHED_ADMIT_MAX_WAIT_MS"));
+    const char *action = getenv("SCHED_ADMIT_ACTION");
+    if (action != NULL && strcmp(action, "defer") == 0) {
+        admission.defer = true;
+    } else if (action != NULL && action[0] != '\0' && strcmp(action, "reject") != 0) {
+        fprintf(stderr, "Unknown SCHED_ADMIT_ACTION %s, using reject\n", action);
+    }
+}
+
+bool admission_enabled() {
+    return admission.max_queue > 0 || admission.max_wait_ns > 0;
+}
+
+uint64_t admission_predicted_wait_ns() {
+    return admission.in_system * admission.mean_burst_ns;
+}
+
+// Function to tell whether one more job fits in the budget
+bool admission_has_room() {
+    if (admission.max_queue > 0 && admission.in_system >= admission.max_queue) {
+        return false;
+    }
+    return admission.max_wait_ns == 0 || admission_predicted_wait_ns() <= admission.max_wait_ns;
+}
+
+void admission_publish() {
+    if (live_stats == NULL) {
+        return;
+    }
+    live_write_begin();
+    live_stats->in_system = admission.in_system;
+    live_stats->deferred = admission.deferred;
+    live_stats->rejected = admission.total_rejected;
+    live_write_end();
+}
+
+// Function to decide on a new submission. Jobs deferred earlier go first, so while any
+// is waiting a new one is deferred too.
+AdmissionDecision admission_decide() {
+    if (admission.deferred == 0 && admission_has_room()) {
+        return ADMIT_ACCEPT;
+    }
+    return admission.defer ? ADMIT_DEFER : ADMIT_REJECT;
+}
+
+// Function to print the response to an over-budget submission and count it
+void admission_respond(AdmissionDecision decision, const char *command) {
+    if (decision == ADMIT_REJECT) {
+        admission.total_rejected++;
+        printf("Rejected: %s (%lu jobs in the system, predicted wait %lu ms)\n",
+               command, admission.in_system, ns_to_ms(admission_predicted_wait_ns()));
+    } else {
+        admission.total_deferred++;
+        if (++admission.deferred > admission.max_deferred) {
+            admission.max_deferred = admission.deferred;
+        }
+        printf("Deferred: %s (%lu jobs in the system, predicted wait %lu ms)\n",
+               command, admission.in_system, ns_to_ms(admission_predicted_wait_ns()));
+    }
+    admission_publish();
+}
+
+void admission_record_admit(bool was_deferred) {
+    admission.in_system++;
+    if (was_deferred) {
+        admission.deferred--;
+    }
+    admission_publish();
+}
+
+// Function to count a job leaving the system; one that did not run (rejected) leaves the
+// service time estimate alone
+void admission_record_exit(uint64_t cpu_ns, bool ran) {
+    if (admission.in_system > 0) {
+        admission.in_system--;
+    }
+    // Moving average with a weight of 1/8 for the newest burst
+    if (!ran) {
+        // Nothing to learn from
+    } else if (admission.mean_burst_ns == 0) {
+        admission.mean_burst_ns = cpu_ns;
+    } else {
+        admission.mean_burst_ns = admission.mean_burst_ns - admission.mean_burst_ns / 8 + cpu_ns / 8;
+    }
+    admission_publish();
+}
+
+void admission_print_summary(FILE *fp) {
+    if (!admission_enabled() && admission.total_rejected == 0) {
+        return;
+    }
+    fprintf(fp, "Admission: %lu rejected, %lu deferred (at most %lu at once), mean burst %lu ms\n",
+            admission.total_rejected, admission.total_deferred, admission.max_deferred,
+            ns_to_ms(admission.mean_burst_ns));
+}
@@ -0,0 +1,696 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "sched_clock.h"
+#include "sched_trace.h"
+#include "sched_output.h"
+#include "sched_input.h"
+#include "sched_uring.h"
+#include "sched_jitter.h"
+
+// Outcome of running a job for (at most) one quantum
+typedef struct {
+    uint64_t start_ns;
+    uint64_t end_ns;
+    bool exited;    // The job is done and must not be run again
+    bool error;     // Non-zero exit status, killed by a signal or could not be started
+} SliceResult;
+
+// Declared behaviour of one job for the simulation backend
+typedef struct {
+    char *command;
+    uint64_t arrival_ns;    // Offset from the start of the run, used by the online schedulers
+    uint64_t burst_ns;      // CPU time the job needs before it exits
+    uint64_t remaining_ns;
+    uint64_t finish_ns;     // When a job started by start_job exits
+    int exit_status;
+} SimJob;
+
+typedef struct {
+    SimJob *jobs;
+    int count;
+    int next_arrival;       // Index of the first job not yet submitted
+    uint64_t switch_cost_ns;  // Virtual time charged for every slice on top of the job's own run
+} SimProfile;
+
+SimProfile sim_profile = {0};
+
+// Function to execute a command (in the child, never returns). io holds the ends of the
+// job's pipes (see sched_output.h), NULL or -1 where the output mode's default applies.
+void execute_command(const char* command, const JobIo *io) {
+    low_jitter_leave();
+    int output_fd = io != NULL ? io->stdout_fd : -1;
+    int error_fd = io != NULL ? io->stderr_fd : -1;
+    int devnull = -1;
+    if ((output_fd == -1 || error_fd == -1) && job_output_mode != JOB_OUTPUT_INHERIT) {
+        // Redirect output to /dev/null
+        devnull = open("/dev/null", O_WRONLY);
+        if (devnull == -1) {
+            exit(1);
+        }
+        output_fd = output_fd == -1 ? devnull : output_fd;
+        error_fd = error_fd == -1 ? devnull : error_fd;
+    }
+    if (io != NULL && io->stdin_fd != -1) {
+        dup2(io->stdin_fd, STDIN_FILENO);
+    }
+    if (output_fd != -1) {
+        dup2(output_fd, STDOUT_FILENO);
+    }
+    if (error_fd != -1) {
+        dup2(error_fd, STDERR_FILENO);
+    }
+    if (devnull != -1) {
+        close(devnull);
+    }
+
+    // Execute the command using /bin/sh
+    char *args[] = {"/bin/sh", "-c", (char*)command, NULL};
+    execvp(args[0], args);
+    fprintf(stderr, "Error executing command: %s\n", command);
+    exit(1);
+}
+
+// Function to run a simulated job for up to quantum_ns of virtual time
+SliceResult run_simulated_slice(int job, pid_t *pid, uint64_t quantum_ns) {
+    SimJob *j = &sim_profile.jobs[job];
+    SliceResult r = {sim_clock_ns, sim_clock_ns, false, false};
+
+    if (*pid == -1) {
+        *pid = job;
+        j->remaining_ns = j->burst_ns;
+        trace_spawn(job, r.start_ns, *pid);
+    }
+
+    uint64_t run_ns = j->remaining_ns < quantum_ns ? j->remaining_ns : quantum_ns;
+    j->remaining_ns -= run_ns;
+    r.end_ns = r.start_ns + run_ns;
+    sim_clock_ns = r.end_ns + sim_profile.switch_cost_ns;
+    trace_slice(job, r.start_ns, r.end_ns, quantum_ns);
+
+    if (j->remaining_ns == 0) {
+        r.exited = true;
+        r.error = j->exit_status != 0;
+        trace_exit(job, r.end_ns, j->exit_status, j->burst_ns, 0);
+    }
+    return r;
+}
+
+// Function to turn a wait status into a shell-style exit code (128 + signal when killed)
+int exit_code_of(int status) {
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return 255;
+}
+
+// Function to wait until pid exits or the monotonic clock reaches deadline_ns (UINT64_MAX:
+// no limit), reading the submissions that arrive meanwhile (see sched_input.h), or until
+// one does when they end slices. True when it exited (left unreaped for wait4 to collect
+// its status and CPU time) or cannot be waited for. Sleeps in ppoll on stdin and a pidfd of the job; without pidfd_open (kernels
+// before 5.3) it checks on the job every millisecond instead.
+bool wait_exit_reading_input(pid_t pid, uint64_t deadline_ns) {
+    slice_syscalls++;
+    int pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+    bool exited = false;
+    while (!exited) {
+        uint64_t now_ns = sched_now_ns();
+        if (now_ns >= deadline_ns) {
+            break;
+        }
+        uint64_t timeout_ns = deadline_ns - now_ns;
+        if (pidfd < 0 && timeout_ns > NS_PER_MS) {
+            timeout_ns = NS_PER_MS;
+        }
+        bool reading = !submission_input.eof && input_make_room();
+        struct pollfd fds[2] = {{reading ? STDIN_FILENO : -1, POLLIN, 0}, {pidfd, POLLIN, 0}};
+        struct timespec ts = {(time_t)(timeout_ns / NS_PER_SEC), (long)(timeout_ns % NS_PER_SEC)};
+        slice_syscalls++;
+        syscall(SYS_ppoll, fds, 2, deadline_ns == UINT64_MAX && pidfd >= 0 ? NULL : &ts, NULL, 0);
+        if (fds[0].revents != 0 && input_read_available() && submission_input.ends_slices) {
+            break;
+        }
+        if (pidfd >= 0) {
+            exited = fds[1].revents != 0;
+        } else {
+            siginfo_t info;
+            info.si_pid = 0;
+            slice_syscalls++;
+            exited = waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) != 0 || info.si_pid == pid;
+        }
+    }
+    if (pidfd >= 0) {
+        close(pidfd);
+    }
+    return exited;
+}
+
+// Function to fork (or resume) a job and let it run for up to quantum_ns.
+// job identifies the job within the simulation profile, *pid is -1 until the job is spawned.
+// A job that left a batch (see run_batch) runs on in the batch shell, whose process group
+// *pid then is (-pid of the shell): it is stopped and continued as a whole.
+SliceResult run_slice(int job, pid_t *pid, const char *command, uint64_t quantum_ns) {
+    if (sched_simulated) {
+        return run_simulated_slice(job, pid, quantum_ns);
+    }
+
+    SliceResult r = {sched_now_ns(), 0, false, false};
+
+    // Fork or continue the process
+    slice_syscalls++;
+    if (*pid == -1) {
+        JobIo io;
+        job_output_prepare(job, command, &io);
+        *pid = fork();
+        if (*pid == 0) {
+            execute_command(command, &io);
+        }
+        job_output_started(job, &io, *pid > 0);
+        if (*pid < 0) {
+            perror("fork failed");
+            r.end_ns = sched_now_ns();
+            r.exited = true;
+            r.error = true;
+            trace_slice(job, r.start_ns, r.end_ns, quantum_ns);
+            trace_exit(job, r.end_ns, 255, 0, 0);
+            return r;
+        }
+        trace_spawn(job, r.start_ns, *pid);
+    } else if (kill(*pid, SIGCONT) < 0 && errno == ESRCH) {
+        // Process doesn't exist anymore
+        r.end_ns = sched_now_ns();
+        r.exited = true;
+        r.error = true;
+        trace_slice(job, r.start_ns, r.end_ns, quantum_ns);
+        trace_exit(job, r.end_ns, 255, 0, 0);
+        return r;
+    }
+
+    int status;
+    struct rusage usage = {0};
+    int exit_code = 255;
+    pid_t child = *pid < -1 ? -*pid : *pid;
+    r.end_ns = r.start_ns;
+
+    // Allow the process to execute for a duration up to the quantum: the io_uring backend,
+    // and the default one while it reads the submissions of an online run, sleep until it
+    // exits, the quantum ends or a submission ends the slice, then reap it if it exited;
+    // otherwise wait4 is polled until the quantum is over
+    if (uring_enabled() || submission_input.during_slices) {
+        uint64_t deadline_ns = quantum_ns == UINT64_MAX ? UINT64_MAX : r.start_ns + quantum_ns;
+        r.exited = uring_enabled() ? uring_wait_exit(child, deadline_ns) : wait_exit_reading_input(child, deadline_ns);
+        r.end_ns = sched_now_ns();
+        if (r.exited) {
+            pid_t result;
+            do {
+                slice_syscalls++;
+                result = wait4(child, &status, 0, &usage);
+            } while (result < 0 && errno == EINTR);
+            exit_code = result > 0 ? exit_code_of(status) : 255;
+            r.error = exit_code != 0;
+        }
+    } else {
+        while (!r.exited && r.end_ns - r.start_ns < quantum_ns) {
+            slice_syscalls++;
+            pid_t result = wait4(child, &status, quantum_ns == UINT64_MAX ? 0 : WNOHANG, &usage);
+            r.end_ns = sched_now_ns();
+            if (result > 0) {
+                r.exited = true;
+                exit_code = exit_code_of(status);
+                r.error = exit_code != 0;
+                break;
+            } else if (result < 0 && errno != EINTR) {
+                // Error occurred while waiting for the process to finish
+                r.exited = true;
+                r.error = true;
+                break;
+            }
+        }
+    }
+
+    // If the process is still running after the quantum, stop it
+    if (!r.exited) {
+        slice_syscalls++;
+        kill(*pid, SIGSTOP);
+    }
+
+    trace_slice(job, r.start_ns, r.end_ns, quantum_ns);
+    if (r.exited) {
+        trace_exit(job, r.end_ns, exit_code,
+                   (uint64_t)usage.ru_utime.tv_sec * NS_PER_SEC + (uint64_t)usage.ru_utime.tv_usec * 1000,
+                   (uint64_t)usage.ru_stime.tv_sec * NS_PER_SEC + (uint64_t)usage.ru_stime.tv_usec * 1000);
+    }
+    return r;
+}
+
+#define BATCH_STATUS_FD 9   // Where a batch's shell reports the exit status of each of its jobs
+#define BATCH_START_FD 8    // Where it waits for the go-ahead to start its next job
+#define BATCH_STATUS_BUFFER 64
+
+// Function to append a command to a batch script: wait for the go-ahead, run the command
+// in a subshell, so its cd, exit or syntax error stays its own, then report its exit
+// status. A shell that can no longer report (its job left the batch, see run_batch) exits
+// with the job's status instead of going on with the next one.
+char *append_batch_job(char *s, const char *command) {
+    s += sprintf(s, "read -r _ <&%d || exit 0; ( trap - PIPE; eval '", BATCH_START_FD);
+    for (const char *c = command; *c != '\0'; c++) {
+        if (*c == '\'') {
+            s += sprintf(s, "'\\''");
+        } else {
+            *s++ = *c;
+        }
+    }
+    return s + sprintf(s, "' ) %d<&- %d>&-; s=$?; echo $s 2>&- >&%d || exit $s\n",
+                       BATCH_START_FD, BATCH_STATUS_FD, BATCH_STATUS_FD);
+}
+
+// Function to wait for the next exit status a batch's shell reports, until deadline_ns
+// (UINT64_MAX: no limit, 0: just check), reading the submissions that arrive meanwhile
+// during online runs. -1 when the deadline passed first, -2 when the shell is gone.
+int batch_next_status(int fd, char buffer[], size_t *used, uint64_t deadline_ns) {
+    while (true) {
+        char *newline = (char *)memchr(buffer, '\n', *used);
+        if (newline != NULL) {
+            int exit_code = atoi(buffer);
+            *used -= newline + 1 - buffer;
+            memmove(buffer, newline + 1, *used);
+            return exit_code;
+        }
+        uint64_t now_ns = sched_now_ns();
+        uint64_t timeout_ns = deadline_ns > now_ns ? deadline_ns - now_ns : 0;
+        bool ring = uring_enabled();
+        bool reading = submission_input.during_slices && (ring || (!submission_input.eof && input_make_room()));
+        struct pollfd fds[2] = {{fd, POLLIN, 0}, {reading ? (ring ? sched_uring.fd : STDIN_FILENO) : -1, POLLIN, 0}};
+        struct timespec ts = {(time_t)(timeout_ns / NS_PER_SEC), (long)(timeout_ns % NS_PER_SEC)};
+        slice_syscalls++;
+        syscall(SYS_ppoll, fds, 2, deadline_ns == UINT64_MAX ? NULL : &ts, NULL, 0);
+        if (fds[1].revents != 0) {
+            if (ring) {
+                uring_enter(&sched_uring, 0, 0);    // Takes in the standing read, see sched_uring.h
+            } else {
+                input_read_available();
+            }
+        }
+        if (fds[0].revents != 0) {
+            ssize_t n = read(fd, buffer + *used, BATCH_STATUS_BUFFER - 1 - *used);
+            if (n > 0) {
+                *used += n;
+            } else if (n == 0 || errno != EINTR) {
+                return -2;
+            }
+        } else if (sched_now_ns() >= deadline_ns) {
+            return -1;
+        }
+    }
+}
+
+// Function to run count tiny jobs one after the other in a single shell, sparing each its
+// own fork and exec of /bin/sh. The shell starts each job on the dispatcher's go-ahead and
+// writes its exit status to a pipe as soon as it is done, so every job gets its own start,
+// end and status in results[i], and is held to its quantum quanta[i]. A job still running
+// at the end of its quantum leaves the batch: the shell's process group, its own, is
+// stopped and handed back as the job's process in *stopped (a negative process id, see
+// run_slice), with the slice in results[i] not exited. The shell then exits with the
+// job's status once it is done. A job the shell never reported (it was killed) gets an
+// error. Returns how many jobs ran; the jobs after them did not start.
+int run_batch(const int jobs[], char *const commands[], const uint64_t quanta[], int count,
+              SliceResult results[], pid_t *stopped) {
+    size_t length = 16;
+    for (int i = 0; i < count; i++) {
+        length += strlen(commands[i]) * 4 + 128;
+    }
+    char *script = (char *)malloc(length);
+    char *end = script + sprintf(script, "trap '' PIPE\n");
+    for (int i = 0; i < count; i++) {
+        end = append_batch_job(end, commands[i]);
+    }
+    *end = '\0';
+
+    // The dispatcher keeps its own read end of the go-ahead pipe, so a go-ahead to a shell
+    // that was killed is not a SIGPIPE
+    int status_pipe[2] = {-1, -1};
+    int start_pipe[2] = {-1, -1};
+    pid_t pid = -1;
+    *stopped = -1;
+    if (pipe(status_pipe) != 0 || pipe(start_pipe) != 0) {
+        perror("Error creating batch pipes");
+    } else {
+        for (int i = 0; i < 2; i++) {
+            fcntl(status_pipe[i], F_SETFD, FD_CLOEXEC);
+            fcntl(start_pipe[i], F_SETFD, FD_CLOEXEC);
+        }
+        pid = fork();
+        if (pid == 0) {
+            setpgid(0, 0);
+            dup2(status_pipe[1], BATCH_STATUS_FD);
+            dup2(start_pipe[0], BATCH_START_FD);
+            execute_command(script, NULL);
+        }
+        if (pid > 0) {
+            setpgid(pid, pid);  // Here too, so the group exists before it is signalled
+        } else {
+            perror("fork failed");
+        }
+    }
+    free(script);
+    if (status_pipe[1] != -1) {
+        close(status_pipe[1]);
+    }
+
+    int done = 0;
+    char buffer[BATCH_STATUS_BUFFER];
+    size_t used = 0;
+    while (pid > 0 && done < count) {
+        uint64_t start_ns = sched_now_ns();
+        trace_spawn(jobs[done], start_ns, pid);
+        slice_syscalls++;
+        int exit_code = write(start_pipe[1], "\n", 1) == 1
+            ? batch_next_status(status_pipe[0], buffer, &used,
+                                quanta[done] == UINT64_MAX ? UINT64_MAX : start_ns + quanta[done])
+            : -2;
+        if (exit_code == -1) {
+            // Over its quantum: stop the shell, unless the job was done just now
+            slice_syscalls++;
+            kill(-pid, SIGSTOP);
+            exit_code = batch_next_status(status_pipe[0], buffer, &used, 0);
+            if (exit_code == -1) {
+                results[done] = (SliceResult){start_ns, sched_now_ns(), false, false};
+                trace_slice(jobs[done], start_ns, results[done].end_ns, quanta[done]);
+                *stopped = -pid;
+                done++;
+                break;
+            }
+            kill(-pid, SIGCONT);
+        }
+        uint64_t end_ns = sched_now_ns();
+        results[done] = (SliceResult){start_ns, end_ns, true, exit_code != 0};
+        trace_slice(jobs[done], start_ns, end_ns, quanta[done]);
+        trace_exit(jobs[done], end_ns, exit_code >= 0 ? exit_code : 255, 0, 0);
+        done++;
+        if (exit_code == -2) {
+            break;      // The shell is gone; the jobs after this one were not started
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        if (start_pipe[i] != -1) {
+            close(start_pipe[i]);
+        }
+    }
+    if (status_pipe[0] != -1) {
+        close(status_pipe[0]);
+    }
+    if (pid > 0 && *stopped == -1) {
+        while (waitpid(pid, NULL, 0) < 0 && errno == EINTR) {
+        }
+    }
+
+    // Without a shell to run them, every job is an error
+    uint64_t now_ns = sched_now_ns();
+    for (; pid <= 0 && done < count; done++) {
+        results[done] = (SliceResult){now_ns, now_ns, true, true};
+        trace_slice(jobs[done], now_ns, now_ns, quanta[done]);
+        trace_exit(jobs[done], now_ns, 255, 0, 0);
+    }
+    return done;
+}
+
+// Function to start a job that runs to completion alongside other jobs, instead of one
+// slice at a time. The start time goes to *start_ns; false if the job could not be started.
+bool start_job(int job, pid_t *pid, const char *command, uint64_t *start_ns) {
+    if (sched_simulated) {
+        SimJob *j = &sim_profile.jobs[job];
+        *pid = job;
+        *start_ns = sim_clock_ns;
+        j->remaining_ns = 0;
+        j->finish_ns = sim_clock_ns + j->burst_ns;
+        trace_spawn(job, *start_ns, *pid);
+        return true;
+    }
+
+    *start_ns = sched_now_ns();
+    JobIo io;
+    job_output_prepare(job, command, &io);
+    *pid = fork();
+    if (*pid == 0) {
+        execute_command(command, &io);
+    }
+    job_output_started(job, &io, *pid > 0);
+    if (*pid < 0) {
+        perror("fork failed");
+        trace_slice(job, *start_ns, *start_ns, UINT64_MAX);
+        trace_exit(job, *start_ns, 255, 0, 0);
+        return false;
+    }
+    trace_spawn(job, *start_ns, *pid);
+    return true;
+}
+
+// Function to wait until one of the count jobs started with start_job exits: running[]
+// holds their job indices, pids[] and start_ns[] what start_job returned for them.
+// Returns the position of the job in running[], with its whole run in *r. Only these jobs
+// are waited for, so other children of the program keep their exit status: the dispatcher
+// sleeps in ppoll on a pidfd per job (without pidfd_open, kernels before 5.3, it checks on
+// them every millisecond instead). A job that cannot be waited for is the one returned,
+// with an error.
+int wait_for_job_exit(const int running[], const pid_t pids[], const uint64_t start_ns[], int count, SliceResult *r) {
+    int position = -1;
+    int exit_code = 255;
+    struct rusage usage = {0};
+
+    if (sched_simulated) {
+        // The job that finishes first on the virtual clock
+        for (int i = 0; i < count; i++) {
+            if (position == -1 || sim_profile.jobs[running[i]].finish_ns < sim_profile.jobs[running[position]].finish_ns) {
+                position = i;
+            }
+        }
+        SimJob *j = &sim_profile.jobs[running[position]];
+        exit_code = j->exit_status;
+        r->end_ns = j->finish_ns;
+        if (sim_clock_ns < j->finish_ns + sim_profile.switch_cost_ns) {
+            sim_clock_ns = j->finish_ns + sim_profile.switch_cost_ns;
+        }
+    } else {
+        struct pollfd *fds = (struct pollfd *)malloc(count * sizeof(struct pollfd));
+        bool checking = false;  // Some job has no pidfd
+        for (int i = 0; i < count; i++) {
+            slice_syscalls++;
+            fds[i] = (struct pollfd){(int)syscall(SYS_pidfd_open, pids[i], 0), POLLIN, 0};
+            checking |= fds[i].fd < 0;
+        }
+        while (position == -1) {
+            for (int i = 0; i < count && position == -1; i++) {
+                if (fds[i].fd >= 0 && fds[i].revents == 0) {
+                    continue;
+                }
+                int status;
+                slice_syscalls++;
+                pid_t result = wait4(pids[i], &status, WNOHANG, &usage);
+                if (result == pids[i]) {
+                    position = i;
+                    exit_code = exit_code_of(status);
+                } else if (result < 0 && errno != EINTR) {
+                    perror("wait4 failed");
+                    position = i;
+                }
+            }
+            if (position == -1) {
+                struct timespec ts = {0, NS_PER_MS};
+                slice_syscalls++;
+                syscall(SYS_ppoll, fds, count, checking ? &ts : NULL, NULL, 0);
+            }
+        }
+        for (int i = 0; i < count; i++) {
+            if (fds[i].fd >= 0) {
+                close(fds[i].fd);
+            }
+        }
+        free(fds);
+        r->end_ns = sched_now_ns();
+    }
+
+    int job = running[position];
+    r->start_ns = start_ns[position];
+    r->exited = true;
+    r->error = exit_code != 0;
+    trace_slice(job, r->start_ns, r->end_ns, UINT64_MAX);
+    trace_exit(job, r->end_ns, exit_code,
+               (uint64_t)usage.ru_utime.tv_sec * NS_PER_SEC + (uint64_t)usage.ru_utime.tv_usec * 1000,
+               (uint64_t)usage.ru_stime.tv_sec * NS_PER_SEC + (uint64_t)usage.ru_stime.tv_usec * 1000);
+    return position;
+}
+
+// Function to load a simulation profile, one job per line: "arrival_ms burst_ms exit_status command".
+// Times may be fractional, blank lines and lines starting with '#' are skipped.
+bool load_sim_profile(FILE *fp, SimProfile *profile) {
+    char line[4096];
+    int capacity = 0;
+    profile->jobs = NULL;
+    profile->count = 0;
+    profile->next_arrival = 0;
+
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\n")] = 0;
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+
+        double arrival_ms, burst_ms;
+        int exit_status, offset;
+        if (sscanf(line, "%lf %lf %d %n", &arrival_ms, &burst_ms, &exit_status, &offset) != 3 || line[offset] == '\0') {
+            fprintf(stderr, "Malformed profile line: %s\n", line);
+            return false;
+        }
+
+        if (profile->count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            profile->jobs = (SimJob *)realloc(profile->jobs, capacity * sizeof(SimJob));
+        }
+        SimJob *j = &profile->jobs[profile->count++];
+        j->command = strdup(line + offset);
+        j->arrival_ns = (uint64_t)(arrival_ms * NS_PER_MS);
+        j->burst_ns = (uint64_t)(burst_ms * NS_PER_MS);
+        j->remaining_ns = j->burst_ns;
+        j->exit_status = exit_status;
+    }
+
+    // Submissions are released in arrival order
+    for (int i = 1; i < profile->count; i++) {
+        if (profile->jobs[i].arrival_ns < profile->jobs[i - 1].arrival_ns) {
+            fprintf(stderr, "Profile arrivals must be in non-decreasing order (line %d)\n", i + 1);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to rebuild the job profile of one recorded run (0 = first) from a trace file,
+// whose magic has already been consumed by is_trace_file(). Each job keeps its recorded
+// arrival and exit code; its burst is the sum of its recorded slices, or the CPU time
+// the kernel reported for it when use_cpu_time is set. run_params receives the
+// TRACE_RUN values (policy, param0..param3) so the replay can default to them.
+bool load_trace_profile(FILE *fp, int run, bool use_cpu_time, SimProfile *profile, uint64_t run_params[5]) {
+    TraceRecord *r = (TraceRecord *)malloc(sizeof(TraceRecord));
+    uint64_t last_ns = 0;
+    int current_run = -1;
+    int capacity = 0;
+    profile->jobs = NULL;
+    profile->count = 0;
+    profile->next_arrival = 0;
+
+    while (read_trace_record(fp, &last_ns, r)) {
+        if (r->type == TRACE_RUN) {
+            if (++current_run == run) {
+                memcpy(run_params, r->values, sizeof(r->values));
+            }
+            continue;
+        }
+        if (current_run != run) {
+            continue;
+        }
+        if (r->type == TRACE_END) {
+            break;
+        }
+
+        if (r->type == TRACE_ARRIVAL) {
+            if (r->job != profile->count) {
+                fprintf(stderr, "Trace arrivals out of order (job %d)\n", r->job);
+                free(r);
+                return false;
+            }
+            if (profile->count == capacity) {
+                capacity = capacity ? capacity * 2 : 1024;
+                profile->jobs = (SimJob *)realloc(profile->jobs, capacity * sizeof(SimJob));
+            }
+            SimJob *j = &profile->jobs[profile->count++];
+            j->command = strdup(r->command);
+            j->arrival_ns = r->time_ns;
+            j->burst_ns = 0;
+            j->remaining_ns = 0;
+            j->exit_status = 0;
+        } else if (r->job < 0 || r->job >= profile->count) {
+            continue;
+        } else if (r->type == TRACE_SLICE && !use_cpu_time) {
+            profile->jobs[r->job].burst_ns += r->end_ns - r->time_ns;
+        } else if (r->type == TRACE_EXIT) {
+            profile->jobs[r->job].exit_status = (int)r->values[0];
+            if (use_cpu_time) {
+                profile->jobs[r->job].burst_ns = r->values[1] + r->values[2];
+            }
+        }
+    }
+
+    free(r);
+    if (current_run < run) {
+        fprintf(stderr, "Trace has no run %d\n", run);
+        return false;
+    }
+    return true;
+}
+
+// Function to switch every scheduler over to the virtual clock and the given profile
+void begin_simulation(SimProfile *profile) {
+    sim_profile = *profile;
+    sim_profile.next_arrival = 0;
+    for (int i = 0; i < sim_profile.count; i++) {
+        sim_profile.jobs[i].remaining_ns = sim_profile.jobs[i].burst_ns;
+    }
+    sim_clock_ns = 0;
+    sched_simulated = true;
+}
+
+void end_simulation() {
+    sched_simulated = false;
+}
+
+// Function to release the next simulated submission if it has arrived by now
+SimJob *poll_simulated_arrival() {
+    if (sim_profile.next_arrival < sim_profile.count &&
+        sim_profile.jobs[sim_profile.next_arrival].arrival_ns <= sim_clock_ns - sched_epoch_ns) {
+        return &sim_profile.jobs[sim_profile.next_arrival++];
+    }
+    return NULL;
+}
+
+// Function to check whether no further submissions can arrive
+bool submissions_exhausted() {
+    if (sched_simulated) {
+        return sim_profile.next_arrival >= sim_profile.count;
+    }
+    return input_exhausted();
+}
+
+// Function to tell when the next submission arrives, UINT64_MAX when that is not known in
+// advance (real runs read stdin) or nothing is left to submit
+uint64_t next_submission_ns() {
+    if (sched_simulated && sim_profile.next_arrival < sim_profile.count) {
+        return sched_epoch_ns + sim_profile.jobs[sim_profile.next_arrival].arrival_ns;
+    }
+    return UINT64_MAX;
+}
+
+// Function called when nothing is runnable; the virtual clock skips ahead to the next arrival
+void wait_for_submission() {
+    if (sched_simulated && sim_profile.next_arrival < sim_profile.count) {
+        uint64_t next = sched_epoch_ns + sim_profile.jobs[sim_profile.next_arrival].arrival_ns;
+        if (next > sim_clock_ns) {
+            sim_clock_ns = next;
+        }
+    }
+}
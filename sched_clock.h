@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define NS_PER_MS 1000000ULL
+#define NS_PER_SEC 1000000000ULL
+
+// Timestamp (in nanoseconds) at which the running scheduler started
+uint64_t sched_epoch_ns;
+
+// Virtual clock, used instead of the real one while a simulation is running
+bool sched_simulated = false;
+uint64_t sim_clock_ns = 0;
+
+// Function to get current monotonic time in nanoseconds
+uint64_t sched_now_ns() {
+    if (sched_simulated) {
+        return sim_clock_ns;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+// Function to mark the start of a scheduler run
+void sched_clock_reset() {
+    sched_epoch_ns = sched_now_ns();
+}
+
+// Function to convert a nanosecond interval to milliseconds
+uint64_t ns_to_ms(uint64_t ns) {
+    return ns / NS_PER_MS;
+}
+
+// Function to convert a millisecond interval to nanoseconds, keeping "forever" as is
+uint64_t ms_to_ns(uint64_t ms) {
+    if (ms >= UINT64_MAX / NS_PER_MS) {
+        return UINT64_MAX;
+    }
+    return ms * NS_PER_MS;
+}
+
+// Function to convert a raw timestamp to milliseconds since the scheduler started
+uint64_t sched_elapsed_ms(uint64_t timestamp_ns) {
+    return ns_to_ms(timestamp_ns - sched_epoch_ns);
+}
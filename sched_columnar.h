@@ -0,0 +1,275 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "sched_clock.h"
+#include "sched_sink.h"
+
+// Columnar result file, written next to the CSV (result_*.cols) when SCHED_RESULT_FORMAT
+// is columnar or both. Meant for runs with millions of jobs: every column is one
+// fixed-width little-endian array that can be mmap'd and scanned directly, commands are
+// stored once in a string dictionary and referenced by id.
+//
+// Layout: a 64 byte ColumnarHeader, column_count 64 byte ColumnarColumn entries, then the
+// column buffers, each starting at a multiple of 64 bytes. Times are nanoseconds since
+// the start of the run. The buffers follow Arrow's layout (64 byte aligned, no nulls, the
+// dictionary as int32 offsets + utf8 data with command_id as its indices), so they can be
+// wrapped into Arrow arrays without copying; the Arrow IPC framing itself is not written.
+
+#define COLUMNAR_MAGIC "SCHEDCOL"
+#define COLUMNAR_VERSION 1
+#define COLUMNAR_ALIGNMENT 64
+#define COLUMNAR_NO_LEVEL 255
+
+typedef enum {
+    COLUMN_U8 = 1,
+    COLUMN_U32,
+    COLUMN_U64,
+    COLUMN_I32_OFFSETS,     // dictionary_count + 1 offsets into the data column
+    COLUMN_UTF8_DATA
+} ColumnType;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t column_count;
+    uint64_t row_count;
+    uint64_t dictionary_count;
+    char policy[32];
+} ColumnarHeader;
+
+typedef struct {
+    char name[40];
+    uint32_t type;
+    uint32_t width;         // Bytes per value
+    uint64_t offset;        // From the start of the file
+    uint64_t length;        // Bytes, without padding
+} ColumnarColumn;
+
+// Columns of one run, filled as jobs finish
+typedef enum {
+    COL_JOB,                // Index of the job in submission order (u32)
+    COL_COMMAND_ID,         // Dictionary id (u32)
+    COL_FINISHED,           // u8
+    COL_ERROR,              // u8
+    COL_LEVEL,              // MLFQ level the job finished in, COLUMNAR_NO_LEVEL otherwise (u8)
+    COL_ARRIVAL,            // u64 ns from here on
+    COL_FIRST_RUN,
+    COL_COMPLETION,
+    COL_CPU,
+    COL_TURNAROUND,
+    COL_WAITING,
+    COL_RESPONSE,
+    COLUMNAR_DATA_COLUMNS
+} ColumnarColumnId;
+
+static const char *columnar_column_names[] = {
+    "job", "command_id", "finished", "error", "level", "arrival_ns", "first_run_ns",
+    "completion_ns", "cpu_ns", "turnaround_ns", "waiting_ns", "response_ns",
+    "command_offsets", "command_data"
+};
+
+#define COLUMNAR_COLUMNS (COLUMNAR_DATA_COLUMNS + 2)
+
+int columnar_column_width(int column) {
+    return column <= COL_COMMAND_ID ? 4 : column <= COL_LEVEL ? 1 : 8;
+}
+
+typedef struct {
+    bool enabled;
+    const char *policy;
+    uint64_t count;
+    uint64_t capacity;
+    void *columns[COLUMNAR_DATA_COLUMNS];
+
+    // Command dictionary: open addressing on the FNV-1a hash of the command
+    int32_t *offsets;
+    char *data;
+    uint64_t data_length;
+    uint64_t data_capacity;
+    uint32_t entries;
+    uint32_t *slots;        // id + 1, 0 = empty
+    uint64_t *slot_hashes;
+    uint32_t slot_count;
+} ColumnarResults;
+
+ColumnarResults columnar_results = {0};
+
+void columnar_free() {
+    for (int c = 0; c < COLUMNAR_DATA_COLUMNS; c++) {
+        free(columnar_results.columns[c]);
+    }
+    free(columnar_results.offsets);
+    free(columnar_results.data);
+    free(columnar_results.slots);
+    free(columnar_results.slot_hashes);
+    memset(&columnar_results, 0, sizeof(columnar_results));
+}
+
+// Function to start collecting the columns of a run, if the columnar format is enabled
+void columnar_begin(const char *policy) {
+    columnar_free();
+    columnar_results.enabled = (result_formats() & RESULT_FORMAT_COLUMNAR) != 0;
+    columnar_results.policy = policy;
+}
+
+uint32_t columnar_command_id(const char *command) {
+    ColumnarResults *c = &columnar_results;
+    uint64_t h = 1469598103934665603ULL;  // FNV-1a
+    for (const unsigned char *s = (const unsigned char *)command; *s; s++) {
+        h = (h ^ *s) * 1099511628211ULL;
+    }
+
+    if (2 * (c->entries + 1) > c->slot_count) {
+        // Rehash at half load
+        uint32_t old_count = c->slot_count;
+        uint32_t *old_slots = c->slots;
+        uint64_t *old_hashes = c->slot_hashes;
+        c->slot_count = old_count ? old_count * 2 : 1024;
+        c->slots = (uint32_t *)calloc(c->slot_count, sizeof(uint32_t));
+        c->slot_hashes = (uint64_t *)calloc(c->slot_count, sizeof(uint64_t));
+        for (uint32_t i = 0; i < old_count; i++) {
+            if (old_slots[i] != 0) {
+                uint32_t j = old_hashes[i] & (c->slot_count - 1);
+                while (c->slots[j] != 0) {
+                    j = (j + 1) & (c->slot_count - 1);
+                }
+                c->slots[j] = old_slots[i];
+                c->slot_hashes[j] = old_hashes[i];
+            }
+        }
+        free(old_slots);
+        free(old_hashes);
+    }
+
+    size_t length = strlen(command);
+    uint32_t j = h & (c->slot_count - 1);
+    for (; c->slots[j] != 0; j = (j + 1) & (c->slot_count - 1)) {
+        uint32_t id = c->slots[j] - 1;
+        if (c->slot_hashes[j] == h && (size_t)(c->offsets[id + 1] - c->offsets[id]) == length &&
+            memcmp(c->data + c->offsets[id], command, length) == 0) {
+            return id;
+        }
+    }
+
+    // New dictionary entry
+    if (c->data_length + length > c->data_capacity) {
+        c->data_capacity = (c->data_length + length) * 2 + 4096;
+        c->data = (char *)realloc(c->data, c->data_capacity);
+    }
+    c->offsets = (int32_t *)realloc(c->offsets, (c->entries + 2) * sizeof(int32_t));
+    c->offsets[0] = 0;
+    memcpy(c->data + c->data_length, command, length);
+    c->data_length += length;
+    c->offsets[c->entries + 1] = (int32_t)c->data_length;
+    c->slots[j] = c->entries + 1;
+    c->slot_hashes[j] = h;
+    return c->entries++;
+}
+
+// Function to add the row of a finished job; timestamps are absolute (ns), level -1 for none
+void columnar_add(uint32_t job, const char *command, bool finished, bool error, int level,
+                  uint64_t arrival_ns, uint64_t first_run_ns, uint64_t completion_ns, uint64_t cpu_ns) {
+    ColumnarResults *c = &columnar_results;
+    if (!c->enabled) {
+        return;
+    }
+    if (c->count == c->capacity) {
+        c->capacity = c->capacity ? c->capacity * 2 : 4096;
+        for (int column = 0; column < COLUMNAR_DATA_COLUMNS; column++) {
+            c->columns[column] = realloc(c->columns[column], c->capacity * columnar_column_width(column));
+        }
+    }
+
+    uint64_t i = c->count++;
+    uint64_t turnaround = completion_ns - arrival_ns;
+    ((uint32_t *)c->columns[COL_JOB])[i] = job;
+    ((uint32_t *)c->columns[COL_COMMAND_ID])[i] = columnar_command_id(command);
+    ((uint8_t *)c->columns[COL_FINISHED])[i] = finished;
+    ((uint8_t *)c->columns[COL_ERROR])[i] = error;
+    ((uint8_t *)c->columns[COL_LEVEL])[i] = level >= 0 && level < COLUMNAR_NO_LEVEL ? level : COLUMNAR_NO_LEVEL;
+    ((uint64_t *)c->columns[COL_ARRIVAL])[i] = arrival_ns - sched_epoch_ns;
+    ((uint64_t *)c->columns[COL_FIRST_RUN])[i] = first_run_ns - sched_epoch_ns;
+    ((uint64_t *)c->columns[COL_COMPLETION])[i] = completion_ns - sched_epoch_ns;
+    ((uint64_t *)c->columns[COL_CPU])[i] = cpu_ns;
+    ((uint64_t *)c->columns[COL_TURNAROUND])[i] = turnaround;
+    ((uint64_t *)c->columns[COL_WAITING])[i] = turnaround > cpu_ns ? turnaround - cpu_ns : 0;
+    ((uint64_t *)c->columns[COL_RESPONSE])[i] = first_run_ns - arrival_ns;
+}
+
+uint64_t columnar_align(uint64_t offset) {
+    return (offset + COLUMNAR_ALIGNMENT - 1) & ~(uint64_t)(COLUMNAR_ALIGNMENT - 1);
+}
+
+// Function to write the collected columns, then release them
+void columnar_write(const char *filename) {
+    ColumnarResults *c = &columnar_results;
+    if (!c->enabled) {
+        return;
+    }
+    if (c->offsets == NULL) {
+        c->offsets = (int32_t *)calloc(1, sizeof(int32_t));
+    }
+    FILE *fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        perror("Error opening columnar result file");
+        columnar_free();
+        return;
+    }
+
+    ColumnarHeader header = {0};
+    memcpy(header.magic, COLUMNAR_MAGIC, 8);
+    header.version = COLUMNAR_VERSION;
+    header.column_count = COLUMNAR_COLUMNS;
+    header.row_count = c->count;
+    header.dictionary_count = c->entries;
+    snprintf(header.policy, sizeof(header.policy), "%s", c->policy);
+
+    ColumnarColumn columns[COLUMNAR_COLUMNS] = {0};
+    const void *buffers[COLUMNAR_COLUMNS];
+    uint64_t offset = columnar_align(sizeof(header) + sizeof(columns));
+    for (int column = 0; column < COLUMNAR_COLUMNS; column++) {
+        ColumnarColumn *col = &columns[column];
+        snprintf(col->name, sizeof(col->name), "%s", columnar_column_names[column]);
+        if (column < COLUMNAR_DATA_COLUMNS) {
+            col->width = columnar_column_width(column);
+            col->type = col->width == 1 ? COLUMN_U8 : col->width == 4 ? COLUMN_U32 : COLUMN_U64;
+            col->length = c->count * col->width;
+            buffers[column] = c->columns[column];
+        } else if (column == COLUMNAR_DATA_COLUMNS) {
+            col->type = COLUMN_I32_OFFSETS;
+            col->width = 4;
+            col->length = (c->entries + 1) * sizeof(int32_t);
+            buffers[column] = c->offsets;
+        } else {
+            col->type = COLUMN_UTF8_DATA;
+            col->width = 1;
+            col->length = c->data_length;
+            buffers[column] = c->data;
+        }
+        col->offset = offset;
+        offset = columnar_align(offset + col->length);
+    }
+
+    static const uint8_t padding[COLUMNAR_ALIGNMENT] = {0};
+    uint64_t position = sizeof(header) + sizeof(columns);
+    fwrite(&header, sizeof(header), 1, fp);
+    fwrite(columns, sizeof(columns), 1, fp);
+    for (int column = 0; column < COLUMNAR_COLUMNS; column++) {
+        fwrite(padding, 1, columns[column].offset - position, fp);
+        if (columns[column].length > 0) {
+            fwrite(buffers[column], 1, columns[column].length, fp);
+        }
+        position = columns[column].offset + columns[column].length;
+    }
+    fwrite(padding, 1, columnar_align(position) - position, fp);
+
+    if (fclose(fp) != 0) {
+        perror("Error writing columnar result file");
+    }
+    columnar_free();
+}
@@ -0,0 +1,852 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <poll.h>
+
+#include "sched_clock.h"
+#include "sched_backend.h"
+#include "sched_trace.h"
+#include "sched_stats.h"
+#include "sched_sink.h"
+#include "sched_columnar.h"
+#include "sched_live.h"
+#include "sched_admission.h"
+#include "sched_history.h"
+
+// Execution engine shared by every scheduler. The engine owns the job list, spawns and
+// resumes jobs one slice at a time (run_slice), accounts for each slice and emits it
+// (context-switch line, trace, stats, live page, result row); a policy only decides which
+// job runs next and for how long, through the PolicyOps callbacks:
+//
+//   admit    a job was submitted (offline: every job at the start of the run)
+//   pick     the next job to run, its queue level (-1 for single-queue policies) and
+//            quantum (UINT64_MAX = until it exits); -1 when nothing is runnable
+//   requeue  the job used up its quantum without exiting
+//   finish   the job exited, after its result row was written (may be NULL)
+//   resume   a job picked but held back (a pipeline stage that would only block on its
+//            pipe) can run again: put it back at its level without counting a slice
+//            against it (NULL: requeue)
+//
+// Ops tables use designated initializers: the optional hooks a policy leaves out are NULL.
+//
+// run_engine() is always inlined and every policy passes a static const PolicyOps, so the
+// compiler resolves the callbacks at compile time and inlines them: each scheduler gets
+// its own specialised loop with no indirect calls.
+//
+// SCHED_BATCH=<n> lets the engine run up to n (at most BATCH_MAX_JOBS) tiny jobs in one
+// shell (run_batch): when the policy picks a job whose command took at most
+// SCHED_BATCH_MAX_MS (default 2, spawning included) on average so far, the engine keeps
+// picking while the picks are tiny too, and the first pick that is not becomes the next
+// one run. Each job still gets its own slice, exit status and result row, and is held to
+// its quantum: one that overruns it is stopped with the shell and goes on as an ordinary
+// job. Only for policies that keep no state between a pick and its requeue
+// (distributable), and only while job output is not captured, since the jobs of a batch
+// share the shell's stdout and stderr.
+
+#define BATCH_MAX_JOBS 64
+#define BATCH_DEFAULT_MAX_MS 2
+#define PIPELINE_SLICE_NS (10 * NS_PER_MS)    // Longest slice of a pipeline stage, see run_engine()
+
+// Structure to represent a process
+typedef struct {
+    char *command;
+    bool finished;
+    bool error;
+    uint64_t start_time;
+    uint64_t completion_time;
+    uint64_t turnaround_time;
+    uint64_t waiting_time;
+    uint64_t response_time;
+    uint64_t last_executed_time;
+    uint64_t burst_time;
+    bool started;
+    int process_id;                // -1 until the job is spawned, below -1 the process group of the batch shell it overran in
+    uint64_t arrival_time;
+    int priority;                  // Queue level of the last slice, -1 for single-queue policies
+    uint64_t remaining_time;       // Estimated from the command's history (online)
+    int nice;                      // -20 (favoured) to 19, weights the job's CPU share under CFS
+    int tickets;                   // Share under stride and lottery scheduling, 0 for the default
+    uint64_t deadline_ns;          // Completion deadline relative to arrival, 0 for none
+    bool rejected;                 // Refused by the policy without running (deadline not feasible)
+    int pipe_from;                 // Job whose stdout is this job's stdin (PIPE_FROM=<job>), -1 for none
+    int pipe_to;                   // Job this job's stdout feeds, -1 for none
+    bool held;                     // A pipeline stage held back until the other side of its pipe runs
+    // Raw timestamps (ns), metrics above are derived from these at output time
+    uint64_t arrival_ns;
+    uint64_t first_run_ns;
+    uint64_t completion_ns;
+    uint64_t cpu_ns;
+} Process;
+
+typedef struct {
+    Process *processes;     // Grown on demand by the online schedulers
+    int count;
+    int capacity;
+} ProcessList;
+
+// Queue node structure for process queue
+typedef struct QueueNode {
+    int process_index;
+    struct QueueNode *next;
+} QueueNode;
+
+// Queue structure
+typedef struct Queue {
+    QueueNode *front;
+    QueueNode *rear;
+    int length;
+} Queue;
+
+// Function to create a new queue
+Queue* create_queue() {
+    Queue *q = (Queue *)malloc(sizeof(Queue));
+    q->front = NULL;
+    q->rear = NULL;
+    q->length = 0;
+    return q;
+}
+
+// Function to add a process to the queue
+void enqueue(Queue *q, int process_index) {
+    QueueNode *new_node = (QueueNode *)malloc(sizeof(QueueNode));
+    new_node->process_index = process_index;
+    new_node->next = NULL;
+    if (q->rear == NULL) {
+        q->front = new_node;
+        q->rear = new_node;
+    } else {
+        q->rear->next = new_node;
+        q->rear = new_node;
+    }
+    q->length++;
+}
+
+// Function to remove and return a process from the queue
+int dequeue(Queue *q) {
+    if (q->front == NULL) {
+        return -1;
+    }
+    QueueNode *temp = q->front;
+    int process_index = temp->process_index;
+    q->front = q->front->next;
+    if (q->front == NULL) {
+        q->rear = NULL;
+    }
+    free(temp);
+    q->length--;
+    return process_index;
+}
+
+// Function to move every node of src to the back of dst, leaving src empty
+void append_queue(Queue *dst, Queue *src) {
+    if (src->front == NULL) {
+        return;
+    }
+    if (dst->rear == NULL) {
+        dst->front = src->front;
+    } else {
+        dst->rear->next = src->front;
+    }
+    dst->rear = src->rear;
+    dst->length += src->length;
+    src->front = NULL;
+    src->rear = NULL;
+    src->length = 0;
+}
+
+// Function to publish the queue lengths to the live stats page
+void publish_queue_depths(Queue *queues[], int levels) {
+    for (int level = 0; level < levels; level++) {
+        live_set_queue_depth(level, queues[level]->length);
+    }
+}
+
+// Function to free the memory used by the queue
+void free_queue(Queue *q) {
+    QueueNode *current = q->front;
+    QueueNode *next;
+    while (current != NULL) {
+        next = current->next;
+        free(current);
+        current = next;
+    }
+    free(q);
+}
+
+// Function to initialise the bookkeeping of a process before scheduling
+void reset_process(Process *p, uint64_t arrival_ns) {
+    p->finished = false;
+    p->error = false;
+    p->started = false;
+    p->process_id = -1;
+    p->arrival_time = 0;
+    p->start_time = 0;
+    p->completion_time = 0;
+    p->turnaround_time = 0;
+    p->waiting_time = 0;
+    p->response_time = 0;
+    p->last_executed_time = 0;
+    p->burst_time = 0;
+    p->priority = -1;
+    p->remaining_time = 0;
+    p->rejected = false;
+    p->pipe_from = -1;
+    p->pipe_to = -1;
+    p->held = false;
+    p->arrival_ns = arrival_ns;
+    p->first_run_ns = arrival_ns;
+    p->completion_ns = arrival_ns;
+    p->cpu_ns = 0;
+}
+
+// Function to derive the reported metrics (ms) from the recorded timestamps
+void derive_process_metrics(Process *p) {
+    uint64_t turnaround_ns = p->completion_ns - p->arrival_ns;
+    p->arrival_time = sched_elapsed_ms(p->arrival_ns);
+    p->start_time = sched_elapsed_ms(p->first_run_ns);
+    p->completion_time = sched_elapsed_ms(p->completion_ns);
+    p->burst_time = ns_to_ms(p->cpu_ns);
+    p->turnaround_time = ns_to_ms(turnaround_ns);
+    p->waiting_time = ns_to_ms(turnaround_ns > p->cpu_ns ? turnaround_ns - p->cpu_ns : 0);
+    p->response_time = ns_to_ms(p->first_run_ns - p->arrival_ns);
+}
+
+// Function to step through the scheduling options a command carries as leading shell
+// variable assignments, e.g. "TICKETS=300 NICE=-5 DEADLINE=2000 ./job". The shell runs the
+// command unchanged (the job just sees them in its environment), so traces and replays
+// keep them too. False once *s is at the command itself.
+bool next_job_option(const char **s, const char **name, size_t *length, const char **value) {
+    const char *c = *s;
+    while (*c == ' ' || *c == '\t') c++;
+    const char *start = c;
+    while ((*c >= 'A' && *c <= 'Z') || (*c >= 'a' && *c <= 'z') || (*c >= '0' && *c <= '9') || *c == '_') c++;
+    if (c == start || *c != '=' || (*start >= '0' && *start <= '9')) {
+        *s = start;     // Not an assignment, the command itself starts here
+        return false;
+    }
+    *name = start;
+    *length = c - start;
+    *value = ++c;
+    while (*c != '\0' && *c != ' ' && *c != '\t') c++;
+    *s = c;
+    return true;
+}
+
+// Function to read the options the policies use (deadline in ms). Returns where the
+// command itself starts, the key of the command's history.
+const char *read_job_options(Process *p) {
+    const char *s = p->command;
+    const char *name, *value;
+    size_t length;
+    while (next_job_option(&s, &name, &length, &value)) {
+        char *end;
+        long number = strtol(value, &end, 10);
+        if (length == 7 && strncmp(name, "TICKETS", 7) == 0 && end != value && number > 0 && number <= INT32_MAX) {
+            p->tickets = (int)number;
+        } else if (length == 4 && strncmp(name, "NICE", 4) == 0 && end != value) {
+            p->nice = number < -20 ? -20 : number > 19 ? 19 : (int)number;
+        } else if (length == 8 && strncmp(name, "DEADLINE", 8) == 0 && end != value && number > 0) {
+            p->deadline_ns = ms_to_ns((uint64_t)number);
+        }
+    }
+    return s;
+}
+
+// Function to tell how much later than its deadline a job finished, 0 if in time or without one
+uint64_t deadline_lateness_ns(const Process *p) {
+    uint64_t turnaround_ns = p->completion_ns - p->arrival_ns;
+    if (p->deadline_ns == 0 || p->rejected || turnaround_ns <= p->deadline_ns) {
+        return 0;
+    }
+    return turnaround_ns - p->deadline_ns;
+}
+
+// Function to name the deadline outcome of a finished job, for the result CSV
+const char *deadline_status(const Process *p) {
+    if (p->deadline_ns == 0) {
+        return "None";
+    }
+    if (p->rejected) {
+        return "Rejected";
+    }
+    return p->completion_ns - p->arrival_ns > p->deadline_ns ? "Missed" : "Met";
+}
+
+// Function to print context switch information from raw slice timestamps.
+// Only in the text output mode, otherwise the slice is already in the binary trace.
+void print_context_switch(const char *command, uint64_t start_ns, uint64_t end_ns) {
+    if (switch_output_mode != SWITCH_OUTPUT_TEXT) {
+        return;
+    }
+    printf("%s|%lu|%lu\n", command, sched_elapsed_ms(start_ns), sched_elapsed_ms(end_ns));
+}
+
+// What a scheduler run looks like from the outside
+typedef struct {
+    SchedPolicy policy;         // Recorded in the trace and on the live page
+    const char *name;           // Stats and columnar policy name
+    int levels;                 // Queue levels, 1 for single-queue policies
+    uint64_t params[4];         // Policy parameters recorded in the trace
+    bool online;                // Jobs are submitted (on stdin or by the simulation) while the run goes on
+    bool input_order_csv;       // Rewrite the CSV in input order once the run is over (offline)
+    const char *csv_file;
+    const char *csv_header;
+    const char *columnar_file;
+    bool deadline_columns;      // Add the Deadline (Met, Missed, Rejected or None) and Lateness columns
+    bool distributable;         // Slices may run on worker agents (SCHED_AGENTS, see sched_remote.h):
+                                // the policy keeps no state between a pick and its requeue
+    bool submission_preempts;   // A submission ends the running slice, so the policy picks again at
+                                // once (simulated slices end at the next arrival, see next_submission_ns)
+} EngineConfig;
+
+typedef struct {
+    const EngineConfig *config;
+    ProcessList *jobs;
+    int max_jobs;               // Submissions beyond this are rejected
+    int completed;
+    int stdin_flags;            // Restored at the end of an online run
+    Queue *deferred;            // Submissions waiting for admission (online)
+    int held;                   // Pipeline stages held back
+    bool run_held;              // Nothing else was runnable: run the held stages anyway
+    int batch_jobs;             // Most tiny jobs run in one shell, 0 when not batching
+    uint64_t batch_max_ms;      // Longest average burst of a tiny job
+    int carried_job;            // Picked while filling a batch but not tiny: the next pick, -1 for none
+    int carried_level;
+    uint64_t carried_quantum_ns;
+} Engine;
+
+typedef struct {
+    void (*admit)(void *policy, Engine *e, int job);
+    int (*pick)(void *policy, Engine *e, uint64_t now_ns, int *level, uint64_t *quantum_ns);
+    void (*requeue)(void *policy, Engine *e, int job, int level);
+    void (*finish)(void *policy, Engine *e, int job);
+    void (*resume)(void *policy, Engine *e, int job, int level);
+} PolicyOps;
+
+// Function to start a run: clock, trace, stats, live page and result files.
+// False if the result CSV cannot be opened.
+bool engine_begin_run(Engine *e) {
+    const EngineConfig *c = e->config;
+    if (!sched_simulated) {
+        low_jitter_enabled();   // Before the run starts any helper thread
+    }
+    sched_clock_reset();
+    trace_begin_run(c->policy, c->params[0], c->params[1], c->params[2], c->params[3]);
+    stats_begin_run(c->name, c->levels > 1);
+    columnar_begin(c->name);
+    live_begin_run(c->policy, c->levels);
+    job_output_begin_run(c->online ? JOB_OUTPUT_INHERIT : JOB_OUTPUT_DISCARD);
+    e->completed = 0;
+    e->held = 0;
+    e->run_held = false;
+    e->carried_job = -1;
+    e->batch_jobs = 0;
+    const char *batch = getenv("SCHED_BATCH");
+    if (batch != NULL && batch[0] != '\0' && !sched_simulated && c->distributable) {
+        if (job_output_captured()) {
+            fprintf(stderr, "SCHED_BATCH is ignored while job output is captured\n");
+        } else {
+            int jobs = atoi(batch);
+            const char *max_ms = getenv("SCHED_BATCH_MAX_MS");
+            e->batch_jobs = jobs < BATCH_MAX_JOBS ? jobs : BATCH_MAX_JOBS;
+            e->batch_max_ms = max_ms != NULL && max_ms[0] != '\0' ? strtoull(max_ms, NULL, 10) : BATCH_DEFAULT_MAX_MS;
+        }
+    }
+    if (!open_result_sink(c->csv_file, c->csv_header)) {
+        return false;
+    }
+
+    admission_begin_run();
+    if (c->online) {
+        e->deferred = create_queue();
+    }
+
+    // Submissions are polled before every pick and read while slices run, so stdin stays
+    // non-blocking for the whole run (the io_uring backend reads it through the ring instead)
+    input_begin_run(c->online && !sched_simulated, c->submission_preempts);
+    if (c->online && !sched_simulated && !uring_enabled()) {
+        e->stdin_flags = fcntl(STDIN_FILENO, F_GETFL, 0);
+        fcntl(STDIN_FILENO, F_SETFL, e->stdin_flags | O_NONBLOCK);
+    }
+    return true;
+}
+
+// Function to connect a job submitted with PIPE_FROM=<job> to its producer: an earlier job
+// of the run, not spawned yet and feeding no other. Pipelines need local pipes: simulations
+// and runs on worker agents (sched_remote.h) run the stages unconnected.
+void engine_link_stage(Engine *e, int job) {
+    Process *p = &e->jobs->processes[job];
+    const char *s = p->command;
+    const char *name, *value;
+    size_t length;
+    while (next_job_option(&s, &name, &length, &value)) {
+        char *end;
+        long number = strtol(value, &end, 10);
+        if (length == 9 && strncmp(name, "PIPE_FROM", 9) == 0 && end != value && number >= 0 && number < job) {
+            p->pipe_from = (int)number;
+        } else if (length == 9 && strncmp(name, "PIPE_FROM", 9) == 0) {
+            fprintf(stderr, "Ignoring PIPE_FROM=%.*s of job %d: not an earlier job\n", (int)strcspn(value, " \t"), value, job);
+        }
+    }
+    if (p->pipe_from == -1 || sched_simulated) {
+        p->pipe_from = -1;
+        return;
+    }
+    Process *producer = &e->jobs->processes[p->pipe_from];
+    if (producer->pipe_to != -1 || producer->process_id != -1 || producer->rejected) {
+        fprintf(stderr, "Ignoring PIPE_FROM=%d of job %d: that job already started or feeds another\n",
+                p->pipe_from, job);
+        p->pipe_from = -1;
+        return;
+    }
+    producer->pipe_to = job;
+    job_output_link(p->pipe_from, job);
+}
+
+// Function to add a submitted job to the engine's list, -1 if the list is full
+int engine_add_job(Engine *e, const char *command, uint64_t arrival_ns) {
+    ProcessList *list = e->jobs;
+    if (list->count >= e->max_jobs) {
+        printf("Rejected: %s (maximum number of processes reached)\n", command);
+        admission.total_rejected++;
+        admission_publish();
+        return -1;
+    }
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 100;
+        list->processes = (Process *)realloc(list->processes, list->capacity * sizeof(Process));
+    }
+
+    int job = list->count++;
+    Process *p = &list->processes[job];
+    p->command = strdup(command);
+    p->nice = 0;
+    p->tickets = 0;
+    p->deadline_ns = 0;
+    reset_process(p, arrival_ns);
+    read_job_options(p);
+    engine_link_stage(e, job);
+    trace_arrival(job, arrival_ns, p->command);
+    live_record_submissions(1);
+    return job;
+}
+
+// Function to submit every job of an offline run, all present at the start of the run
+void engine_submit_all(Engine *e) {
+    for (int i = 0; i < e->jobs->count; i++) {
+        reset_process(&e->jobs->processes[i], sched_epoch_ns);
+        read_job_options(&e->jobs->processes[i]);
+        engine_link_stage(e, i);
+        trace_arrival(i, sched_epoch_ns, e->jobs->processes[i].command);
+    }
+    live_record_submissions(e->jobs->count);
+}
+
+// Function to fetch the next submitted command without blocking, false when none is pending.
+// Real runs read stdin (non-blocking during an online run, or through the io_uring),
+// simulations release profile jobs.
+bool next_submission(char *command, uint64_t *arrival_ns) {
+    if (sched_simulated) {
+        SimJob *job = poll_simulated_arrival();
+        if (job == NULL) {
+            return false;
+        }
+        strncpy(command, job->command, MAX_COMMAND_LENGTH - 1);
+        command[MAX_COMMAND_LENGTH - 1] = '\0';
+        *arrival_ns = sched_epoch_ns + job->arrival_ns;
+        return true;
+    }
+
+    // Arrivals are the times the lines were read, during the slices too (see sched_input.h)
+    bool ring = uring_enabled();
+    bool read = ring;   // The ring reads on its own
+    while (true) {
+        bool taken = ring ? uring_read_line(command, MAX_COMMAND_LENGTH, arrival_ns)
+                          : input_take_line(command, MAX_COMMAND_LENGTH, arrival_ns);
+        if (!taken) {
+            if (read) {
+                return false;
+            }
+            input_read_available();
+            read = true;
+        } else if (command[0] != '\0') {
+            return true;
+        }
+    }
+}
+
+// Function to wait for a submission when nothing is runnable. Real runs sleep in poll()
+// (or on the io_uring) until stdin has input (at most 10 ms), instead of spinning on the
+// non-blocking reads.
+void engine_idle() {
+    if (sched_simulated) {
+        wait_for_submission();
+        return;
+    }
+    if (uring_enabled()) {
+        uring_wait_input(10 * NS_PER_MS);
+        return;
+    }
+    struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+    poll(&pfd, 1, 10);
+}
+
+// Function to account for one executed slice and emit it
+void engine_record_slice(Engine *e, int job, int level, uint64_t quantum_ns, SliceResult r) {
+    Process *p = &e->jobs->processes[job];
+    uint64_t slice_ns = r.end_ns - r.start_ns;
+    if (!p->started) {
+        p->first_run_ns = r.start_ns;
+        p->started = true;
+    }
+    p->cpu_ns += slice_ns;
+    p->priority = level;
+    p->remaining_time = p->remaining_time > ns_to_ms(slice_ns) ? p->remaining_time - ns_to_ms(slice_ns) : 0;
+    print_context_switch(p->command, r.start_ns, r.end_ns);
+    live_slice_end(r.exited, r.error);
+    stats_record_slice(level, p->command, slice_ns, quantum_ns, r.exited);
+}
+
+// Function to record a finished job and stream its row to the result sink, so a crash
+// keeps the results of every job finished so far
+void engine_complete(Engine *e, int job, SliceResult r) {
+    Process *p = &e->jobs->processes[job];
+    p->finished = !r.error;
+    p->error = r.error;
+    p->completion_ns = r.end_ns;
+    e->completed++;
+    if (p->pipe_from != -1 || p->pipe_to != -1) {
+        job_output_job_done(job);
+    }
+    admission_record_exit(p->cpu_ns, !p->rejected);
+    if (!p->rejected) {
+        stats_record_completion(p->priority, p->command, p->arrival_ns, p->first_run_ns, p->completion_ns, p->cpu_ns);
+    }
+    columnar_add(job, p->command, p->finished, p->error, p->priority,
+                 p->arrival_ns, p->first_run_ns, p->completion_ns, p->cpu_ns);
+    derive_process_metrics(p);
+    if (!p->error) {
+        update_historical_data(&historical_data, read_job_options(p), p->burst_time);
+    }
+    if (e->config->deadline_columns) {
+        sink_printf(&result_sink, "\"%s\",%s,%s,%lu,%lu,%lu,%lu,%s,%lu\n",
+                    p->command,
+                    p->finished && !p->error ? "Yes" : "No",
+                    p->error ? "Yes" : "No",
+                    p->burst_time,
+                    p->turnaround_time,
+                    p->waiting_time,
+                    p->response_time,
+                    deadline_status(p),
+                    ns_to_ms(deadline_lateness_ns(p)));
+        return;
+    }
+    sink_printf(&result_sink, "\"%s\",%s,%s,%lu,%lu,%lu,%lu\n",
+                p->command,
+                p->finished && !p->error ? "Yes" : "No",
+                p->error ? "Yes" : "No",
+                p->burst_time,
+                p->turnaround_time,
+                p->waiting_time,
+                p->response_time);
+}
+
+// Function to record a job the policy refuses to run: it completes at once as an error
+void engine_reject(Engine *e, int job) {
+    Process *p = &e->jobs->processes[job];
+    uint64_t now_ns = sched_now_ns();
+    p->rejected = true;
+    p->first_run_ns = now_ns;
+    engine_complete(e, job, (SliceResult){now_ns, now_ns, true, true});
+}
+
+// Function to write results to a CSV file. The streamed rows are in completion order,
+// this replaces them with every process in input order once the run is over.
+void write_results_to_csv(Process p[], int n, const char *filename, const char *header) {
+    if (!(result_formats() & RESULT_FORMAT_CSV)) {
+        return;
+    }
+    char temporary[4096];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", filename);
+    FILE *fp = fopen(temporary, "w");
+    if (fp == NULL) {
+        return;
+    }
+
+    fputs(header, fp);
+
+    for (int i = 0; i < n; i++) {
+        derive_process_metrics(&p[i]);
+        fprintf(fp, "\"%s\",%s,%s,%lu,%lu,%lu,%lu\n",
+                p[i].command,
+                p[i].finished && !p[i].error ? "Yes" : "No",
+                p[i].error ? "Yes" : "No",
+                p[i].burst_time,
+                p[i].turnaround_time,
+                p[i].waiting_time,
+                p[i].response_time);
+    }
+
+    fclose(fp);
+    if (rename(temporary, filename) != 0) {
+        perror("Error replacing CSV file");
+    }
+}
+
+// Function to finish a run: flush the trace, print the stats and write the result files
+void engine_end_run(Engine *e) {
+    const EngineConfig *c = e->config;
+    if (c->online && !sched_simulated && !uring_enabled()) {
+        fcntl(STDIN_FILENO, F_SETFL, e->stdin_flags);
+    }
+    trace_end_run();
+    live_end_run();
+    stats_print_summary(stderr);
+    admission_print_summary(stderr);
+    job_output_end_run(stderr);
+    close_result_sink();
+    if (c->input_order_csv) {
+        write_results_to_csv(e->jobs->processes, e->jobs->count, c->csv_file, c->csv_header);
+    }
+    columnar_write(c->columnar_file);
+    if (e->deferred != NULL) {
+        free_queue(e->deferred);
+        e->deferred = NULL;
+    }
+}
+
+// Function to take in every pending submission (online), through admission control
+static inline __attribute__((always_inline))
+void engine_poll_submissions(Engine *e, const PolicyOps *ops, void *policy) {
+    char command[MAX_COMMAND_LENGTH];
+    uint64_t arrival_ns;
+    while (next_submission(command, &arrival_ns)) {
+        int job = engine_add_job(e, command, arrival_ns);
+        if (job == -1) {
+            continue;
+        }
+        AdmissionDecision decision = admission_decide();
+        if (decision == ADMIT_DEFER) {
+            admission_respond(decision, command);
+            enqueue(e->deferred, job);
+        } else if (decision == ADMIT_REJECT) {
+            admission_respond(decision, command);
+            admission_record_admit(false);  // Leaves again right away, as an error row
+            engine_reject(e, job);
+        } else {
+            admission_record_admit(false);
+            ops->admit(policy, e, job);
+        }
+    }
+    // Deferred submissions go in, oldest first, as soon as the budget has room
+    while (e->deferred->front != NULL && admission_has_room()) {
+        admission_record_admit(true);
+        ops->admit(policy, e, dequeue(e->deferred));
+    }
+}
+
+// Function to tell whether to hold back a pipeline stage the policy picked because it would
+// only block on its pipe (see job_output_stall). It waits off the policy's queues until the
+// other side of the pipe has run. Only for policies that keep no state between a pick and
+// its requeue (distributable); under the others stages run like any other job.
+bool engine_hold_stage(Engine *e, int job, int level) {
+    Process *p = &e->jobs->processes[job];
+    if (!e->config->distributable || e->run_held || job_output_stall(job) == STAGE_READY) {
+        return false;
+    }
+    p->held = true;
+    p->priority = level;
+    e->held++;
+    return true;
+}
+
+// Function to tell whether to run a job in a batch: its command ran before and took at most
+// batch_max_ms on average, and it is neither started nor a pipeline stage
+bool engine_tiny_job(Engine *e, int job) {
+    Process *p = &e->jobs->processes[job];
+    if (p->process_id != -1 || p->pipe_from != -1 || p->pipe_to != -1) {
+        return false;
+    }
+    const char *command = read_job_options(p);
+    return !is_new_command(&historical_data, command) && get_historical_burst_time(&historical_data, command) <= e->batch_max_ms;
+}
+
+// Function to give a job that was picked but did not run back to the policy, at the level
+// it was picked from
+static inline __attribute__((always_inline))
+void engine_give_back(Engine *e, const PolicyOps *ops, void *policy, int job, int level) {
+    if (ops->resume != NULL) {
+        ops->resume(policy, e, job, level);
+    } else {
+        ops->requeue(policy, e, job, level);
+    }
+}
+
+// Function to fill a batch from the tiny job just picked and the tiny picks after it, and
+// run it. False (having run nothing) when no other tiny job came up to join it. A job that
+// overruns its quantum leaves the batch and goes back to the policy like any preempted job,
+// still in the stopped batch shell; the jobs after it go back as they were picked.
+static inline __attribute__((always_inline))
+bool engine_run_batch(Engine *e, const PolicyOps *ops, void *policy, int job, int level, uint64_t quantum_ns) {
+    int jobs[BATCH_MAX_JOBS];
+    int levels[BATCH_MAX_JOBS];
+    uint64_t quanta[BATCH_MAX_JOBS];
+    char *commands[BATCH_MAX_JOBS];
+    int count = 0;
+    while (true) {
+        jobs[count] = job;
+        levels[count] = level;
+        quanta[count] = quantum_ns;
+        commands[count] = e->jobs->processes[job].command;
+        if (++count == e->batch_jobs) {
+            break;
+        }
+        level = -1;
+        quantum_ns = UINT64_MAX;
+        job = ops->pick(policy, e, sched_now_ns(), &level, &quantum_ns);
+        if (job == -1) {
+            break;
+        }
+        if (!engine_tiny_job(e, job)) {
+            e->carried_job = job;
+            e->carried_level = level;
+            e->carried_quantum_ns = quantum_ns;
+            break;
+        }
+    }
+    if (count == 1) {
+        return false;
+    }
+
+    SliceResult results[BATCH_MAX_JOBS];
+    pid_t stopped;
+    int ran = run_batch(jobs, commands, quanta, count, results, &stopped);
+    // The jobs that did not start go back first: they are ahead of the one that overran
+    for (int i = ran; i < count; i++) {
+        engine_give_back(e, ops, policy, jobs[i], levels[i]);
+    }
+    for (int i = 0; i < ran; i++) {
+        live_slice_begin(jobs[i], levels[i], commands[i]);
+        engine_record_slice(e, jobs[i], levels[i], quanta[i], results[i]);
+        if (!results[i].exited) {
+            e->jobs->processes[jobs[i]].process_id = stopped;
+            ops->requeue(policy, e, jobs[i], levels[i]);
+            continue;
+        }
+        engine_complete(e, jobs[i], results[i]);
+        if (ops->finish != NULL) {
+            ops->finish(policy, e, jobs[i]);
+        }
+    }
+    return true;
+}
+
+// Function to give a held stage back to the policy, at the level it was picked from
+static inline __attribute__((always_inline))
+void engine_resume_stage(Engine *e, const PolicyOps *ops, void *policy, int job) {
+    Process *p = &e->jobs->processes[job];
+    p->held = false;
+    e->held--;
+    engine_give_back(e, ops, policy, job, p->priority);
+}
+
+// Function to run a scheduler over e->jobs (offline) or over the submissions (online)
+// with the given policy. Meant to be called with a static const ops table, see above.
+//
+// Pipeline stages are scheduled one by one like any job, except that a stage is held back
+// instead of run while it could only block on its pipe, and where the policy would run it
+// to completion it gets slices of PIPELINE_SLICE_NS, so that both ends of a pipe move
+// along instead of a producer blocking for good on a pipe nobody reads yet.
+static inline __attribute__((always_inline))
+void run_engine(Engine *e, const PolicyOps *ops, void *policy) {
+    const bool online = e->config->online;  // Read before any call, so it folds into a constant
+    if (!engine_begin_run(e)) {
+        return;
+    }
+
+    if (!online) {
+        engine_submit_all(e);
+        for (int i = 0; i < e->jobs->count; i++) {
+            ops->admit(policy, e, i);
+        }
+    }
+
+    while (true) {
+        if (online) {
+            engine_poll_submissions(e, ops, policy);
+        }
+
+        int level = -1;
+        uint64_t quantum_ns = UINT64_MAX;
+        int job;
+        if (e->carried_job != -1) {
+            job = e->carried_job;
+            level = e->carried_level;
+            quantum_ns = e->carried_quantum_ns;
+            e->carried_job = -1;
+        } else {
+            job = ops->pick(policy, e, sched_now_ns(), &level, &quantum_ns);
+        }
+        if (job == -1 && e->held > 0) {
+            // Only held stages left: run them anyway
+            e->run_held = true;
+            for (int i = 0; i < e->jobs->count; i++) {
+                if (e->jobs->processes[i].held) {
+                    engine_resume_stage(e, ops, policy, i);
+                }
+            }
+            continue;
+        }
+        if (job == -1) {
+            // Nothing runnable: every admitted job is done
+            if (!online || submissions_exhausted()) {
+                break;
+            }
+            engine_idle();
+            continue;
+        }
+
+        Process *p = &e->jobs->processes[job];
+        bool stage = p->pipe_from != -1 || p->pipe_to != -1;
+        if (stage) {
+            if (engine_hold_stage(e, job, level)) {
+                continue;
+            }
+            if (quantum_ns == UINT64_MAX) {
+                quantum_ns = PIPELINE_SLICE_NS;
+            }
+        } else if (e->batch_jobs > 1 && engine_tiny_job(e, job)
+                   && engine_run_batch(e, ops, policy, job, level, quantum_ns)) {
+            continue;
+        }
+        live_slice_begin(job, level, p->command);
+        SliceResult r = run_slice(job, &p->process_id, p->command, quantum_ns);
+        engine_record_slice(e, job, level, quantum_ns, r);
+        e->run_held = false;
+        if (stage) {
+            // The other side of the pipe may have work now
+            int other[2] = {p->pipe_from, p->pipe_to};
+            for (int i = 0; i < 2; i++) {
+                if (other[i] != -1 && e->jobs->processes[other[i]].held) {
+                    engine_resume_stage(e, ops, policy, other[i]);
+                }
+            }
+        }
+        if (!r.exited) {
+            ops->requeue(policy, e, job, level);
+            continue;
+        }
+        engine_complete(e, job, r);
+        if (ops->finish != NULL) {
+            ops->finish(policy, e, job);
+        }
+    }
+
+    engine_end_run(e);
+}
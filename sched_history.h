@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+
+// Average burst time (ms) of every command run so far in this process, used to estimate
+// how long a job will take: SJF and online MLFQ rank submissions by it, EDF tests
+// deadlines against it, the DAG scheduler sizes critical paths with it and the engine
+// batches the tiny ones. The engine records every job that exits cleanly. Commands are
+// keyed without their options (read_job_options), so a pipeline stage keeps one history
+// whichever job feeds it, like a command whatever its TICKETS or NICE.
+
+#define MAX_HISTORY_COMMANDS 100
+#define MAX_COMMAND_LENGTH 256      // Longest submission, and longest command with a history
+
+typedef struct {
+    char command[MAX_COMMAND_LENGTH];
+    uint64_t avg_burst_time;
+    int count;
+} HistoricalData;
+
+typedef struct {
+    HistoricalData data[MAX_HISTORY_COMMANDS];
+    int count;
+} HistoricalDataList;
+
+HistoricalDataList historical_data = {0};
+
+void update_historical_data(HistoricalDataList *list, const char *command, uint64_t burst_time) {
+    for (int i = 0; i < list->count; i++) {
+        if (strcmp(list->data[i].command, command) == 0) {
+            list->data[i].avg_burst_time = (list->data[i].avg_burst_time * list->data[i].count + burst_time) / (list->data[i].count + 1);
+            list->data[i].count++;
+            return;
+        }
+    }
+
+    if (list->count < MAX_HISTORY_COMMANDS && strlen(command) < MAX_COMMAND_LENGTH) {
+        strcpy(list->data[list->count].command, command);
+        list->data[list->count].avg_burst_time = burst_time;
+        list->data[list->count].count = 1;
+        list->count++;
+    }
+}
+
+uint64_t get_historical_burst_time(HistoricalDataList *list, const char *command) {
+    for (int i = 0; i < list->count; i++) {
+        if (strcmp(list->data[i].command, command) == 0) {
+            return list->data[i].avg_burst_time;
+        }
+    }
+    return 1000; // Default 1000 if no historical data
+}
+
+bool is_new_command(HistoricalDataList *list, const char *command) {
+    for (int i = 0; i < list->count; i++) {
+        if (strcmp(list->data[i].command, command) == 0) {
+            return false;  // Command found in historical data
+        }
+    }
+    return true;  // Command not found, so it's new
+}
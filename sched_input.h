@@ -0,0 +1,131 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "sched_clock.h"
+
+// Submissions on stdin during online real runs. Lines are read as soon as they arrive,
+// while a slice runs too (see run_slice), and each is stamped with the time it was read:
+// that is its arrival, so a submission that came in during a slice is charged the rest of
+// the slice as waiting and response time instead of arriving when the slice is over. The
+// default backend reads a non-blocking stdin with read(2), the io_uring backend
+// (sched_uring.h) through its standing read; both fill the same buffer.
+
+#define INPUT_BUFFER_SIZE 4096
+#define INPUT_STAMPS 256            // Lines read ahead of being taken that keep their stamp
+
+typedef struct {
+    uint64_t line;              // Number of the line, counted from the start of the run
+    uint64_t read_ns;
+} InputStamp;
+
+typedef struct {
+    char buffer[INPUT_BUFFER_SIZE];
+    size_t start;               // Unconsumed input is buffer[start, used)
+    size_t used;
+    bool eof;
+    bool during_slices;         // Read while slices run (online real runs)
+    bool ends_slices;           // A whole line read while a slice runs ends the slice
+    uint64_t lines_read;        // Newlines read so far
+    uint64_t lines_taken;       // Newlines consumed so far
+    InputStamp stamps[INPUT_STAMPS];    // Line n's in stamps[n % INPUT_STAMPS]
+} SubmissionInput;
+
+SubmissionInput submission_input;
+
+// Function to start reading the submissions of a run from scratch
+void input_begin_run(bool during_slices, bool ends_slices) {
+    memset(&submission_input, 0, sizeof(submission_input));
+    submission_input.during_slices = during_slices;
+    submission_input.ends_slices = during_slices && ends_slices;
+}
+
+// Function to make room at the end of the buffer, false when it is full of unconsumed input
+bool input_make_room() {
+    SubmissionInput *in = &submission_input;
+    if (in->start > 0) {
+        memmove(in->buffer, in->buffer + in->start, in->used - in->start);
+        in->used -= in->start;
+        in->start = 0;
+    }
+    return in->used < INPUT_BUFFER_SIZE;
+}
+
+// Function to take in length bytes just read to the end of the buffer, stamping the lines
+// they complete with read_ns
+void input_received(size_t length, uint64_t read_ns) {
+    SubmissionInput *in = &submission_input;
+    for (size_t i = in->used; i < in->used + length; i++) {
+        if (in->buffer[i] == '\n') {
+            InputStamp *stamp = &in->stamps[in->lines_read % INPUT_STAMPS];
+            if (in->lines_read - in->lines_taken < INPUT_STAMPS) {
+                *stamp = (InputStamp){in->lines_read, read_ns};
+            }
+            in->lines_read++;
+        }
+    }
+    in->used += length;
+}
+
+// Function to read whatever stdin holds without blocking (default backend, stdin is
+// non-blocking for the run). True when it brought in a whole line.
+bool input_read_available() {
+    SubmissionInput *in = &submission_input;
+    uint64_t lines = in->lines_read;
+    while (!in->eof && input_make_room()) {
+        ssize_t n = read(STDIN_FILENO, in->buffer + in->used, INPUT_BUFFER_SIZE - in->used);
+        if (n > 0) {
+            input_received((size_t)n, sched_now_ns());
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (n == 0 || errno != EAGAIN) {
+                in->eof = true;     // End of input, or input that cannot be read
+            }
+            break;
+        }
+    }
+    return in->lines_read != lines;
+}
+
+// Function to take the next line read so far, with the time it was read in *read_ns.
+// False when no whole line is in yet. Lines longer than size - 1 are split, as fgets
+// would; a line without a stamp (read too far ahead, or ended by the end of input) is
+// stamped now.
+bool input_take_line(char *line, size_t size, uint64_t *read_ns) {
+    SubmissionInput *in = &submission_input;
+    char *data = in->buffer + in->start;
+    size_t available = in->used - in->start;
+    char *newline = (char *)memchr(data, '\n', available);
+    size_t length = newline != NULL ? (size_t)(newline - data) : available;
+
+    if (available == 0 || (newline == NULL && !in->eof && available < size - 1)) {
+        return false;
+    }
+    size_t consumed = length + (newline != NULL);
+    if (length > size - 1) {
+        length = consumed = size - 1;
+    }
+    memcpy(line, data, length);
+    line[length] = '\0';
+    in->start += consumed;
+
+    InputStamp *stamp = &in->stamps[in->lines_taken % INPUT_STAMPS];
+    *read_ns = newline != NULL && stamp->line == in->lines_taken && stamp->read_ns != 0
+        ? stamp->read_ns : sched_now_ns();
+    if (consumed == length + 1) {
+        in->lines_taken++;
+    }
+    return true;
+}
+
+// Function to tell whether stdin is at its end and every line of it was taken
+bool input_exhausted() {
+    return submission_input.eof && submission_input.start == submission_input.used;
+}
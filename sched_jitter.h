@@ -0,0 +1,154 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "sched_uring.h"
+
+// Low-jitter mode of the dispatcher, enabled by SCHED_LOW_JITTER=1 for real runs, so that
+// it wakes up on time at the end of a quantum:
+//
+//   - it pins itself to a core of its own, the last one it may run on or
+//     SCHED_LOW_JITTER_CPU=<n>, and keeps the jobs off that core
+//   - it raises itself to SCHED_FIFO (LOW_JITTER_PRIORITY) when permitted, so no job
+//     can delay its wakeup. Only with a core of its own or the io_uring backend
+//     (sched_uring.h): the default backend polls for the end of the quantum and would
+//     starve the job it runs on a shared core
+//   - it prefaults its stack and LOW_JITTER_HEAP_BYTES of heap, which malloc keeps
+//     afterwards, and locks its memory (mlockall), so no slice waits on a page fault
+//
+// What is not permitted (no spare core, no CAP_SYS_NICE, RLIMIT_MEMLOCK) is skipped with
+// a note. Jobs and the scheduler's helper threads (result writer, output capture) call
+// low_jitter_leave() first thing, which moves them off the core and back to normal
+// priority. Quantum overshoot, the measure of what this buys, is in the stats summary
+// of every run and in bench_offline (real_overshoot_p99).
+
+#define LOW_JITTER_PRIORITY 10
+#define LOW_JITTER_HEAP_BYTES (16 << 20)
+#define LOW_JITTER_STACK_BYTES (256 << 10)
+#define LOW_JITTER_MASK_WORDS 16    // CPU masks for up to 1024 CPUs
+
+typedef struct {
+    int state;                  // 0 until SCHED_LOW_JITTER is read, 1 on, -1 off
+    int cpu;                    // The dispatcher's core, -1 when it shares the CPUs with the jobs
+    bool realtime;              // The dispatcher runs at SCHED_FIFO
+    unsigned long job_cpus[LOW_JITTER_MASK_WORDS];     // Where jobs and helper threads run
+} LowJitter;
+
+LowJitter low_jitter = {0, -1, false, {0}};
+
+// Function to touch the stack the dispatcher may grow into, so it is mapped (and locked) now
+__attribute__((noinline)) void low_jitter_prefault_stack() {
+    volatile char stack[LOW_JITTER_STACK_BYTES];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+// Function to keep the jobs and helper threads off the dispatcher's core and at normal
+// priority. Called by them first thing; does nothing unless the mode is on.
+void low_jitter_leave() {
+    if (low_jitter.cpu != -1) {
+        syscall(SYS_sched_setaffinity, 0, sizeof(low_jitter.job_cpus), low_jitter.job_cpus);
+    }
+    if (low_jitter.realtime) {
+        struct sched_param param = {0};
+        sched_setscheduler(0, SCHED_OTHER, &param);
+    }
+}
+
+// Function to enter the low-jitter mode: reserve a core, raise the priority, lock and
+// prefault memory, as far as permitted
+void low_jitter_enter() {
+    char notes[256] = "";
+    unsigned long allowed[LOW_JITTER_MASK_WORDS] = {0};
+    int bits = 8 * (int)sizeof(unsigned long);
+    int cpus = 0, last = -1;
+    if (syscall(SYS_sched_getaffinity, 0, sizeof(allowed), allowed) > 0) {
+        for (int cpu = 0; cpu < LOW_JITTER_MASK_WORDS * bits; cpu++) {
+            if (allowed[cpu / bits] & (1UL << (cpu % bits))) {
+                cpus++;
+                last = cpu;
+            }
+        }
+    }
+    const char *requested = getenv("SCHED_LOW_JITTER_CPU");
+    int cpu = requested != NULL && requested[0] != '\0' ? atoi(requested) : last;
+    if (cpus < 2) {
+        strcat(notes, ", no spare core to reserve");
+    } else if (cpu < 0 || cpu >= LOW_JITTER_MASK_WORDS * bits || !(allowed[cpu / bits] & (1UL << (cpu % bits)))) {
+        strcat(notes, ", SCHED_LOW_JITTER_CPU is not an allowed CPU");
+    } else {
+        unsigned long own[LOW_JITTER_MASK_WORDS] = {0};
+        own[cpu / bits] = 1UL << (cpu % bits);
+        memcpy(low_jitter.job_cpus, allowed, sizeof(allowed));
+        low_jitter.job_cpus[cpu / bits] &= ~own[cpu / bits];
+        if (syscall(SYS_sched_setaffinity, 0, sizeof(own), own) == 0) {
+            low_jitter.cpu = cpu;
+        } else {
+            strcat(notes, ", cannot pin to a core");
+        }
+    }
+
+    if (low_jitter.cpu != -1 || uring_enabled()) {
+        struct sched_param param = {LOW_JITTER_PRIORITY};
+        if (sched_setscheduler(0, SCHED_FIFO, &param) == 0) {
+            low_jitter.realtime = true;
+        } else {
+            strcat(notes, errno == EPERM ? ", SCHED_FIFO not permitted" : ", cannot set SCHED_FIFO");
+        }
+    } else {
+        strcat(notes, ", normal priority (a shared core needs SCHED_URING for SCHED_FIFO)");
+    }
+
+    // Freed memory stays with malloc, large blocks included, so the prefaulted heap serves later allocations
+    mallopt(M_MMAP_MAX, 0);
+    mallopt(M_TRIM_THRESHOLD, -1);
+    char *heap = (char *)malloc(LOW_JITTER_HEAP_BYTES);
+    if (heap != NULL) {
+        for (size_t i = 0; i < LOW_JITTER_HEAP_BYTES; i += 4096) {
+            heap[i] = 0;
+        }
+        free(heap);
+    }
+    low_jitter_prefault_stack();
+
+    // Memory mapped later is locked too only without a locking limit, else allocations
+    // beyond the limit would fail
+    struct rlimit limit;
+    bool unlimited = getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY;
+    bool locked = mlockall(MCL_CURRENT | (unlimited || geteuid() == 0 ? MCL_FUTURE : 0)) == 0;
+    if (!locked) {
+        strcat(notes, ", cannot lock memory");
+    }
+
+    char core[32] = "shared CPUs";
+    if (low_jitter.cpu != -1) {
+        snprintf(core, sizeof(core), "CPU %d", low_jitter.cpu);
+    }
+    fprintf(stderr, "Low-jitter mode: dispatcher on %s, %s, memory %s%s\n", core,
+            low_jitter.realtime ? "SCHED_FIFO" : "SCHED_OTHER", locked ? "locked" : "not locked", notes);
+}
+
+// Function to tell whether the low-jitter mode is on (SCHED_LOW_JITTER=1), entering it on
+// the first call. The dispatcher calls it before it starts any helper thread.
+bool low_jitter_enabled() {
+    if (low_jitter.state == 0) {
+        const char *env = getenv("SCHED_LOW_JITTER");
+        low_jitter.state = env != NULL && env[0] != '\0' && strcmp(env, "0") != 0 ? 1 : -1;
+        if (low_jitter.state == 1) {
+            low_jitter_enter();
+        }
+    }
+    return low_jitter.state == 1;
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+
+#include "sched_clock.h"
+
+// Live state of the running scheduler in a POSIX shared-memory page, enabled by
+// SCHED_LIVE=<name> (e.g. /sched_live). External monitors map the page read-only and
+// sample it as often as they like (see tools/live_top.c); the dispatcher only does
+// plain stores into it, no system calls and no locks.
+//
+// Consistency is a seqlock: the dispatcher makes sequence odd before it changes the
+// page and even again afterwards, a reader copies the page and retries when sequence
+// was odd or changed meanwhile. The page is left in place after the run so the final
+// state stays readable; the next run with the same name overwrites it.
+
+#define LIVE_MAGIC 0x5343484cu     // "SCHL"
+#define LIVE_VERSION 2
+#define LIVE_MAX_LEVELS 8
+#define LIVE_COMMAND_LENGTH 256
+
+typedef enum {
+    LIVE_IDLE,          // Waiting for submissions
+    LIVE_RUNNING,       // A job is on the CPU
+    LIVE_DONE           // The run finished
+} LiveState;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    _Atomic uint64_t sequence;
+    int32_t pid;
+    uint32_t policy;            // SchedPolicy
+    uint32_t levels;            // Number of valid queue_depth entries
+    uint32_t state;             // LiveState
+    uint64_t updated_ns;        // Time of the last update since the run start
+    uint64_t submitted;
+    uint64_t completed;
+    uint64_t errors;
+    uint64_t slices;
+    uint64_t boosts;
+    uint64_t in_system;         // Admitted and not finished (online)
+    uint64_t deferred;          // Waiting for admission
+    uint64_t rejected;          // By admission control or because the job list was full
+    uint64_t queue_depth[LIVE_MAX_LEVELS];
+    int64_t running_job;        // -1 when no job is running
+    int32_t running_level;      // -1 for single-queue policies
+    uint64_t running_since_ns;
+    char running_command[LIVE_COMMAND_LENGTH];
+} LiveStats;
+
+LiveStats *live_stats = NULL;   // NULL while SCHED_LIVE is unset
+
+// Start of an update: readers that see an odd sequence retry
+void live_write_begin() {
+    atomic_store_explicit(&live_stats->sequence, atomic_load_explicit(&live_stats->sequence, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+void live_write_end() {
+    live_stats->updated_ns = sched_now_ns() - sched_epoch_ns;
+    atomic_store_explicit(&live_stats->sequence, atomic_load_explicit(&live_stats->sequence, memory_order_relaxed) + 1,
+                          memory_order_release);
+}
+
+// Function to copy a consistent snapshot of a mapped page, false if it is not a live stats
+// page or no consistent copy could be taken (the writer died in the middle of an update)
+bool live_read(const LiveStats *page, LiveStats *snapshot) {
+    if (page->magic != LIVE_MAGIC || page->version != LIVE_VERSION) {
+        return false;
+    }
+    for (int attempt = 0; attempt < 1000000; attempt++) {
+        uint64_t before = atomic_load_explicit((_Atomic uint64_t *)&page->sequence, memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        memcpy(snapshot, page, sizeof(LiveStats));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit((_Atomic uint64_t *)&page->sequence, memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function to map the page (once per process) and reset it for a new run. Call after sched_clock_reset().
+void live_begin_run(uint32_t policy, int levels) {
+    if (live_stats == NULL) {
+        const char *name = getenv("SCHED_LIVE");
+        if (name == NULL || name[0] == '\0') {
+            return;
+        }
+        int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+        if (fd == -1 || ftruncate(fd, sizeof(LiveStats)) != 0) {
+            perror("Error creating the live stats page");
+            if (fd != -1) close(fd);
+            return;
+        }
+        void *page = mmap(NULL, sizeof(LiveStats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (page == MAP_FAILED) {
+            perror("Error mapping the live stats page");
+            return;
+        }
+        live_stats = (LiveStats *)page;
+    }
+
+    live_write_begin();
+    memset((char *)live_stats + offsetof(LiveStats, pid), 0, sizeof(LiveStats) - offsetof(LiveStats, pid));
+    live_stats->magic = LIVE_MAGIC;
+    live_stats->version = LIVE_VERSION;
+    live_stats->pid = getpid();
+    live_stats->policy = policy;
+    live_stats->levels = levels < LIVE_MAX_LEVELS ? levels : LIVE_MAX_LEVELS;
+    live_stats->state = LIVE_IDLE;
+    live_stats->running_job = -1;
+    live_stats->running_level = -1;
+    live_write_end();
+}
+
+void live_end_run() {
+    if (live_stats == NULL) {
+        return;
+    }
+    live_write_begin();
+    live_stats->state = LIVE_DONE;
+    live_stats->running_job = -1;
+    live_write_end();
+}
+
+void live_record_submissions(uint64_t count) {
+    if (live_stats == NULL) {
+        return;
+    }
+    live_write_begin();
+    live_stats->submitted += count;
+    live_write_end();
+}
+
+void live_set_queue_depth(int level, uint64_t depth) {
+    if (live_stats == NULL || level < 0 || level >= LIVE_MAX_LEVELS) {
+        return;
+    }
+    live_write_begin();
+    live_stats->queue_depth[level] = depth;
+    live_write_end();
+}
+
+void live_record_boost() {
+    if (live_stats == NULL) {
+        return;
+    }
+    live_write_begin();
+    live_stats->boosts++;
+    live_write_end();
+}
+
+// Function to publish the job about to run; level is -1 for single-queue policies
+void live_slice_begin(int job, int level, const char *command) {
+    if (live_stats == NULL) {
+        return;
+    }
+    live_write_begin();
+    live_stats->state = LIVE_RUNNING;
+    live_stats->running_job = job;
+    live_stats->running_level = level;
+    live_stats->running_since_ns = sched_now_ns() - sched_epoch_ns;
+    size_t length = strnlen(command, LIVE_COMMAND_LENGTH - 1);
+    memcpy(live_stats->running_command, command, length);
+    live_stats->running_command[length] = '\0';
+    live_write_end();
+}
+
+void live_slice_end(bool exited, bool error) {
+    if (live_stats == NULL) {
+        return;
+    }
+    live_write_begin();
+    live_stats->state = LIVE_IDLE;
+    live_stats->running_job = -1;
+    live_stats->slices++;
+    live_stats->completed += exited;
+    live_stats->errors += exited && error;
+    live_write_end();
+}
@@ -0,0 +1,796 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "sched_jitter.h"
+
+// Where a job's stdout and stderr go, SCHED_JOB_OUTPUT=<mode> (by default offline runs
+// discard them and online runs let them through to the scheduler's terminal):
+//
+//   discard        /dev/null
+//   inherit        the scheduler's own stdout and stderr
+//   files:<dir>    <dir>/job_<n>.log per job, created once the job writes something
+//   log:<path>     one shared log, each chunk headed "==> job <n>: <command> <==" when
+//                  the job changes; rotated to <path>.1 at SCHED_JOB_OUTPUT_FILE_BYTES
+//   ring:<path>    a shared memory-mapped ring file of SCHED_JOB_OUTPUT_FILE_BYTES (default
+//                  64 MiB) bytes of data after a 64 byte OutputRingHeader, overwriting the
+//                  oldest output; readers map it and follow the written counter
+//
+// The capturing modes give every job a pipe. A capture thread waits on all of them in
+// epoll and splice()s the bytes from the pipe to the file inside the kernel, never
+// through userspace (the ring, being memory, gets one read() per chunk). The dispatcher
+// only creates the pipe at spawn, so a chatty job fills its own pipe and blocks, never
+// the dispatcher. SCHED_JOB_OUTPUT_MAX_BYTES caps the output kept per job; the rest is
+// spliced to /dev/null and counted as dropped.
+//
+// Pipeline stages (a job submitted with PIPE_FROM=<job>, see sched_engine.h) are wired by
+// the same thread: the producer's stdout is a pipe of its own, the consumer's stdin another,
+// and the thread splice()s from one to the other as the consumer drains its end, so the
+// bytes never reach the dispatcher. A full pipe is the backpressure: the producer blocks
+// on it, and job_output_stall() tells the engine so before it gives the producer a slice.
+// A consumer that exits first makes the thread close the producer's pipe, which gets the
+// producer SIGPIPE like in a shell pipeline. The producer's stderr goes wherever the mode
+// sends output.
+
+typedef enum {
+    JOB_OUTPUT_DISCARD,
+    JOB_OUTPUT_INHERIT,
+    JOB_OUTPUT_FILES,
+    JOB_OUTPUT_LOG,
+    JOB_OUTPUT_RING
+} JobOutputMode;
+
+JobOutputMode job_output_mode = JOB_OUTPUT_DISCARD;
+
+#define OUTPUT_CHUNK_BYTES (64 << 10)
+#define OUTPUT_DEFAULT_FILE_BYTES (64ULL << 20)
+#define OUTPUT_RING_MAGIC 0x474e4952u      // "RING"
+#define OUTPUT_RING_VERSION 1
+#define OUTPUT_DRAIN_TIMEOUT_MS 1000
+#define OUTPUT_GETPIPE_SZ 1032          // F_GETPIPE_SZ, only defined with _GNU_SOURCE
+
+#ifndef SPLICE_F_MOVE
+#define SPLICE_F_MOVE 1
+#define SPLICE_F_NONBLOCK 2
+#endif
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;                  // Bytes of data after the header
+    _Atomic uint64_t written;       // Bytes ever written, the next one goes to written % size
+    uint8_t reserved[40];
+} OutputRingHeader;
+
+// One job's pipe, owned by the capture thread once handed over
+typedef struct {
+    int fd;                 // Read end
+    int job;
+    char *command;
+    int file;               // files mode: the job's log, -1 until it writes
+    uint64_t kept;          // Relays: bytes passed on to the consumer
+    uint64_t dropped;
+    // Relays only (a pipeline producer's stdout); feed, consumer_gone and closed under lock
+    bool relay;
+    int feed;               // Write end of the consumer's stdin, -1 until it is spawned
+    bool feed_watched;      // feed is in the epoll set
+    bool consumer_gone;     // Exited or never to be spawned: close fd and end the relay
+    bool closed;            // Both ends closed, the entry stays for the run's summary
+} CapturedOutput;
+
+// A job's place in a pipeline, set up before either side is spawned
+typedef struct {
+    int producer;           // Job whose stdout is this job's stdin, -1 for none
+    int consumer;           // Job this job's stdout feeds, -1 for none
+    CapturedOutput *relay;  // Producer: its stdout pipe, once spawned
+    int feed;               // Producer: the consumer's stdin when it was spawned first
+    bool spawned;
+    bool done;
+    uint64_t starved;       // Slices held back for want of input
+    uint64_t blocked;       // Slices held back with the output pipe full
+} PipelineStage;
+
+typedef enum {
+    STAGE_READY,
+    STAGE_STARVED,          // A consumer with nothing to read and its producer still going
+    STAGE_BLOCKED           // A producer with its pipe full
+} StageState;
+
+// The child's ends of a spawning job's pipes, -1 where the mode's default applies, and
+// the parent's ends handed over once it is forked
+typedef struct {
+    int stdin_fd;
+    int stdout_fd;
+    int stderr_fd;
+    CapturedOutput *capture;    // stdout (unless relayed) and stderr to the log
+    CapturedOutput *relay;      // stdout to the next pipeline stage
+    int feed;                   // Write end of this consumer's stdin
+} JobIo;
+
+typedef struct {
+    char path[1024];        // Directory (files) or file (log, ring)
+    uint64_t max_job_bytes; // 0 = no cap
+    uint64_t file_bytes;    // Log rotation size, ring size
+    int epoll_fd;
+    int devnull;
+    bool started;
+    JobOutputMode capture;  // Mode the destination was opened for
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t drained;
+    int open_pipes;
+    // Capture thread only
+    int log;
+    int64_t log_offset;
+    int last_job;           // Whose output the log or ring holds last, for the headers
+    OutputRingHeader *ring;
+    uint8_t *ring_data;
+    // Totals of the run, under lock
+    uint64_t jobs;
+    uint64_t kept;
+    uint64_t dropped;
+    uint64_t rotations;
+    // Pipeline stages of the run, indexed by job (dispatcher only)
+    PipelineStage *stages;
+    int stage_count;
+    int links;
+} JobOutput;
+
+JobOutput job_output = {.epoll_fd = -1, .devnull = -1, .log = -1, .last_job = -1,
+                        .lock = PTHREAD_MUTEX_INITIALIZER, .drained = PTHREAD_COND_INITIALIZER};
+
+ssize_t output_splice(int in, int out, int64_t *out_offset, size_t length) {
+    return syscall(SYS_splice, in, NULL, out, out_offset, length, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+}
+
+uint64_t output_env_bytes(const char *name, uint64_t fallback) {
+    const char *value = getenv(name);
+    return value != NULL && value[0] != '\0' ? strtoull(value, NULL, 10) : fallback;
+}
+
+// Function to append a line of the scheduler's own to the shared log or ring
+void output_note(const char *text, size_t length) {
+    JobOutput *o = &job_output;
+    if (o->ring != NULL) {
+        uint64_t written = atomic_load_explicit(&o->ring->written, memory_order_relaxed);
+        for (size_t i = 0; i < length; i++) {
+            o->ring_data[(written + i) % o->ring->size] = (uint8_t)text[i];
+        }
+        atomic_store_explicit(&o->ring->written, written + length, memory_order_release);
+    } else if (o->log != -1 && pwrite(o->log, text, length, o->log_offset) > 0) {
+        o->log_offset += length;
+    }
+}
+
+// Function to head the job's next bytes in the shared log or ring, unless it wrote last
+void output_header(CapturedOutput *c) {
+    if (c->job == job_output.last_job) {
+        return;
+    }
+    char header[256];
+    int length = snprintf(header, sizeof(header), "==> job %d: %.200s <==\n", c->job, c->command);
+    output_note(header, length);
+    job_output.last_job = c->job;
+}
+
+void output_rotate_log() {
+    JobOutput *o = &job_output;
+    char previous[sizeof(job_output.path) + 8];
+    snprintf(previous, sizeof(previous), "%.1000s.1", o->path);
+    close(o->log);
+    if (rename(o->path, previous) != 0) {
+        perror("Error rotating job output log");
+    }
+    o->log = open(o->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    o->log_offset = 0;
+    o->last_job = -1;
+    pthread_mutex_lock(&o->lock);
+    o->rotations++;
+    pthread_mutex_unlock(&o->lock);
+}
+
+// Function to move what a job's pipe holds to its destination, false at end of file
+bool output_transfer(CapturedOutput *c) {
+    JobOutput *o = &job_output;
+    while (true) {
+        // Nothing pending: wait for more, unless every writer is gone (polled before the
+        // second look, so bytes written just before the last close are not missed)
+        int pending = 0;
+        if (ioctl(c->fd, FIONREAD, &pending) == 0 && pending == 0) {
+            struct pollfd pfd = {c->fd, POLLIN, 0};
+            poll(&pfd, 1, 0);
+            if (ioctl(c->fd, FIONREAD, &pending) != 0 || pending == 0) {
+                return !(pfd.revents & POLLHUP);
+            }
+        }
+
+        size_t room = OUTPUT_CHUNK_BYTES;
+        bool keep = o->max_job_bytes == 0 || c->kept < o->max_job_bytes;
+        if (keep && o->max_job_bytes != 0 && o->max_job_bytes - c->kept < room) {
+            room = o->max_job_bytes - c->kept;
+        }
+        if (keep && o->capture != JOB_OUTPUT_FILES) {
+            output_header(c);
+        }
+
+        ssize_t moved;
+        if (!keep) {
+            moved = output_splice(c->fd, o->devnull, NULL, OUTPUT_CHUNK_BYTES);
+        } else if (o->capture == JOB_OUTPUT_FILES) {
+            if (c->file == -1) {
+                char name[sizeof(job_output.path) + 32];
+                snprintf(name, sizeof(name), "%.1000s/job_%d.log", o->path, c->job);
+                c->file = open(name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+                if (c->file == -1) {
+                    perror("Error opening job output file");
+                    c->file = o->devnull;
+                }
+            }
+            moved = output_splice(c->fd, c->file, NULL, room);
+        } else if (o->capture == JOB_OUTPUT_LOG) {
+            moved = output_splice(c->fd, o->log, &o->log_offset, room);
+        } else {
+            // The ring is memory: read straight into it, up to its end
+            uint64_t written = atomic_load_explicit(&o->ring->written, memory_order_relaxed);
+            uint64_t position = written % o->ring->size;
+            if (room > o->ring->size - position) {
+                room = o->ring->size - position;
+            }
+            moved = read(c->fd, o->ring_data + position, room);
+            if (moved > 0) {
+                atomic_store_explicit(&o->ring->written, written + moved, memory_order_release);
+            }
+        }
+
+        if (moved == 0) {
+            return false;
+        }
+        if (moved < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN) {
+                perror("Error capturing job output");
+                return false;
+            }
+            return true;
+        }
+        if (keep) {
+            c->kept += moved;
+        } else {
+            c->dropped += moved;
+        }
+        if (o->capture == JOB_OUTPUT_LOG && o->file_bytes != 0 && (uint64_t)o->log_offset >= o->file_bytes) {
+            output_rotate_log();
+        }
+    }
+}
+
+// Function to wait (one shot) for fd, a relay's own pipe or its feed, to be ready
+void output_arm(CapturedOutput *c, int fd, uint32_t events) {
+    struct epoll_event event = {events | EPOLLONESHOT, {.ptr = c}};
+    int operation = EPOLL_CTL_MOD;
+    if (fd == c->feed && !c->feed_watched) {
+        operation = EPOLL_CTL_ADD;
+        c->feed_watched = true;
+    }
+    if (epoll_ctl(job_output.epoll_fd, operation, fd, &event) != 0) {
+        perror("Error watching pipeline pipe");
+    }
+}
+
+// Function to pass what a pipeline producer wrote on to its consumer's stdin, false once
+// the relay is over: the producer's end is at end of file or the consumer is gone
+bool output_relay(CapturedOutput *c) {
+    JobOutput *o = &job_output;
+    while (true) {
+        pthread_mutex_lock(&o->lock);
+        int feed = c->feed;
+        bool gone = c->consumer_gone;
+        pthread_mutex_unlock(&o->lock);
+        if (gone) {
+            return false;
+        }
+        if (feed == -1) {
+            return true;  // Re-armed when the consumer is spawned
+        }
+
+        ssize_t moved = output_splice(c->fd, feed, NULL, OUTPUT_CHUNK_BYTES);
+        if (moved > 0) {
+            c->kept += moved;
+            continue;
+        }
+        if (moved == 0) {
+            return false;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN) {
+            if (errno != EPIPE) {  // EPIPE: the consumer exited
+                perror("Error relaying pipeline output");
+            }
+            return false;
+        }
+        // Wait for input, or for room in the consumer's pipe when input is what waits
+        int pending = 0;
+        ioctl(c->fd, FIONREAD, &pending);
+        if (pending > 0) {
+            output_arm(c, feed, EPOLLOUT);
+        } else {
+            output_arm(c, c->fd, EPOLLIN);
+        }
+        return true;
+    }
+}
+
+// Function to close a job's capture once its pipe is at end of file
+void output_close(CapturedOutput *c) {
+    JobOutput *o = &job_output;
+    if (c->relay) {
+        // The consumer sees end of file, the producer SIGPIPE if it is still writing
+        pthread_mutex_lock(&o->lock);
+        close(c->fd);
+        if (c->feed != -1) {
+            close(c->feed);
+            c->feed = -1;
+        }
+        c->closed = true;
+        o->open_pipes--;
+        pthread_cond_broadcast(&o->drained);
+        pthread_mutex_unlock(&o->lock);
+        return;
+    }
+    if (c->dropped > 0) {
+        char note[128];
+        int length = snprintf(note, sizeof(note), "\n[%lu bytes of output dropped over the %lu byte cap]\n",
+                              c->dropped, o->max_job_bytes);
+        if (o->capture == JOB_OUTPUT_FILES) {
+            if (c->file != -1 && write(c->file, note, length) < 0) {
+                perror("Error writing job output file");
+            }
+        } else {
+            output_header(c);
+            output_note(note, length);
+        }
+    }
+    if (c->file != -1 && c->file != o->devnull) {
+        close(c->file);
+    }
+    close(c->fd);  // Also takes it out of the epoll set
+
+    pthread_mutex_lock(&o->lock);
+    o->jobs++;
+    o->kept += c->kept;
+    o->dropped += c->dropped;
+    o->open_pipes--;
+    pthread_cond_broadcast(&o->drained);
+    pthread_mutex_unlock(&o->lock);
+    free(c->command);
+    free(c);
+}
+
+void *output_capture(void *arg) {
+    (void)arg;
+    low_jitter_leave();
+    // A consumer's stdin closed under a relay makes the splice fail with EPIPE, not the
+    // scheduler exit on SIGPIPE
+    sigset_t pipe_signal;
+    sigemptyset(&pipe_signal);
+    sigaddset(&pipe_signal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_signal, NULL);
+
+    struct epoll_event events[64];
+    while (true) {
+        int count = epoll_wait(job_output.epoll_fd, events, 64, -1);
+        if (count < 0 && errno != EINTR) {
+            perror("epoll_wait failed");
+            return NULL;
+        }
+        for (int i = 0; i < count; i++) {
+            CapturedOutput *c = (CapturedOutput *)events[i].data.ptr;
+            if (c->relay ? !output_relay(c) : !output_transfer(c)) {
+                output_close(c);
+            }
+        }
+    }
+}
+
+// Function to start the capture thread, once per process
+bool output_start() {
+    JobOutput *o = &job_output;
+    if (o->started) {
+        return true;
+    }
+    o->devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    o->epoll_fd = epoll_create(64);
+    if (o->devnull == -1 || o->epoll_fd == -1) {
+        perror("Error setting up job output capture");
+        return false;
+    }
+    fcntl(o->epoll_fd, F_SETFD, FD_CLOEXEC);
+    if (pthread_create(&o->thread, NULL, output_capture, NULL) != 0) {
+        perror("Error starting the job output thread");
+        return false;
+    }
+    pthread_detach(o->thread);
+    o->started = true;
+    return true;
+}
+
+// Function to open the shared destination of the log and ring modes, before any job writes
+bool output_open_destination() {
+    JobOutput *o = &job_output;
+    if (job_output_mode == JOB_OUTPUT_LOG) {
+        o->log = open(o->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (o->log == -1) {
+            perror("Error opening job output log");
+            return false;
+        }
+    } else if (job_output_mode == JOB_OUTPUT_RING) {
+        uint64_t size = o->file_bytes ? o->file_bytes : OUTPUT_DEFAULT_FILE_BYTES;
+        int fd = open(o->path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1 || ftruncate(fd, sizeof(OutputRingHeader) + size) != 0) {
+            perror("Error creating job output ring");
+            if (fd != -1) close(fd);
+            return false;
+        }
+        void *map = mmap(NULL, sizeof(OutputRingHeader) + size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            perror("Error mapping job output ring");
+            return false;
+        }
+        o->ring = (OutputRingHeader *)map;
+        o->ring_data = (uint8_t *)map + sizeof(OutputRingHeader);
+        o->ring->magic = OUTPUT_RING_MAGIC;
+        o->ring->version = OUTPUT_RING_VERSION;
+        o->ring->size = size;
+    }
+    return true;
+}
+
+// Function to forget the pipelines of the previous run. Relays still open (a stage left a
+// background process holding its pipe) stay with the capture thread.
+void output_reset_stages() {
+    JobOutput *o = &job_output;
+    for (int job = 0; job < o->stage_count; job++) {
+        CapturedOutput *c = o->stages[job].relay;
+        if (c != NULL && c->closed) {
+            free(c->command);
+            free(c);
+        }
+    }
+    free(o->stages);
+    o->stages = NULL;
+    o->stage_count = 0;
+    o->links = 0;
+}
+
+// Function to choose where the jobs of a run write, from SCHED_JOB_OUTPUT or the default
+void job_output_begin_run(JobOutputMode default_mode) {
+    JobOutput *o = &job_output;
+    output_reset_stages();
+    const char *mode = getenv("SCHED_JOB_OUTPUT");
+    job_output_mode = default_mode;
+    if (mode == NULL || mode[0] == '\0') {
+        return;
+    }
+    if (strcmp(mode, "discard") == 0) {
+        job_output_mode = JOB_OUTPUT_DISCARD;
+        return;
+    }
+    if (strcmp(mode, "inherit") == 0) {
+        job_output_mode = JOB_OUTPUT_INHERIT;
+        return;
+    }
+
+    JobOutputMode capture;
+    const char *path;
+    if (strncmp(mode, "files:", 6) == 0) {
+        capture = JOB_OUTPUT_FILES;
+        path = mode + 6;
+    } else if (strncmp(mode, "log:", 4) == 0) {
+        capture = JOB_OUTPUT_LOG;
+        path = mode + 4;
+    } else if (strncmp(mode, "ring:", 5) == 0) {
+        capture = JOB_OUTPUT_RING;
+        path = mode + 5;
+    } else {
+        fprintf(stderr, "Unknown SCHED_JOB_OUTPUT %s, using the default\n", mode);
+        return;
+    }
+
+    // The destination stays the same for the life of the process
+    if (o->capture != JOB_OUTPUT_DISCARD) {
+        if (capture != o->capture || strcmp(path, o->path) != 0) {
+            fprintf(stderr, "SCHED_JOB_OUTPUT cannot change within a process, keeping %s\n", o->path);
+        }
+        job_output_mode = o->capture;
+        return;
+    }
+    snprintf(o->path, sizeof(o->path), "%s", path);
+    o->capture = capture;
+    o->max_job_bytes = output_env_bytes("SCHED_JOB_OUTPUT_MAX_BYTES", 0);
+    o->file_bytes = output_env_bytes("SCHED_JOB_OUTPUT_FILE_BYTES", OUTPUT_DEFAULT_FILE_BYTES);
+    job_output_mode = capture;
+    if (!output_open_destination() || !output_start()) {
+        fprintf(stderr, "Job output capture unavailable, discarding job output\n");
+        job_output_mode = JOB_OUTPUT_DISCARD;
+        o->capture = JOB_OUTPUT_DISCARD;
+    }
+}
+
+// Function to tell whether job output goes through the capture thread
+bool job_output_captured() {
+    return job_output_mode >= JOB_OUTPUT_FILES;
+}
+
+// Function to make a job's stdout the stdin of a later job of the run, before either is spawned
+void job_output_link(int producer, int consumer) {
+    JobOutput *o = &job_output;
+    if (consumer >= o->stage_count) {
+        int count = o->stage_count ? o->stage_count : 64;
+        while (count <= consumer) {
+            count *= 2;
+        }
+        o->stages = (PipelineStage *)realloc(o->stages, count * sizeof(PipelineStage));
+        for (int job = o->stage_count; job < count; job++) {
+            o->stages[job] = (PipelineStage){-1, -1, NULL, -1, false, false, 0, 0};
+        }
+        o->stage_count = count;
+    }
+    o->stages[producer].consumer = consumer;
+    o->stages[consumer].producer = producer;
+    o->links++;
+}
+
+PipelineStage *output_stage(int job) {
+    return job < job_output.stage_count ? &job_output.stages[job] : NULL;
+}
+
+// Function to create a pipe for the parent and child sides of a job about to be forked:
+// the parent's end is non-blocking and neither end survives an exec
+bool output_pipe(int fds[2]) {
+    if (pipe(fds) != 0) {
+        perror("Error creating job pipe");
+        return false;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+CapturedOutput *output_new_capture(int fd, int job, const char *command, bool relay) {
+    CapturedOutput *c = (CapturedOutput *)malloc(sizeof(CapturedOutput));
+    *c = (CapturedOutput){fd, job, strdup(command), -1, 0, 0, relay, -1, false, false, false};
+    return c;
+}
+
+void output_free_capture(CapturedOutput *c) {
+    close(c->fd);
+    free(c->command);
+    free(c);
+}
+
+// Function to create the pipes of a job about to be forked: its capture pipe when the
+// output is captured, and its pipeline pipes when it is a stage
+void job_output_prepare(int job, const char *command, JobIo *io) {
+    *io = (JobIo){-1, -1, -1, NULL, NULL, -1};
+    int fds[2];
+    if (job_output_captured() && output_pipe(fds)) {
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        io->capture = output_new_capture(fds[0], job, command, false);
+        io->stdout_fd = io->stderr_fd = fds[1];
+    }
+
+    PipelineStage *stage = output_stage(job);
+    if (stage == NULL) {
+        return;
+    }
+    if (stage->producer != -1) {
+        PipelineStage *producer = &job_output.stages[stage->producer];
+        if (producer->done && !producer->spawned) {
+            io->stdin_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);  // Nothing will ever come
+        } else if (output_pipe(fds)) {
+            fcntl(fds[1], F_SETFL, O_NONBLOCK);
+            io->stdin_fd = fds[0];
+            io->feed = fds[1];
+        }
+    }
+    if (stage->consumer != -1 && !job_output.stages[stage->consumer].done && output_start() && output_pipe(fds)) {
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        io->relay = output_new_capture(fds[0], job, command, true);
+        io->stdout_fd = fds[1];
+    }
+}
+
+// Function to give a relay its consumer's stdin and let the capture thread at it
+void output_attach_feed(CapturedOutput *c, int feed) {
+    pthread_mutex_lock(&job_output.lock);
+    if (c->closed) {
+        close(feed);
+    } else {
+        c->feed = feed;
+        output_arm(c, c->fd, EPOLLIN);
+    }
+    pthread_mutex_unlock(&job_output.lock);
+}
+
+// Function to end a relay whose consumer will not read anymore
+void output_drop_consumer(CapturedOutput *c) {
+    pthread_mutex_lock(&job_output.lock);
+    if (!c->closed) {
+        c->consumer_gone = true;
+        output_arm(c, c->fd, EPOLLIN);
+    }
+    pthread_mutex_unlock(&job_output.lock);
+}
+
+// Function to hand a job's pipes over once the child is forked (or to drop them when the
+// fork failed): captures and relays to the capture thread, a consumer's stdin to the relay
+// of its producer (or to the producer's stage, until the producer is spawned)
+void job_output_started(int job, JobIo *io, bool forked) {
+    JobOutput *o = &job_output;
+    if (io->stdin_fd != -1) {
+        close(io->stdin_fd);
+    }
+    if (io->stdout_fd != -1) {
+        close(io->stdout_fd);
+    }
+    if (io->stderr_fd != -1 && io->stderr_fd != io->stdout_fd) {
+        close(io->stderr_fd);
+    }
+
+    CapturedOutput *c = io->capture;
+    if (c != NULL && !forked) {
+        output_free_capture(c);
+    } else if (c != NULL) {
+        pthread_mutex_lock(&o->lock);
+        o->open_pipes++;
+        pthread_mutex_unlock(&o->lock);
+        struct epoll_event event = {EPOLLIN, {.ptr = c}};
+        if (epoll_ctl(o->epoll_fd, EPOLL_CTL_ADD, c->fd, &event) != 0) {
+            perror("Error watching job output pipe");
+        }
+    }
+
+    PipelineStage *stage = output_stage(job);
+    if (stage == NULL) {
+        return;
+    }
+    stage->spawned = forked;
+    if (io->relay != NULL && !forked) {
+        output_free_capture(io->relay);
+    } else if (io->relay != NULL) {
+        c = io->relay;
+        c->feed = stage->feed;
+        stage->feed = -1;
+        stage->relay = c;
+        pthread_mutex_lock(&o->lock);
+        o->open_pipes++;
+        pthread_mutex_unlock(&o->lock);
+        struct epoll_event event = {EPOLLIN | EPOLLONESHOT, {.ptr = c}};
+        if (epoll_ctl(o->epoll_fd, EPOLL_CTL_ADD, c->fd, &event) != 0) {
+            perror("Error watching pipeline pipe");
+        }
+    }
+    if (io->feed != -1) {
+        PipelineStage *producer = &o->stages[stage->producer];
+        if (!forked || (producer->done && producer->relay == NULL)) {
+            close(io->feed);
+        } else if (producer->relay != NULL) {
+            output_attach_feed(producer->relay, io->feed);
+        } else {
+            producer->feed = io->feed;
+        }
+    }
+}
+
+// Function to note that a job is done (exited, failed to start or rejected), so a stage
+// that never got to run does not leave the other side of its pipeline waiting
+void job_output_job_done(int job) {
+    PipelineStage *stage = output_stage(job);
+    if (stage == NULL) {
+        return;
+    }
+    stage->done = true;
+    if (stage->feed != -1) {
+        close(stage->feed);  // The consumer reads end of file
+        stage->feed = -1;
+    }
+    if (stage->producer != -1 && !stage->spawned) {
+        CapturedOutput *relay = job_output.stages[stage->producer].relay;
+        if (relay != NULL) {
+            output_drop_consumer(relay);
+        }
+    }
+}
+
+// Function to tell whether running a pipeline stage now would only block it on one of its
+// pipes. Read under the lock, so the capture thread does not close the pipes meanwhile.
+StageState job_output_stall(int job) {
+    JobOutput *o = &job_output;
+    PipelineStage *stage = output_stage(job);
+    if (stage == NULL) {
+        return STAGE_READY;
+    }
+    StageState state = STAGE_READY;
+    int pending = 0;
+    pthread_mutex_lock(&o->lock);
+    if (stage->producer != -1) {
+        PipelineStage *producer = &o->stages[stage->producer];
+        CapturedOutput *relay = producer->relay;
+        int feed = relay != NULL ? relay->feed : producer->feed;
+        bool input = producer->done || (relay != NULL && relay->closed)
+            || (feed != -1 && ioctl(feed, FIONREAD, &pending) == 0 && pending > 0)
+            || (relay != NULL && ioctl(relay->fd, FIONREAD, &pending) == 0 && pending > 0);
+        if (!input) {
+            state = STAGE_STARVED;
+        }
+    }
+    if (state == STAGE_READY && stage->consumer != -1 && stage->relay != NULL && !stage->relay->closed
+        && !o->stages[stage->consumer].done) {
+        // The relay drains the pipe whenever the consumer's has room: full means both are
+        int size = fcntl(stage->relay->fd, OUTPUT_GETPIPE_SZ);
+        if (size > 0 && ioctl(stage->relay->fd, FIONREAD, &pending) == 0 && pending >= size) {
+            state = STAGE_BLOCKED;
+        }
+    }
+    pthread_mutex_unlock(&o->lock);
+    if (state == STAGE_STARVED) {
+        stage->starved++;
+    } else if (state == STAGE_BLOCKED) {
+        stage->blocked++;
+    }
+    return state;
+}
+
+// Function to wait (a bounded time: a job may leave a background process holding its
+// pipe) for the output of every exited job, then print the run's capture totals
+void job_output_end_run(FILE *fp) {
+    JobOutput *o = &job_output;
+    if (!job_output_captured() && o->links == 0) {
+        return;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += OUTPUT_DRAIN_TIMEOUT_MS / 1000;
+    pthread_mutex_lock(&o->lock);
+    while (o->open_pipes > 0 && pthread_cond_timedwait(&o->drained, &o->lock, &deadline) != ETIMEDOUT) {
+    }
+    if (job_output_captured()) {
+        fprintf(fp, "Job output: %lu jobs, %lu bytes kept, %lu dropped over the cap, %lu log rotations, %d pipes still open\n",
+                o->jobs, o->kept, o->dropped, o->rotations, o->open_pipes);
+    }
+    o->jobs = o->kept = o->dropped = o->rotations = 0;
+    pthread_mutex_unlock(&o->lock);
+
+    // Only the pipelines run here: on worker agents the stages run unconnected
+    for (int job = 0; job < o->stage_count; job++) {
+        PipelineStage *stage = &o->stages[job];
+        if (stage->consumer == -1 || !stage->spawned) {
+            continue;
+        }
+        PipelineStage *consumer = &o->stages[stage->consumer];
+        fprintf(fp, "Pipeline job %d -> job %d: %lu bytes relayed, producer held back %lu times (pipe full), "
+                "consumer %lu times (no input)\n",
+                job, stage->consumer, stage->relay != NULL ? stage->relay->kept : 0, stage->blocked, consumer->starved);
+    }
+}
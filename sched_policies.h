@@ -0,0 +1,720 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sched_engine.h"
+
+// Policies shared by the offline and online schedulers, plugged into run_engine().
+
+// Round Robin over one FIFO queue; FCFS is Round Robin with an infinite quantum
+typedef struct {
+    Queue *queue;
+    uint64_t quantum_ns;
+} RoundRobinPolicy;
+
+void round_robin_admit(void *policy, Engine *e, int job) {
+    (void)e;
+    enqueue(((RoundRobinPolicy *)policy)->queue, job);
+}
+
+int round_robin_pick(void *policy, Engine *e, uint64_t now_ns, int *level, uint64_t *quantum_ns) {
+    (void)e;
+    (void)now_ns;
+    RoundRobinPolicy *rr = (RoundRobinPolicy *)policy;
+    int job = dequeue(rr->queue);
+    live_set_queue_depth(0, rr->queue->length);
+    *level = -1;
+    *quantum_ns = rr->quantum_ns;
+    return job;
+}
+
+void round_robin_requeue(void *policy, Engine *e, int job, int level) {
+    (void)e;
+    (void)level;
+    enqueue(((RoundRobinPolicy *)policy)->queue, job);
+}
+
+static const PolicyOps round_robin_ops = {
+    .admit = round_robin_admit, .pick = round_robin_pick, .requeue = round_robin_requeue
+};
+
+// Pick step with the quantum fixed at compile time
+#define DEFINE_ROUND_ROBIN_STEPS(name, quantum_ms)                                                  \
+    int name##_pick(void *policy, Engine *e, uint64_t now_ns, int *level, uint64_t *quantum_ns) {   \
+        int job = round_robin_pick(policy, e, now_ns, level, quantum_ns);                           \
+        *quantum_ns = (uint64_t)(quantum_ms) * NS_PER_MS;                                           \
+        return job;                                                                                 \
+    }
+
+// Multi-Level Feedback Queue: the highest non-empty level runs next, a job that uses up
+// its quantum moves one level down, and every boost period all jobs go back to level 0.
+//
+// The level count, quanta and boost period come from an MlfqConfig. The pick and requeue
+// steps take the configuration as an argument and are always inlined, so a scheduler
+// whose configuration is a static const table (see DEFINE_OFFLINE_MLFQ) gets them with
+// every level count, quantum and boost period folded into constants, while mlfq_ops reads
+// the configuration at run time for experiments.
+#define MLFQ_LEVELS 3
+#define MLFQ_MAX_LEVELS 8
+#define MLFQ_MS(ms) ((uint64_t)(ms) * NS_PER_MS)
+
+typedef struct {
+    int levels;
+    uint64_t quantum_ns[MLFQ_MAX_LEVELS];
+    uint64_t boost_ns;
+} MlfqConfig;
+
+typedef struct {
+    const MlfqConfig *config;
+    Queue *queues[MLFQ_MAX_LEVELS];
+    uint64_t last_boost_ns;     // 0 until the first pick of the run
+} MlfqPolicy;
+
+// Function to build the classic three-level configuration from millisecond parameters
+MlfqConfig mlfq_config(int quantum0, int quantum1, int quantum2, int boostTime) {
+    MlfqConfig c = {MLFQ_LEVELS, {ms_to_ns(quantum0), ms_to_ns(quantum1), ms_to_ns(quantum2)}, ms_to_ns(boostTime)};
+    return c;
+}
+
+bool mlfq_config_valid(const MlfqConfig *c) {
+    if (c->levels < 1 || c->levels > MLFQ_MAX_LEVELS) {
+        fprintf(stderr, "MLFQ needs 1 to %d levels, got %d\n", MLFQ_MAX_LEVELS, c->levels);
+        return false;
+    }
+    return true;
+}
+
+void mlfq_init(MlfqPolicy *m, const MlfqConfig *config) {
+    m->config = config;
+    for (int level = 0; level < config->levels; level++) {
+        m->queues[level] = create_queue();
+    }
+    m->last_boost_ns = 0;
+}
+
+void mlfq_free(MlfqPolicy *m) {
+    for (int level = 0; level < m->config->levels; level++) {
+        free_queue(m->queues[level]);
+    }
+}
+
+// Function to queue a job at the given level
+void mlfq_enqueue(MlfqPolicy *m, int job, int level) {
+    enqueue(m->queues[level], job);
+    live_set_queue_depth(level, m->queues[level]->length);
+}
+
+void mlfq_admit(void *policy, Engine *e, int job) {
+    (void)e;
+    mlfq_enqueue((MlfqPolicy *)policy, job, 0);
+}
+
+static inline __attribute__((always_inline))
+int mlfq_pick_with(MlfqPolicy *m, const MlfqConfig *c, uint64_t now_ns, int *level, uint64_t *quantum_ns) {
+    // The boost period counts from the start of the run, which is only known once it runs
+    // (the policy is set up before the engine resets the clock)
+    if (m->last_boost_ns == 0) {
+        m->last_boost_ns = sched_epoch_ns;
+    }
+    // Check if it's time to boost all processes to the highest priority queue
+    if (now_ns - m->last_boost_ns >= c->boost_ns) {
+        for (int l = 1; l < c->levels; l++) {
+            append_queue(m->queues[0], m->queues[l]);
+        }
+        m->last_boost_ns = now_ns;
+        live_record_boost();
+    }
+
+    for (int l = 0; l < c->levels; l++) {
+        if (m->queues[l]->front != NULL) {
+            int job = dequeue(m->queues[l]);
+            publish_queue_depths(m->queues, c->levels);
+            *level = l;
+            *quantum_ns = c->quantum_ns[l];
+            return job;
+        }
+    }
+    return -1;
+}
+
+static inline __attribute__((always_inline))
+void mlfq_requeue_with(MlfqPolicy *m, const MlfqConfig *c, int job, int level) {
+    mlfq_enqueue(m, job, level < c->levels - 1 ? level + 1 : c->levels - 1);
+}
+
+int mlfq_pick(void *policy, Engine *e, uint64_t now_ns, int *level, uint64_t *quantum_ns) {
+    (void)e;
+    MlfqPolicy *m = (MlfqPolicy *)policy;
+    return mlfq_pick_with(m, m->config, now_ns, level, quantum_ns);
+}
+
+void mlfq_requeue(void *policy, Engine *e, int job, int level) {
+    (void)e;
+    MlfqPolicy *m = (MlfqPolicy *)policy;
+    mlfq_requeue_with(m, m->config, job, level);
+}
+
+// A held pipeline stage did not use its pick, so it keeps its level
+void mlfq_resume(void *policy, Engine *e, int job, int level) {
+    (void)e;
+    mlfq_enqueue((MlfqPolicy *)policy, job, level);
+}
+
+static const PolicyOps mlfq_ops = {
+    .admit = mlfq_admit, .pick = mlfq_pick, .requeue = mlfq_requeue, .resume = mlfq_resume
+};
+
+// Function to fill the trace parameters of an MLFQ run: the first three quanta and the boost (ms)
+void mlfq_trace_params(const MlfqConfig *c, uint64_t params[4]) {
+    for (int level = 0; level < 3; level++) {
+        params[level] = level < c->levels ? ns_to_ms(c->quantum_ns[level]) : 0;
+    }
+    params[3] = ns_to_ms(c->boost_ns);
+}
+
+// Pick and requeue steps specialised for the static const configuration `config`
+#define DEFINE_MLFQ_STEPS(name, config)                                                             \
+    int name##_pick(void *policy, Engine *e, uint64_t now_ns, int *level, uint64_t *quantum_ns) {   \
+        (void)e;                                                                                    \
+        return mlfq_pick_with((MlfqPolicy *)policy, &(config), now_ns, level, quantum_ns);          \
+    }                                                                                               \
+    void name##_requeue(void *policy, Engine *e, int job, int level) {                              \
+        (void)e;                                                                                    \
+        mlfq_requeue_with((MlfqPolicy *)policy, &(config), job, level);                             \
+    }
+
+// Both schedulers expose a MultiLevelFeedbackQueue(); the offline one takes the job array
+// and 6 arguments, the online one 4, so the call picks the implementation by its arity
+// and the two headers can be included in one program.
+#define BY_ARITY_6_OR_4(_1, _2, _3, _4, _5, _6, name, ...) name
+#define MultiLevelFeedbackQueue(...) \
+    BY_ARITY_6_OR_4(__VA_ARGS__, OfflineMultiLevelFeedbackQueue, _5, OnlineMultiLevelFeedbackQueue, _3, _2, _1)(__VA_ARGS__)
+
+// Adaptive MLFQ: the three-level MLFQ above, with its quanta and boost period retuned
+// from the bursts of the jobs completed so far instead of fixed up front. Every
+// ADAPTIVE_WINDOW_JOBS completions the older bursts are halved in weight and:
+//
+//   quantum 0  fits the ADAPTIVE_LEVEL0_PERCENTILE burst (plus a quarter of headroom), so
+//              most short, interactive jobs finish in level 0
+//   quantum 2  is a 1/ADAPTIVE_LONG_SLICES share of the p99 burst, so even long jobs
+//              finish in a bounded number of slices at the bottom level
+//   quantum 1  the geometric mean of the two
+//   boost      the sum of the quanta, the time a job needs to sink through every level
+//
+// Quanta stay within [min_quantum, max_quantum], and start spread geometrically over
+// that range. Every configuration used is appended to the tuning log (a CSV file).
+#define ADAPTIVE_WINDOW_JOBS 32
+#define ADAPTIVE_LEVEL0_PERCENTILE 80.0
+#define ADAPTIVE_LONG_SLICES 8
+#define ADAPTIVE_LOG_HEADER "Time,Jobs,p50 Burst,p80 Burst,p99 Burst,Quantum 0,Quantum 1,Quantum 2,Boost\n"
+
+typedef struct {
+    MlfqPolicy mlfq;            // Runs on config, which is retuned in place
+    MlfqConfig config;
+    Histogram bursts;           // CPU time of the completed jobs, older ones fading out
+    uint64_t min_quantum_ns;
+    uint64_t max_quantum_ns;
+    uint64_t completed;
+    int window;                 // Completions since the last retune
+    FILE *log;
+} AdaptiveMlfqPolicy;
+
+uint64_t adaptive_clamp(AdaptiveMlfqPolicy *a, uint64_t quantum_ns) {
+    return quantum_ns < a->min_quantum_ns ? a->min_quantum_ns : quantum_ns > a->max_quantum_ns ? a->max_quantum_ns : quantum_ns;
+}
+
+// Function to compute floor(sqrt(a * b)) without overflow or libm
+uint64_t geometric_mean(uint64_t a, uint64_t b) {
+    unsigned __int128 product = (unsigned __int128)a * b;
+    uint64_t low = 0, high = a > b ? a : b;
+    while (low < high) {
+        uint64_t middle = low + (high - low + 1) / 2;
+        if ((unsigned __int128)middle * middle <= product) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return low;
+}
+
+// Function to append the configuration in use to the tuning log
+void adaptive_mlfq_log(AdaptiveMlfqPolicy *a, uint64_t now_ns) {
+    if (a->log == NULL) {
+        return;
+    }
+    bool seen = a->bursts.total > 0;
+    fprintf(a->log, "%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+            sched_elapsed_ms(now_ns), a->completed,
+            seen ? ns_to_ms(histogram_percentile(&a->bursts, 50.0)) : 0,
+            seen ? ns_to_ms(histogram_percentile(&a->bursts, ADAPTIVE_LEVEL0_PERCENTILE)) : 0,
+            seen ? ns_to_ms(histogram_percentile(&a->bursts, 99.0)) : 0,
+            ns_to_ms(a->config.quantum_ns[0]), ns_to_ms(a->config.quantum_ns[1]),
+            ns_to_ms(a->config.quantum_ns[2]), ns_to_ms(a->config.boost_ns));
+    fflush(a->log);
+}
+
+// Function to set the quanta from quantum 0 and 2 as described above
+void adaptive_mlfq_set(AdaptiveMlfqPolicy *a, uint64_t quantum0_ns, uint64_t quantum2_ns) {
+    MlfqConfig *c = &a->config;
+    c->quantum_ns[0] = adaptive_clamp(a, quantum0_ns);
+    c->quantum_ns[2] = adaptive_clamp(a, quantum2_ns > c->quantum_ns[0] ? quantum2_ns : c->quantum_ns[0]);
+    c->quantum_ns[1] = adaptive_clamp(a, geometric_mean(c->quantum_ns[0], c->quantum_ns[2]));
+    c->boost_ns = c->quantum_ns[0] + c->quantum_ns[1] + c->quantum_ns[2];
+}
+
+// Function to start an adaptive MLFQ; log_file may be NULL for no tuning log
+void adaptive_mlfq_init(AdaptiveMlfqPolicy *a, int min_quantum, int max_quantum, const char *log_file) {
+    memset(a, 0, sizeof(*a));
+    a->min_quantum_ns = ms_to_ns(min_quantum > 0 ? min_quantum : 1);
+    a->max_quantum_ns = ms_to_ns(max_quantum);
+    if (a->max_quantum_ns < a->min_quantum_ns) {
+        a->max_quantum_ns = a->min_quantum_ns;
+    }
+    a->config.levels = MLFQ_LEVELS;
+    adaptive_mlfq_set(a, a->min_quantum_ns, a->max_quantum_ns);
+    mlfq_init(&a->mlfq, &a->config);
+
+    if (log_file != NULL) {
+        a->log = fopen(log_file, "w");
+        if (a->log == NULL) {
+            perror("Error opening tuning log");
+        } else {
+            fputs(ADAPTIVE_LOG_HEADER, a->log);
+        }
+    }
+    adaptive_mlfq_log(a, sched_epoch_ns);
+}
+
+void adaptive_mlfq_free(AdaptiveMlfqPolicy *a) {
+    mlfq_free(&a->mlfq);
+    if (a->log != NULL) {
+        fclose(a->log);
+    }
+}
+
+// Function to record the burst of a completed job, retuning once a window is full
+void adaptive_mlfq_record(AdaptiveMlfqPolicy *a, Engine *e, int job) {
+    histogram_record(&a->bursts, e->jobs->processes[job].cpu_ns);
+    a->completed++;
+    if (++a->window < ADAPTIVE_WINDOW_JOBS) {
+        return;
+    }
+    a->window = 0;
+    adaptive_mlfq_set(a, histogram_percentile(&a->bursts, ADAPTIVE_LEVEL0_PERCENTILE) * 5 / 4,
+                      histogram_percentile(&a->bursts, 99.0) / ADAPTIVE_LONG_SLICES);
+    adaptive_mlfq_log(a, sched_now_ns());
+
+    // Halve the weight of what was seen so far, so the quanta follow a changing workload
+    a->bursts.total = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        a->bursts.counts[i] /= 2;
+        a->bursts.total += a->bursts.counts[i];
+    }
+}
+
+void adaptive_mlfq_finish(void *policy, Engine *e, int job) {
+    adaptive_mlfq_record((AdaptiveMlfqPolicy *)policy, e, job);
+}
+
+// The MLFQ steps work on the embedded MlfqPolicy, the first member
+static const PolicyOps adaptive_mlfq_ops = {
+    .admit = mlfq_admit, .pick = mlfq_pick, .requeue = mlfq_requeue, .finish = adaptive_mlfq_finish, .resume = mlfq_resume
+};
+
+// Offline adaptive MLFQ takes the job array and 4 arguments, online 2
+#define AdaptiveMultiLevelFeedbackQueue(...) \
+    BY_ARITY_4_OR_2(__VA_ARGS__, OfflineAdaptiveMultiLevelFeedbackQueue, _3, OnlineAdaptiveMultiLevelFeedbackQueue, _1)(__VA_ARGS__)
+
+// Min-heap of jobs on a 64-bit key, ties broken by insertion order (first come first
+// served). Array-based, push and pop are O(log n).
+typedef struct {
+    uint64_t key;
+    uint64_t order;
+    int job;
+} KeyHeapEntry;
+
+typedef struct {
+    KeyHeapEntry *entries;
+    int size;
+    int capacity;
+    uint64_t order;
+} KeyHeap;
+
+bool key_heap_before(KeyHeapEntry *a, KeyHeapEntry *b) {
+    if (a->key != b->key) {
+        return a->key < b->key;
+    }
+    return a->order < b->order;
+}
+
+void key_heap_push(KeyHeap *h, int job, uint64_t key) {
+    if (h->size == h->capacity) {
+        h->capacity = h->capacity ? h->capacity * 2 : 64;
+        h->entries = (KeyHeapEntry *)realloc(h->entries, h->capacity * sizeof(KeyHeapEntry));
+    }
+    KeyHeapEntry entry = {key, h->order++, job};
+    int i = h->size++;
+    while (i > 0 && key_heap_before(&entry, &h->entries[(i - 1) / 2])) {
+        h->entries[i] = h->entries[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    h->entries[i] = entry;
+}
+
+// Function to remove and return the job with the smallest key, -1 if the heap is empty
+int key_heap_pop(KeyHeap *h) {
+    if (h->size == 0) {
+        return -1;
+    }
+    int job = h->entries[0].job;
+    KeyHeapEntry last = h->entries[--h->size];
+    int i = 0;
+    while (true) {
+        int child = 2 * i + 1;
+        if (child >= h->size) {
+            break;
+        }
+        if (child + 1 < h->size && key_heap_before(&h->entries[child + 1], &h->entries[child])) {
+            child++;
+        }
+        if (!key_heap_before(&h->entries[child], &last)) {
+            break;
+        }
+        h->entries[i] = h->entries[child];
+        i = child;
+    }
+    h->entries[i] = last;
+    return job;
+}
+
+// Completely Fair Scheduler: every runnable job accrues virtual runtime, its measured CPU
+// time scaled by nice-0 weight / its weight, and the job with the least virtual runtime
+// runs next. The slice is the target latency split by weight over the runnable jobs, but
+// at least the minimum granularity; a target latency of 0 runs each pick to completion.
+// New jobs start at min_vruntime, the smallest virtual runtime of any runnable job (never
+// decreasing), so they neither starve the others nor get starved. Runnable jobs are kept
+// in a binary min-heap on (vruntime, admission order), picking and requeueing is O(log n).
+#define CFS_NICE_0_WEIGHT 1024
+
+// Weight of nice -20 .. 19, as in Linux: each nice step is about 10% of CPU time
+static const uint32_t cfs_nice_weights[40] = {
+    /* -20 */ 88761, 71755, 56483, 46273, 36291,
+    /* -15 */ 29154, 23254, 18705, 14949, 11916,
+    /* -10 */ 9548, 7620, 6100, 4904, 3906,
+    /*  -5 */ 3121, 2501, 1991, 1586, 1277,
+    /*   0 */ 1024, 820, 655, 526, 423,
+    /*   5 */ 335, 272, 215, 172, 137,
+    /*  10 */ 110, 87, 70, 56, 45,
+    /*  15 */ 36, 29, 23, 18, 15
+};
+
+uint32_t cfs_weight(int nice) {
+    if (nice < -20) nice = -20;
+    if (nice > 19) nice = 19;
+    return cfs_nice_weights[nice + 20];
+}
+
+typedef struct {
+    KeyHeap runnable;       // Keyed on vruntime
+    uint64_t *vruntime;     // Per job
+    int job_capacity;
+    uint64_t total_weight;  // Of every runnable job, including the running one
+    uint64_t min_vruntime;
+    uint64_t latency_ns;
+    uint64_t min_granularity_ns;
+    uint64_t picked_cpu_ns; // cpu_ns of the running job when it was picked
+} CfsPolicy;
+
+void cfs_init(CfsPolicy *c, int target_latency, int min_granularity) {
+    memset(c, 0, sizeof(*c));
+    c->latency_ns = target_latency > 0 ? ms_to_ns(target_latency) : UINT64_MAX;
+    c->min_granularity_ns = ms_to_ns(min_granularity);
+}
+
+void cfs_free(CfsPolicy *c) {
+    free(c->runnable.entries);
+    free(c->vruntime);
+}
+
+// Function to advance min_vruntime to the smallest runnable vruntime, running_job is -1 if it exited
+void cfs_update_min_vruntime(CfsPolicy *c, int running_job) {
+    uint64_t smallest = UINT64_MAX;
+    if (running_job != -1) {
+        smallest = c->vruntime[running_job];
+    }
+    if (c->runnable.size > 0 && c->runnable.entries[0].key < smallest) {
+        smallest = c->runnable.entries[0].key;
+    }
+    if (smallest != UINT64_MAX && smallest > c->min_vruntime) {
+        c->min_vruntime = smallest;
+    }
+}
+
+// Function to charge the slice the job just ran to its virtual runtime
+void cfs_account(CfsPolicy *c, Engine *e, int job) {
+    Process *p = &e->jobs->processes[job];
+    uint64_t ran_ns = p->cpu_ns - c->picked_cpu_ns;
+    c->vruntime[job] += ran_ns * CFS_NICE_0_WEIGHT / cfs_weight(p->nice);
+}
+
+void cfs_admit(void *policy, Engine *e, int job) {
+    CfsPolicy *c = (CfsPolicy *)policy;
+    if (job >= c->job_capacity) {
+        c->job_capacity = e->jobs->capacity > job ? e->jobs->capacity : job + 1;
+        c->vruntime = (uint64_t *)realloc(c->vruntime, c->job_capacity * sizeof(uint64_t));
+    }
+    c->vruntime[job] = c->min_vruntime;
+    c->total_weight += cfs_weight(e->jobs->processes[job].nice);
+    key_heap_push(&c->runnable, job, c->vruntime[job]);
+    live_set_queue_depth(0, c->runnable.size);
+}
+
+int cfs_pick(void *policy, Engine *e, uint64_t now_ns, int *level, uint64_t *quantum_ns) {
+    (void)now_ns;
+    CfsPolicy *c = (CfsPolicy *)policy;
+    int job = key_heap_pop(&c->runnable);
+    live_set_queue_depth(0, c->runnable.size);
+    if (job == -1) {
+        return -1;
+    }
+    Process *p = &e->jobs->processes[job];
+    c->picked_cpu_ns = p->cpu_ns;
+
+    // The job's share of the target latency, saturating like ms_to_ns
+    unsigned __int128 share = (unsigned __int128)c->latency_ns * cfs_weight(p->nice) / c->total_weight;
+    uint64_t slice = c->latency_ns == UINT64_MAX || share > UINT64_MAX ? UINT64_MAX : (uint64_t)share;
+    *level = -1;
+    *quantum_ns = slice > c->min_granularity_ns ? slice : c->min_granularity_ns;
+    return job;
+}
+
+void cfs_requeue(void *policy, Engine *e, int job, int level) {
+    (void)level;
+    CfsPolicy *c = (CfsPolicy *)policy;
+    cfs_account(c, e, job);
+    cfs_update_min_vruntime(c, job);
+    key_heap_push(&c->runnable, job, c->vruntime[job]);
+}
+
+void cfs_finish(void *policy, Engine *e, int job) {
+    CfsPolicy *c = (CfsPolicy *)policy;
+    cfs_account(c, e, job);
+    c->total_weight -= cfs_weight(e->jobs->processes[job].nice);
+    cfs_update_min_vruntime(c, -1);
+}
+
+static const PolicyOps cfs_ops = {
+    .admit = cfs_admit, .pick = cfs_pick, .requeue = cfs_requeue, .finish = cfs_finish
+};
+
+// Both schedulers expose a CompletelyFairScheduler(); the offline one is called as
+// (p, n, target_latency, min_granularity), the online one as (target_latency, min_granularity)
+#define BY_ARITY_4_OR_2(_1, _2, _3, _4, name, ...) name
+#define CompletelyFairScheduler(...) \
+    BY_ARITY_4_OR_2(__VA_ARGS__, OfflineCompletelyFairScheduler, _3, OnlineCompletelyFairScheduler, _1)(__VA_ARGS__)
+
+// Proportional share: a job's CPU time follows its tickets (Process.tickets, or
+// TICKETS=<n> in front of its command; STRIDE_DEFAULT_TICKETS without either).
+#define STRIDE_DEFAULT_TICKETS 100
+#define STRIDE_ONE (1ULL << 20)
+
+int job_tickets(Process *p) {
+    return p->tickets > 0 ? p->tickets : STRIDE_DEFAULT_TICKETS;
+}
+
+// Stride scheduling: every job has a pass value and the job with the smallest pass runs
+// next (a heap ordered on pass, O(log n)). Running advances the pass by the job's stride,
+// STRIDE_ONE / tickets, scaled by the fraction of the quantum it actually used, so a job
+// that blocks or exits early is not charged a whole quantum. A new job starts one stride
+// after the global pass, which advances by STRIDE_ONE / (all runnable tickets) per
+// quantum of CPU time. Each job's share of the CPU time then stays within one quantum
+// of the share its tickets entitle it to. Quantum 0 runs each job to completion, and
+// every slice is then charged as one whole quantum.
+typedef struct {
+    KeyHeap runnable;       // Keyed on pass
+    uint64_t *pass;         // Per job
+    int job_capacity;
+    uint64_t global_pass;
+    uint64_t total_tickets; // Of every runnable job, including the running one
+    uint64_t quantum_ns;
+    uint64_t picked_cpu_ns; // cpu_ns of the running job when it was picked
+} StridePolicy;
+
+void stride_init(StridePolicy *s, int quantum) {
+    memset(s, 0, sizeof(*s));
+    s->quantum_ns = quantum > 0 ? ms_to_ns(quantum) : UINT64_MAX;
+}
+
+void stride_free(StridePolicy *s) {
+    free(s->runnable.entries);
+    free(s->pass);
+}
+
+// Function to charge the running job and the global pass for the slice it just ran
+void stride_account(StridePolicy *s, Engine *e, int job) {
+    Process *p = &e->jobs->processes[job];
+    uint64_t used = s->quantum_ns == UINT64_MAX ? STRIDE_ONE
+                                                : (p->cpu_ns - s->picked_cpu_ns) * STRIDE_ONE / s->quantum_ns;
+    s->pass[job] += used / job_tickets(p);
+    s->global_pass += used / s->total_tickets;
+}
+
+void stride_admit(void *policy, Engine *e, int job) {
+    StridePolicy *s = (StridePolicy *)policy;
+    if (job >= s->job_capacity) {
+        s->job_capacity = e->jobs->capacity > job ? e->jobs->capacity : job + 1;
+        s->pass = (uint64_t *)realloc(s->pass, s->job_capacity * sizeof(uint64_t));
+    }
+    int tickets = job_tickets(&e->jobs->processes[job]);
+    s->pass[job] = s->global_pass + STRIDE_ONE / tickets;
+    s->total_tickets += tickets;
+    key_heap_push(&s->runnable, job, s->pass[job]);
+    live_set_queue_depth(0, s->runnable.size);
+}
+
+int stride_pick(void *policy, Engine *e, uint64_t now_ns, int *level, uint64_t *quantum_ns) {
+    (void)now_ns;
+    StridePolicy *s = (StridePolicy *)policy;
+    int job = key_heap_pop(&s->runnable);
+    live_set_queue_depth(0, s->runnable.size);
+    if (job != -1) {
+        s->picked_cpu_ns = e->jobs->processes[job].cpu_ns;
+    }
+    *level = -1;
+    *quantum_ns = s->quantum_ns;
+    return job;
+}
+
+void stride_requeue(void *policy, Engine *e, int job, int level) {
+    (void)level;
+    StridePolicy *s = (StridePolicy *)policy;
+    stride_account(s, e, job);
+    key_heap_push(&s->runnable, job, s->pass[job]);
+}
+
+void stride_finish(void *policy, Engine *e, int job) {
+    StridePolicy *s = (StridePolicy *)policy;
+    stride_account(s, e, job);
+    s->total_tickets -= job_tickets(&e->jobs->processes[job]);
+}
+
+static const PolicyOps stride_ops = {
+    .admit = stride_admit, .pick = stride_pick, .requeue = stride_requeue, .finish = stride_finish
+};
+
+// Lottery scheduling: every quantum a ticket is drawn at random among the runnable jobs'
+// tickets and its holder runs. Fair in expectation only; the draw uses a seeded PRNG so a
+// simulated run (and a replay of a trace) is reproducible. The tickets live in a Fenwick
+// tree indexed by job, so a draw and a ticket update are both O(log n). Quantum 0 runs
+// each drawn job to completion.
+typedef struct {
+    uint64_t *tree;         // Fenwick tree over the tickets each job holds in the draw
+    int size;               // A power of two
+    uint64_t total_tickets;
+    int runnable;           // Jobs in the draw
+    uint64_t quantum_ns;
+    uint64_t random_state;
+} LotteryPolicy;
+
+void lottery_init(LotteryPolicy *l, int quantum, uint64_t seed) {
+    memset(l, 0, sizeof(*l));
+    l->quantum_ns = quantum > 0 ? ms_to_ns(quantum) : UINT64_MAX;
+    l->random_state = seed ? seed : 0x9e3779b97f4a7c15ULL;
+}
+
+void lottery_free(LotteryPolicy *l) {
+    free(l->tree);
+}
+
+// xorshift64*
+uint64_t lottery_random(LotteryPolicy *l) {
+    l->random_state ^= l->random_state >> 12;
+    l->random_state ^= l->random_state << 25;
+    l->random_state ^= l->random_state >> 27;
+    return l->random_state * 2685821657736338717ULL;
+}
+
+// Function to add delta tickets to a job's holding (delta may be negative)
+void lottery_update(LotteryPolicy *l, int job, int64_t delta) {
+    if (job >= l->size) {
+        // Double the tree until the job fits; every old node keeps its range
+        int size = l->size ? l->size : 1024;
+        while (size <= job) {
+            size *= 2;
+        }
+        uint64_t *tree = (uint64_t *)calloc(size + 1, sizeof(uint64_t));
+        for (int i = 1; i <= l->size; i++) {
+            tree[i] = l->tree[i];
+        }
+        if (l->size > 0) {
+            // Of the new nodes only the powers of two cover old jobs: all of them
+            for (int node = l->size * 2; node <= size; node *= 2) {
+                tree[node] = l->total_tickets;
+            }
+        }
+        free(l->tree);
+        l->tree = tree;
+        l->size = size;
+    }
+    for (int i = job + 1; i <= l->size; i += i & -i) {
+        l->tree[i] += (uint64_t)delta;
+    }
+    l->total_tickets += (uint64_t)delta;
+}
+
+// Function to find the job holding ticket number `ticket` (0-based, below total_tickets)
+int lottery_find(LotteryPolicy *l, uint64_t ticket) {
+    int position = 0;
+    for (int step = l->size; step > 0; step /= 2) {
+        if (position + step <= l->size && l->tree[position + step] <= ticket) {
+            position += step;
+            ticket -= l->tree[position];
+        }
+    }
+    return position;    // Fenwick index position + 1 holds the ticket, i.e. job `position`
+}
+
+void lottery_admit(void *policy, Engine *e, int job) {
+    LotteryPolicy *l = (LotteryPolicy *)policy;
+    lottery_update(l, job, job_tickets(&e->jobs->processes[job]));
+    live_set_queue_depth(0, ++l->runnable);
+}
+
+int lottery_pick(void *policy, Engine *e, uint64_t now_ns, int *level, uint64_t *quantum_ns) {
+    (void)now_ns;
+    LotteryPolicy *l = (LotteryPolicy *)policy;
+    *level = -1;
+    *quantum_ns = l->quantum_ns;
+    if (l->total_tickets == 0) {
+        return -1;
+    }
+    int job = lottery_find(l, lottery_random(l) % l->total_tickets);
+    lottery_update(l, job, -(int64_t)job_tickets(&e->jobs->processes[job]));
+    live_set_queue_depth(0, --l->runnable);
+    return job;
+}
+
+void lottery_requeue(void *policy, Engine *e, int job, int level) {
+    (void)level;
+    LotteryPolicy *l = (LotteryPolicy *)policy;
+    lottery_update(l, job, job_tickets(&e->jobs->processes[job]));
+    l->runnable++;
+}
+
+static const PolicyOps lottery_ops = {
+    .admit = lottery_admit, .pick = lottery_pick, .requeue = lottery_requeue
+};
+
+// Offline (p, n, quantum[, seed]) and online (quantum[, seed]) variants, picked by argument count.
+// Without a seed the draw uses the default one (seed 0, see lottery_init).
+#define BY_ARITY_3_OR_1(_1, _2, _3, name, ...) name
+#define BY_ARITY_4_TO_1(_1, _2, _3, _4, name, ...) name
+#define StrideScheduling(...) \
+    BY_ARITY_3_OR_1(__VA_ARGS__, OfflineStrideScheduling, _2, OnlineStrideScheduling)(__VA_ARGS__)
+#define OfflineLotterySchedulingDefaultSeed(p, n, quantum) OfflineLotteryScheduling(p, n, quantum, 0)
+#define OnlineLotterySchedulingDefaultSeed(quantum) OnlineLotteryScheduling(quantum, 0)
+#define LotteryScheduling(...) \
+    BY_ARITY_4_TO_1(__VA_ARGS__, OfflineLotteryScheduling, OfflineLotterySchedulingDefaultSeed, \
+                    OnlineLotteryScheduling, OnlineLotterySchedulingDefaultSeed)(__VA_ARGS__)
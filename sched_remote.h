@@ -0,0 +1,578 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "sched_engine.h"
+#include "sched_history.h"
+
+// Coordinator/worker split: with SCHED_AGENTS=<address>[,<address>...] the scheduler
+// becomes a coordinator that keeps the policy and the accounting, and runs every slice on
+// one of the worker agents (tools/sched_agent.c) listening at those addresses, either
+// unix:<path> or tcp:<host>:<port>. An agent runs one slice at a time through the usual
+// run_slice(), so start one agent per CPU; several local agents on one machine are enough
+// to try it out. Simulations and the policies that keep state between a pick and its
+// requeue (see EngineConfig.distributable) always run locally.
+//
+// A new job goes to the idle agent with the least predicted work pinned on it: the
+// remaining bursts, from the command history, of the jobs it holds stopped between their
+// slices. A preempted job stays on its agent, and waits for it when picked while the
+// agent is busy. A lost agent fails its running and stopped jobs; the run carries on
+// with the others.
+//
+// Protocol: every message is a u16 length of the rest, a u8 type, then the fields, all
+// little-endian:
+//
+//   HELLO  agent -> coordinator   u32 magic, u16 version, u32 agent pid
+//   RUN    coordinator -> agent   u32 job, u8 flags, u64 quantum_ns (UINT64_MAX = until it
+//                                 exits), u16 length, command (the job's first slice only)
+//   DONE   agent -> coordinator   u32 job, u8 flags, u32 pid, u64 slice_ns, u64 user_ns,
+//                                 u64 system_ns (CPU time of the whole job, once it exited)
+
+#define REMOTE_MAGIC 0x41484353u     // "SCHA"
+#define REMOTE_VERSION 1
+#define REMOTE_MAX_AGENTS 64
+#define REMOTE_MAX_MESSAGE 512
+
+typedef enum {
+    REMOTE_HELLO = 1,
+    REMOTE_RUN,
+    REMOTE_DONE
+} RemoteMessageType;
+
+#define REMOTE_RUN_INHERIT_OUTPUT 1  // RUN flags
+#define REMOTE_DONE_EXITED 1         // DONE flags
+#define REMOTE_DONE_ERROR 2
+
+typedef struct {
+    uint8_t data[REMOTE_MAX_MESSAGE];
+    size_t length;
+    size_t position;        // Read position, past the end once a field was missing
+} RemoteMessage;
+
+void remote_begin(RemoteMessage *m, RemoteMessageType type) {
+    m->length = 0;
+    m->position = 0;
+    m->data[m->length++] = (uint8_t)type;
+}
+
+void remote_put(RemoteMessage *m, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes && m->length < REMOTE_MAX_MESSAGE; i++) {
+        m->data[m->length++] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+void remote_put_bytes(RemoteMessage *m, const void *data, size_t length) {
+    if (length > REMOTE_MAX_MESSAGE - m->length) {
+        length = REMOTE_MAX_MESSAGE - m->length;
+    }
+    memcpy(m->data + m->length, data, length);
+    m->length += length;
+}
+
+uint64_t remote_get(RemoteMessage *m, int bytes) {
+    uint64_t value = 0;
+    if (m->position + bytes > m->length) {
+        m->position = m->length + 1;
+        return 0;
+    }
+    for (int i = 0; i < bytes; i++) {
+        value |= (uint64_t)m->data[m->position++] << (8 * i);
+    }
+    return value;
+}
+
+// Function to tell whether every field read so far was present
+bool remote_complete(const RemoteMessage *m) {
+    return m->position <= m->length;
+}
+
+bool remote_write_all(int fd, const void *data, size_t length) {
+    const uint8_t *p = (const uint8_t *)data;
+    while (length > 0) {
+        ssize_t written = send(fd, p, length, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += written;
+        length -= written;
+    }
+    return true;
+}
+
+bool remote_read_all(int fd, void *data, size_t length) {
+    uint8_t *p = (uint8_t *)data;
+    while (length > 0) {
+        ssize_t got = read(fd, p, length);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        p += got;
+        length -= got;
+    }
+    return true;
+}
+
+bool remote_send(int fd, const RemoteMessage *m) {
+    uint8_t frame[2 + REMOTE_MAX_MESSAGE];
+    frame[0] = (uint8_t)m->length;
+    frame[1] = (uint8_t)(m->length >> 8);
+    memcpy(frame + 2, m->data, m->length);
+    return remote_write_all(fd, frame, 2 + m->length);
+}
+
+// Function to read the next message, false when the peer is gone or sent garbage
+bool remote_receive(int fd, RemoteMessage *m) {
+    uint8_t header[2];
+    if (!remote_read_all(fd, header, 2)) {
+        return false;
+    }
+    m->length = header[0] | (size_t)header[1] << 8;
+    m->position = 0;
+    if (m->length == 0 || m->length > REMOTE_MAX_MESSAGE) {
+        return false;
+    }
+    return remote_read_all(fd, m->data, m->length);
+}
+
+// Function to open a socket at an address, unix:<path> or tcp:<host>:<port> ("tcp:" may
+// be left out): a listening one for an agent, a connected one for the coordinator.
+// Returns the descriptor, -1 after printing the error.
+int remote_open(const char *address, bool listening) {
+    int fd = -1;
+    if (strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un un = {0};
+        un.sun_family = AF_UNIX;
+        if (strlen(address + 5) >= sizeof(un.sun_path)) {
+            fprintf(stderr, "Socket path too long: %s\n", address + 5);
+            return -1;
+        }
+        strcpy(un.sun_path, address + 5);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd == -1) {
+            perror("Error creating socket");
+            return -1;
+        }
+        if (listening) {
+            unlink(un.sun_path);
+        }
+        if (listening ? bind(fd, (struct sockaddr *)&un, sizeof(un)) != 0 || listen(fd, 16) != 0
+                      : connect(fd, (struct sockaddr *)&un, sizeof(un)) != 0) {
+            fprintf(stderr, "Error %s %s: %s\n", listening ? "listening on" : "connecting to", address, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    if (strncmp(address, "tcp:", 4) == 0) {
+        address += 4;
+    }
+    const char *colon = strrchr(address, ':');
+    if (colon == NULL) {
+        fprintf(stderr, "Agent address needs a port: %s\n", address);
+        return -1;
+    }
+    char host[256];
+    snprintf(host, sizeof(host), "%.*s", (int)(colon - address), address);
+    struct addrinfo hints = {0}, *addresses;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    int status = getaddrinfo(host[0] ? host : NULL, colon + 1, &hints, &addresses);
+    if (status != 0) {
+        fprintf(stderr, "Error resolving %s: %s\n", address, gai_strerror(status));
+        return -1;
+    }
+    for (struct addrinfo *a = addresses; a != NULL && fd == -1; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+        if (fd == -1) {
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (listening ? bind(fd, a->ai_addr, a->ai_addrlen) != 0 || listen(fd, 16) != 0
+                      : connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd == -1) {
+        fprintf(stderr, "Error %s %s: %s\n", listening ? "listening on" : "connecting to", address, strerror(errno));
+    } else {
+        // Every message is one small request or reply, send it right away
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    freeaddrinfo(addresses);
+    return fd;
+}
+
+// Coordinator side
+
+typedef struct {
+    char address[128];
+    int fd;                 // -1 once the agent is lost
+    pid_t pid;
+    int running;            // Job on the agent, -1 when idle
+    int level;
+    uint64_t quantum_ns;
+    uint64_t dispatched_ns;
+    Queue *waiting;         // Jobs stopped on the agent, picked while it was busy
+    uint64_t load_ns;       // Predicted remaining work of the jobs pinned on the agent
+    uint64_t slices;
+    uint64_t completed;
+    uint64_t busy_ns;
+} RemoteAgent;
+
+typedef struct {
+    int agent;              // Agent the job is pinned to, -1 before its first slice
+    uint64_t remaining_ns;  // Predicted, counted in the agent's load
+    int level;              // Of the pick, while the job waits for its agent
+    uint64_t quantum_ns;
+} RemoteJob;
+
+typedef struct {
+    RemoteAgent agents[REMOTE_MAX_AGENTS];
+    int count;
+    int live;
+    int idle;
+    RemoteJob *jobs;
+    int job_capacity;
+} RemotePool;
+
+// Function to tell whether runs go to worker agents
+bool remote_enabled() {
+    const char *agents = getenv("SCHED_AGENTS");
+    return agents != NULL && agents[0] != '\0' && !sched_simulated;
+}
+
+// Function to connect to every agent in SCHED_AGENTS, false if none could be reached
+bool remote_connect(RemotePool *pool) {
+    memset(pool, 0, sizeof(*pool));
+    char list[4096];
+    snprintf(list, sizeof(list), "%s", getenv("SCHED_AGENTS"));
+    char *saveptr;
+    for (char *address = strtok_r(list, ",", &saveptr); address != NULL; address = strtok_r(NULL, ",", &saveptr)) {
+        if (pool->count == REMOTE_MAX_AGENTS) {
+            fprintf(stderr, "Only the first %d agents are used\n", REMOTE_MAX_AGENTS);
+            break;
+        }
+        int fd = remote_open(address, false);
+        RemoteMessage hello;
+        if (fd == -1) {
+            continue;
+        }
+        if (!remote_receive(fd, &hello) || remote_get(&hello, 1) != REMOTE_HELLO ||
+            remote_get(&hello, 4) != REMOTE_MAGIC || remote_get(&hello, 2) != REMOTE_VERSION) {
+            fprintf(stderr, "%s is not a version %d scheduler agent\n", address, REMOTE_VERSION);
+            close(fd);
+            continue;
+        }
+        RemoteAgent *a = &pool->agents[pool->count++];
+        snprintf(a->address, sizeof(a->address), "%s", address);
+        a->fd = fd;
+        a->pid = (pid_t)remote_get(&hello, 4);
+        a->running = -1;
+        a->waiting = create_queue();
+    }
+    pool->live = pool->count;
+    pool->idle = pool->count;
+    return pool->count > 0;
+}
+
+void remote_disconnect(RemotePool *pool) {
+    for (int i = 0; i < pool->count; i++) {
+        if (pool->agents[i].fd != -1) {
+            close(pool->agents[i].fd);
+        }
+        free_queue(pool->agents[i].waiting);
+    }
+    free(pool->jobs);
+}
+
+void remote_grow_jobs(RemotePool *pool, int count) {
+    if (count <= pool->job_capacity) {
+        return;
+    }
+    int capacity = pool->job_capacity ? pool->job_capacity : 64;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+    pool->jobs = (RemoteJob *)realloc(pool->jobs, capacity * sizeof(RemoteJob));
+    for (int i = pool->job_capacity; i < capacity; i++) {
+        pool->jobs[i] = (RemoteJob){-1, 0, -1, UINT64_MAX};
+    }
+    pool->job_capacity = capacity;
+}
+
+// Function to choose the agent for a job's first slice: the idle one with the least
+// predicted work pinned on it, -1 when every agent is busy or lost
+int remote_choose_agent(RemotePool *pool) {
+    int chosen = -1;
+    for (int i = 0; i < pool->count; i++) {
+        RemoteAgent *a = &pool->agents[i];
+        if (a->fd != -1 && a->running == -1 && (chosen == -1 || a->load_ns < pool->agents[chosen].load_ns)) {
+            chosen = i;
+        }
+    }
+    return chosen;
+}
+
+// Function to settle the accounting of a slice that ran on (or was meant for) an agent
+void remote_finish_slice(RemotePool *pool, Engine *e, const PolicyOps *ops, void *policy,
+                         int job, int level, uint64_t quantum_ns, SliceResult r) {
+    RemoteJob *rj = &pool->jobs[job];
+    uint64_t used_ns = r.end_ns - r.start_ns;
+    if (used_ns > rj->remaining_ns || r.exited) {
+        used_ns = rj->remaining_ns;
+    }
+    rj->remaining_ns -= used_ns;
+    if (rj->agent != -1) {
+        pool->agents[rj->agent].load_ns -= used_ns;
+    }
+
+    engine_record_slice(e, job, level, quantum_ns, r);
+    if (!r.exited) {
+        ops->requeue(policy, e, job, level);
+        return;
+    }
+    engine_complete(e, job, r);
+    if (ops->finish != NULL) {
+        ops->finish(policy, e, job);
+    }
+}
+
+// Function to fail a job that cannot run anymore: its agent is lost
+void remote_fail_job(RemotePool *pool, Engine *e, const PolicyOps *ops, void *policy, int job, int level, uint64_t quantum_ns) {
+    uint64_t now_ns = sched_now_ns();
+    trace_slice(job, now_ns, now_ns, quantum_ns);
+    trace_exit(job, now_ns, 255, 0, 0);
+    remote_finish_slice(pool, e, ops, policy, job, level, quantum_ns, (SliceResult){now_ns, now_ns, true, true});
+}
+
+void remote_lose_agent(RemotePool *pool, Engine *e, const PolicyOps *ops, void *policy, int agent) {
+    RemoteAgent *a = &pool->agents[agent];
+    fprintf(stderr, "Lost agent %s, failing its jobs\n", a->address);
+    close(a->fd);
+    a->fd = -1;
+    pool->live--;
+    if (a->running == -1) {
+        pool->idle--;
+    } else {
+        int job = a->running;
+        a->running = -1;
+        remote_fail_job(pool, e, ops, policy, job, a->level, a->quantum_ns);
+    }
+    // The jobs stopped on it are failed as they come up: the waiting ones now, the
+    // others once the policy picks them again
+    while (a->waiting->front != NULL) {
+        int job = dequeue(a->waiting);
+        remote_fail_job(pool, e, ops, policy, job, pool->jobs[job].level, pool->jobs[job].quantum_ns);
+    }
+}
+
+// Function to send a job's next slice to its agent
+void remote_dispatch(RemotePool *pool, Engine *e, const PolicyOps *ops, void *policy,
+                     int agent, int job, int level, uint64_t quantum_ns) {
+    RemoteAgent *a = &pool->agents[agent];
+    Process *p = &e->jobs->processes[job];
+    RemoteJob *rj = &pool->jobs[job];
+    if (rj->agent == -1) {
+        rj->agent = agent;
+        rj->remaining_ns = ms_to_ns(get_historical_burst_time(&historical_data, read_job_options(p)));
+        a->load_ns += rj->remaining_ns;
+    }
+
+    RemoteMessage m;
+    remote_begin(&m, REMOTE_RUN);
+    remote_put(&m, job, 4);
+    remote_put(&m, job_output_mode == JOB_OUTPUT_INHERIT ? REMOTE_RUN_INHERIT_OUTPUT : 0, 1);
+    remote_put(&m, quantum_ns, 8);
+    size_t length = p->process_id == -1 ? strlen(p->command) : 0;
+    remote_put(&m, length, 2);
+    remote_put_bytes(&m, p->command, length);
+
+    a->running = job;
+    a->level = level;
+    a->quantum_ns = quantum_ns;
+    a->dispatched_ns = sched_now_ns();
+    pool->idle--;
+    live_slice_begin(job, level, p->command);
+    if (!remote_send(a->fd, &m)) {
+        remote_lose_agent(pool, e, ops, policy, agent);
+    }
+}
+
+// Function to take in one DONE message from an agent
+void remote_receive_done(RemotePool *pool, Engine *e, const PolicyOps *ops, void *policy, int agent) {
+    RemoteAgent *a = &pool->agents[agent];
+    RemoteMessage m;
+    if (!remote_receive(a->fd, &m) || remote_get(&m, 1) != REMOTE_DONE) {
+        remote_lose_agent(pool, e, ops, policy, agent);
+        return;
+    }
+    int job = (int)remote_get(&m, 4);
+    int flags = (int)remote_get(&m, 1);
+    pid_t pid = (pid_t)remote_get(&m, 4);
+    uint64_t slice_ns = remote_get(&m, 8);
+    uint64_t user_ns = remote_get(&m, 8);
+    uint64_t system_ns = remote_get(&m, 8);
+    if (!remote_complete(&m) || job != a->running) {
+        remote_lose_agent(pool, e, ops, policy, agent);
+        return;
+    }
+
+    // The agent timed the slice; it ended when the reply arrived
+    uint64_t now_ns = sched_now_ns();
+    if (slice_ns > now_ns - a->dispatched_ns) {
+        slice_ns = now_ns - a->dispatched_ns;
+    }
+    SliceResult r = {now_ns - slice_ns, now_ns, (flags & REMOTE_DONE_EXITED) != 0, (flags & REMOTE_DONE_ERROR) != 0};
+    Process *p = &e->jobs->processes[job];
+    if (p->process_id == -1) {
+        p->process_id = pid;
+        trace_spawn(job, r.start_ns, pid);
+    }
+    trace_slice(job, r.start_ns, r.end_ns, a->quantum_ns);
+    if (r.exited) {
+        trace_exit(job, r.end_ns, r.error ? 1 : 0, user_ns, system_ns);
+        a->completed++;
+    }
+    a->running = -1;
+    a->slices++;
+    a->busy_ns += slice_ns;
+    pool->idle++;
+    remote_finish_slice(pool, e, ops, policy, job, a->level, a->quantum_ns, r);
+}
+
+// Function to wait for the busy agents' replies, and for submissions when online
+void remote_wait(RemotePool *pool, Engine *e, const PolicyOps *ops, void *policy, bool online) {
+    struct pollfd fds[REMOTE_MAX_AGENTS + 1];
+    int agents[REMOTE_MAX_AGENTS];
+    int count = 0;
+    for (int i = 0; i < pool->count; i++) {
+        if (pool->agents[i].fd != -1 && pool->agents[i].running != -1) {
+            fds[count] = (struct pollfd){pool->agents[i].fd, POLLIN, 0};
+            agents[count++] = i;
+        }
+    }
+    int total = count;
+    if (online && !submissions_exhausted()) {
+        fds[total++] = (struct pollfd){STDIN_FILENO, POLLIN, 0};
+    }
+    if (poll(fds, total, online ? 10 : -1) <= 0) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        if (fds[i].revents != 0) {
+            remote_receive_done(pool, e, ops, policy, agents[i]);
+        }
+    }
+}
+
+void remote_print_summary(RemotePool *pool, FILE *fp) {
+    uint64_t elapsed_ns = sched_now_ns() - sched_epoch_ns;
+    fprintf(fp, "Agents\n");
+    fprintf(fp, "%-32s %8s %8s %8s %10s %6s\n", "agent", "pid", "slices", "jobs", "busy ms", "busy");
+    for (int i = 0; i < pool->count; i++) {
+        RemoteAgent *a = &pool->agents[i];
+        fprintf(fp, "%-32s %8d %8lu %8lu %10.0f %5.1f%%%s\n", a->address, (int)a->pid, a->slices, a->completed,
+                (double)a->busy_ns / NS_PER_MS, elapsed_ns ? 100.0 * a->busy_ns / elapsed_ns : 0.0,
+                a->fd == -1 ? " (lost)" : "");
+    }
+}
+
+// Function to run a scheduler with its slices on the worker agents, like run_engine() does
+// locally. False, before the run starts, when no agent could be reached.
+bool run_engine_remote(Engine *e, const PolicyOps *ops, void *policy) {
+    const bool online = e->config->online;
+    RemotePool pool;
+    if (!remote_connect(&pool)) {
+        fprintf(stderr, "No scheduler agent reachable, running locally\n");
+        remote_disconnect(&pool);
+        return false;
+    }
+    if (!engine_begin_run(e)) {
+        remote_disconnect(&pool);
+        return true;
+    }
+
+    if (!online) {
+        engine_submit_all(e);
+        for (int i = 0; i < e->jobs->count; i++) {
+            ops->admit(policy, e, i);
+        }
+    }
+
+    while (true) {
+        if (online) {
+            engine_poll_submissions(e, ops, policy);
+        }
+        remote_grow_jobs(&pool, e->jobs->count);
+
+        // Jobs that waited for their agent go first once it is free
+        for (int i = 0; i < pool.count; i++) {
+            RemoteAgent *a = &pool.agents[i];
+            if (a->fd != -1 && a->running == -1 && a->waiting->front != NULL) {
+                int job = dequeue(a->waiting);
+                remote_dispatch(&pool, e, ops, policy, i, job, pool.jobs[job].level, pool.jobs[job].quantum_ns);
+            }
+        }
+
+        // Then a pick for every idle agent (and every pick fails once all agents are lost)
+        while (pool.idle > 0 || pool.live == 0) {
+            int level = -1;
+            uint64_t quantum_ns = UINT64_MAX;
+            int job = ops->pick(policy, e, sched_now_ns(), &level, &quantum_ns);
+            if (job == -1) {
+                break;
+            }
+            int agent = pool.jobs[job].agent;
+            if (agent == -1) {
+                agent = remote_choose_agent(&pool);
+            }
+            if (agent == -1 || pool.agents[agent].fd == -1) {
+                remote_fail_job(&pool, e, ops, policy, job, level, quantum_ns);
+            } else if (pool.agents[agent].running != -1) {
+                pool.jobs[job].level = level;
+                pool.jobs[job].quantum_ns = quantum_ns;
+                enqueue(pool.agents[agent].waiting, job);
+            } else {
+                remote_dispatch(&pool, e, ops, policy, agent, job, level, quantum_ns);
+            }
+        }
+
+        if (pool.idle == pool.live) {
+            // Nothing running and nothing runnable: every admitted job is done
+            if (!online || submissions_exhausted()) {
+                break;
+            }
+            engine_idle();
+            continue;
+        }
+        remote_wait(&pool, e, ops, policy, online);
+    }
+
+    engine_end_run(e);
+    remote_print_summary(&pool, stderr);
+    remote_disconnect(&pool);
+    return true;
+}
@@ -0,0 +1,432 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "sched_uring.h"
+#include "sched_jitter.h"
+
+#define SINK_WRITE_DELAY_MS 10
+
+// Asynchronous file output. The scheduler (the only producer) copies bytes into a
+// preallocated ring and returns; a writer thread (the only consumer) writes them to the
+// file in batches. The ring positions are lock-free atomics; the mutex and condition
+// variables are only used to put the writer to sleep and wake it up, so the scheduler
+// waits on the disk only in sink_flush() or when it is a whole ring ahead of it.
+//
+// The durability policy decides how soon the bytes reach the disk:
+//   DURABILITY_BATCH  written once batch_bytes are pending and on flush
+//   DURABILITY_WRITE  also written at most SINK_WRITE_DELAY_MS after being handed over,
+//                     so a scheduler crash loses at most that window
+//   DURABILITY_FSYNC  as WRITE, and fdatasync'd after every batch; survives a power loss
+// Under load many records share one write (and one fdatasync), like a group commit.
+// Results use SCHED_RESULT_DURABILITY=batch|write|fsync (default write).
+//
+// With the io_uring backend (SCHED_URING, see sched_uring.h) a sink has no writer thread:
+// the scheduler queues the writes (and fdatasyncs) of its ring on the dispatcher's
+// io_uring, one at a time, and they are submitted with the dispatcher's next wait, at
+// the latest when the next slice starts, so WRITE durability holds without a timer.
+
+typedef enum {
+    DURABILITY_BATCH,
+    DURABILITY_WRITE,
+    DURABILITY_FSYNC
+} SinkDurability;
+
+typedef struct {
+    int fd;                     // -1 while closed
+    uint8_t *ring;
+    size_t ring_size;
+    size_t batch_bytes;         // Pending bytes that make a batch worth waking the writer for
+    SinkDurability durability;
+    _Atomic uint64_t head;      // Bytes on disk (written, and synced for DURABILITY_FSYNC)
+    _Atomic uint64_t tail;      // Bytes handed over by the producer
+    _Atomic bool idle;          // The writer is waiting for work
+
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t drained;     // Broadcast after every writer pass
+    bool flush_requested;
+    bool stopping;
+
+    bool on_ring;               // Written through the dispatcher's io_uring instead of the thread
+    UringRequest write_request;
+    UringRequest sync_request;
+    uint64_t written;           // on_ring: bytes written, ahead of head until synced (DURABILITY_FSYNC)
+} AsyncSink;
+
+bool sink_has_batch(AsyncSink *s) {
+    return atomic_load(&s->tail) - atomic_load(&s->head) >= s->batch_bytes;
+}
+
+// Function to write everything handed over so far (writer thread only)
+void sink_drain(AsyncSink *s) {
+    uint64_t head = atomic_load_explicit(&s->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&s->tail, memory_order_acquire);
+    if (head == tail) {
+        return;
+    }
+    while (head < tail) {
+        size_t offset = head % s->ring_size;
+        size_t length = tail - head < s->ring_size - offset ? tail - head : s->ring_size - offset;
+        ssize_t written = write(s->fd, s->ring + offset, length);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0) {
+            // Drop what cannot be written rather than stalling the scheduler forever
+            perror("Error writing output file");
+            written = (ssize_t)(tail - head);
+        }
+        head += written;
+    }
+    if (s->durability == DURABILITY_FSYNC && fdatasync(s->fd) != 0) {
+        perror("Error syncing output file");
+    }
+    atomic_store_explicit(&s->head, head, memory_order_release);
+}
+
+void *sink_writer(void *arg) {
+    AsyncSink *s = (AsyncSink *)arg;
+    low_jitter_leave();
+    pthread_mutex_lock(&s->lock);
+    while (true) {
+        // idle is published before re-checking for work, the producer stores tail before
+        // reading idle, so one of the two always sees the other
+        atomic_store(&s->idle, true);
+        bool timed = false;
+        struct timespec deadline;
+        while (!s->flush_requested && !s->stopping && !sink_has_batch(s)) {
+            bool pending = atomic_load(&s->tail) != atomic_load(&s->head);
+            if (!pending || s->durability == DURABILITY_BATCH) {
+                pthread_cond_wait(&s->wake, &s->lock);
+                continue;
+            }
+            if (!timed) {
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_nsec += SINK_WRITE_DELAY_MS * 1000000L;
+                deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+                deadline.tv_nsec %= 1000000000L;
+                timed = true;
+            }
+            if (pthread_cond_timedwait(&s->wake, &s->lock, &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+        atomic_store(&s->idle, false);
+        bool stopping = s->stopping;
+        s->flush_requested = false;
+        pthread_mutex_unlock(&s->lock);
+
+        sink_drain(s);
+
+        pthread_mutex_lock(&s->lock);
+        pthread_cond_broadcast(&s->drained);
+        if (stopping) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+#define SINK_OF(request, field) ((AsyncSink *)((char *)(request) - offsetof(AsyncSink, field)))
+
+void sink_ring_written(UringRequest *request);
+void sink_ring_synced(UringRequest *request);
+
+// Function to queue the write of what is pending (on_ring), unless a write or sync is in
+// flight; its completion queues the next. A batch sink waits for a batch unless all is set.
+void sink_ring_issue(AsyncSink *s, bool all) {
+    uint64_t head = atomic_load(&s->head);
+    uint64_t tail = atomic_load(&s->tail);
+    if (s->write_request.pending || s->sync_request.pending || head == tail ||
+        (!all && s->durability == DURABILITY_BATCH && !sink_has_batch(s))) {
+        return;
+    }
+    size_t offset = head % s->ring_size;
+    size_t length = tail - head < s->ring_size - offset ? tail - head : s->ring_size - offset;
+    s->write_request.complete = sink_ring_written;
+    struct io_uring_sqe *sqe = uring_queue(&sched_uring, &s->write_request);
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = s->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(s->ring + offset);
+    sqe->len = (unsigned)length;
+    sqe->off = head;    // The file holds exactly the bytes handed over since it was opened
+}
+
+void sink_ring_written(UringRequest *request) {
+    AsyncSink *s = SINK_OF(request, write_request);
+    if (request->result == -EINTR || request->result == -EAGAIN) {
+        sink_ring_issue(s, true);
+        return;
+    }
+    if (request->result <= 0) {
+        // Drop what cannot be written rather than stalling the scheduler forever
+        fprintf(stderr, "Error writing output file: %s\n", strerror(request->result ? -request->result : EIO));
+        s->written = atomic_load(&s->tail);
+    } else {
+        s->written = atomic_load(&s->head) + request->result;
+    }
+    if (s->durability == DURABILITY_FSYNC) {
+        s->sync_request.complete = sink_ring_synced;
+        struct io_uring_sqe *sqe = uring_queue(&sched_uring, &s->sync_request);
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fd = s->fd;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        return;
+    }
+    atomic_store(&s->head, s->written);
+    sink_ring_issue(s, false);
+}
+
+void sink_ring_synced(UringRequest *request) {
+    AsyncSink *s = SINK_OF(request, sync_request);
+    if (request->result < 0) {
+        fprintf(stderr, "Error syncing output file: %s\n", strerror(-request->result));
+    }
+    atomic_store(&s->head, s->written);
+    sink_ring_issue(s, false);
+}
+
+// Function to wait on the ring until head passes position (on_ring)
+void sink_ring_wait(AsyncSink *s, uint64_t position) {
+    while (atomic_load(&s->head) < position) {
+        sink_ring_issue(s, true);
+        uring_enter(&sched_uring, 1, 0);
+    }
+}
+
+// Function to create (truncate) path and start its writer thread, or put it on the
+// dispatcher's io_uring when that is in use
+bool sink_open(AsyncSink *s, const char *path, size_t ring_size, size_t batch_bytes, SinkDurability durability) {
+    s->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (s->fd == -1) {
+        perror("Error opening output file");
+        return false;
+    }
+    s->ring = (uint8_t *)malloc(ring_size);
+    s->ring_size = ring_size;
+    s->batch_bytes = batch_bytes > 0 ? batch_bytes : 1;
+    s->durability = durability;
+    atomic_store(&s->head, 0);
+    atomic_store(&s->tail, 0);
+    atomic_store(&s->idle, false);
+    s->flush_requested = false;
+    s->stopping = false;
+    s->on_ring = uring_enabled();
+    s->write_request.pending = false;
+    s->sync_request.pending = false;
+    s->written = 0;
+    if (s->on_ring) {
+        if (s->ring == NULL) {
+            fprintf(stderr, "Error allocating the ring for %s\n", path);
+            close(s->fd);
+            s->fd = -1;
+            return false;
+        }
+        return true;
+    }
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->wake, NULL);
+    pthread_cond_init(&s->drained, NULL);
+
+    if (s->ring == NULL || pthread_create(&s->writer, NULL, sink_writer, s) != 0) {
+        fprintf(stderr, "Error starting the writer thread for %s\n", path);
+        free(s->ring);
+        close(s->fd);
+        s->fd = -1;
+        return false;
+    }
+    return true;
+}
+
+void sink_wake(AsyncSink *s) {
+    pthread_mutex_lock(&s->lock);
+    pthread_cond_signal(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+}
+
+// Function to hand bytes to the writer
+void sink_write(AsyncSink *s, const void *data, size_t length) {
+    if (s->fd == -1) {
+        return;
+    }
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint64_t tail = atomic_load_explicit(&s->tail, memory_order_relaxed);
+    bool was_empty = tail == atomic_load(&s->head);
+
+    while (length > 0) {
+        uint64_t free_bytes = s->ring_size - (tail - atomic_load_explicit(&s->head, memory_order_acquire));
+        if (free_bytes == 0 && s->on_ring) {
+            sink_ring_wait(s, tail - s->ring_size + 1);
+            continue;
+        }
+        if (free_bytes == 0) {
+            // A full ring, the disk is a whole ring behind
+            pthread_mutex_lock(&s->lock);
+            s->flush_requested = true;
+            pthread_cond_signal(&s->wake);
+            while (tail == atomic_load(&s->head) + s->ring_size) {
+                pthread_cond_wait(&s->drained, &s->lock);
+            }
+            pthread_mutex_unlock(&s->lock);
+            continue;
+        }
+
+        size_t offset = tail % s->ring_size;
+        size_t chunk = length < free_bytes ? length : free_bytes;
+        if (chunk > s->ring_size - offset) {
+            chunk = s->ring_size - offset;
+        }
+        memcpy(s->ring + offset, bytes, chunk);
+        bytes += chunk;
+        length -= chunk;
+        tail += chunk;
+        atomic_store(&s->tail, tail);
+    }
+
+    if (s->on_ring) {
+        sink_ring_issue(s, false);
+        return;
+    }
+    // An idle writer is woken for a full batch, or to start the write delay of a new one
+    if (atomic_load(&s->idle) && (sink_has_batch(s) || (was_empty && s->durability != DURABILITY_BATCH))) {
+        sink_wake(s);
+    }
+}
+
+// Function to format into the sink like fprintf
+void sink_printf(AsyncSink *s, const char *format, ...) {
+    char buffer[1024];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0) {
+        return;
+    }
+    if ((size_t)length < sizeof(buffer)) {
+        sink_write(s, buffer, length);
+        return;
+    }
+
+    char *large = (char *)malloc(length + 1);
+    va_start(args, format);
+    vsnprintf(large, length + 1, format, args);
+    va_end(args);
+    sink_write(s, large, length);
+    free(large);
+}
+
+// Function to wait until everything handed over so far is written (and synced, per policy)
+void sink_flush(AsyncSink *s) {
+    if (s->fd == -1) {
+        return;
+    }
+    if (s->on_ring) {
+        sink_ring_wait(s, atomic_load(&s->tail));
+        return;
+    }
+    pthread_mutex_lock(&s->lock);
+    s->flush_requested = true;
+    pthread_cond_signal(&s->wake);
+    while (atomic_load(&s->head) != atomic_load(&s->tail)) {
+        pthread_cond_wait(&s->drained, &s->lock);
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+// Function to write everything, stop the writer and close the file
+void sink_close(AsyncSink *s) {
+    if (s->fd == -1) {
+        return;
+    }
+    if (s->on_ring) {
+        sink_ring_wait(s, atomic_load(&s->tail));
+        close(s->fd);
+        free(s->ring);
+        s->fd = -1;
+        return;
+    }
+    pthread_mutex_lock(&s->lock);
+    s->stopping = true;
+    pthread_cond_signal(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->writer, NULL);
+    close(s->fd);
+    free(s->ring);
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->wake);
+    pthread_cond_destroy(&s->drained);
+    s->fd = -1;
+}
+
+// Function to read SCHED_RESULT_DURABILITY
+SinkDurability result_durability() {
+    const char *policy = getenv("SCHED_RESULT_DURABILITY");
+    if (policy == NULL || policy[0] == '\0' || strcmp(policy, "write") == 0) {
+        return DURABILITY_WRITE;
+    }
+    if (strcmp(policy, "batch") == 0) {
+        return DURABILITY_BATCH;
+    }
+    if (strcmp(policy, "fsync") == 0) {
+        return DURABILITY_FSYNC;
+    }
+    fprintf(stderr, "Unknown SCHED_RESULT_DURABILITY %s, using write\n", policy);
+    return DURABILITY_WRITE;
+}
+
+// Which result files the schedulers write, SCHED_RESULT_FORMAT=csv|columnar|both (default csv)
+#define RESULT_FORMAT_CSV 1
+#define RESULT_FORMAT_COLUMNAR 2
+
+int result_formats() {
+    const char *format = getenv("SCHED_RESULT_FORMAT");
+    if (format == NULL || format[0] == '\0' || strcmp(format, "csv") == 0) {
+        return RESULT_FORMAT_CSV;
+    }
+    if (strcmp(format, "columnar") == 0) {
+        return RESULT_FORMAT_COLUMNAR;
+    }
+    if (strcmp(format, "both") == 0) {
+        return RESULT_FORMAT_CSV | RESULT_FORMAT_COLUMNAR;
+    }
+    fprintf(stderr, "Unknown SCHED_RESULT_FORMAT %s, using csv\n", format);
+    return RESULT_FORMAT_CSV;
+}
+
+// Result rows of the running scheduler, in completion order
+#define RESULT_RING_SIZE (1 << 20)
+#define RESULT_BATCH_BYTES (64 << 10)
+
+AsyncSink result_sink = {.fd = -1};
+
+// Function to open a scheduler's result CSV and write its header line.
+// Without the CSV format the sink stays closed and rows written to it are dropped.
+bool open_result_sink(const char *filename, const char *header) {
+    if (!(result_formats() & RESULT_FORMAT_CSV)) {
+        return true;
+    }
+    if (!sink_open(&result_sink, filename, RESULT_RING_SIZE, RESULT_BATCH_BYTES, result_durability())) {
+        return false;
+    }
+    sink_write(&result_sink, header, strlen(header));
+    return true;
+}
+
+void close_result_sink() {
+    sink_close(&result_sink);
+}
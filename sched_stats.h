@@ -0,0 +1,223 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "sched_clock.h"
+
+// Streaming latency histograms, kept while a scheduler runs and summarised (p50, p90,
+// p99, p99.9) on stderr when it finishes.
+//
+// Histograms are log-linear like HdrHistogram: values below 2^HIST_SUB_BITS ns get a
+// bucket each, above that every power of two is split into 2^(HIST_SUB_BITS - 1)
+// buckets, so a reported percentile is within 1/64 (~1.6%) of the true value. Values
+// are clamped at 2^HIST_MAX_EXPONENT ns (~4.9 hours). Recording is a handful of integer
+// operations and memory never grows with the number of jobs: each metric is kept for
+// all jobs, per MLFQ level and for at most STATS_MAX_FINGERPRINTS command fingerprints
+// (a command with every number replaced by '#', e.g. "sleep #"), the rest share one group.
+
+#define HIST_SUB_BITS 7
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_HALF_COUNT (HIST_SUB_COUNT / 2)
+#define HIST_MAX_EXPONENT 44
+#define HIST_BUCKETS (HIST_SUB_COUNT + (HIST_MAX_EXPONENT - HIST_SUB_BITS) * HIST_HALF_COUNT)
+
+#define STATS_MAX_LEVELS 8
+#define STATS_MAX_FINGERPRINTS 32
+#define STATS_FINGERPRINT_LENGTH 48
+
+typedef enum {
+    STAT_TURNAROUND,
+    STAT_WAITING,
+    STAT_RESPONSE,
+    STAT_SLICE,
+    STAT_OVERSHOOT,
+    STAT_METRICS
+} StatMetric;
+
+static const char *stat_metric_names[] = {"turnaround", "waiting", "response", "slice", "overshoot"};
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+} Histogram;
+
+typedef struct {
+    char name[STATS_FINGERPRINT_LENGTH + 8];
+    uint64_t hash;
+    Histogram *metrics[STAT_METRICS];   // Allocated on first use
+} StatsGroup;
+
+// Group 0 holds every job, then one group per level, then the fingerprints, then "other"
+#define STATS_LEVEL_GROUP(level) (1 + (level))
+#define STATS_FIRST_FINGERPRINT (1 + STATS_MAX_LEVELS)
+#define STATS_OTHER_GROUP (STATS_FIRST_FINGERPRINT + STATS_MAX_FINGERPRINTS)
+#define STATS_GROUPS (STATS_OTHER_GROUP + 1)
+
+typedef struct {
+    const char *policy;
+    bool has_levels;
+    int fingerprints;
+    StatsGroup groups[STATS_GROUPS];
+} SchedStats;
+
+SchedStats sched_stats = {0};
+
+int histogram_index(uint64_t value) {
+    if (value < HIST_SUB_COUNT) {
+        return (int)value;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    if (exponent >= HIST_MAX_EXPONENT) {
+        return HIST_BUCKETS - 1;
+    }
+    int shift = exponent - (HIST_SUB_BITS - 1);
+    return HIST_SUB_COUNT + (shift - 1) * HIST_HALF_COUNT + (int)(value >> shift) - HIST_HALF_COUNT;
+}
+
+// Function to get the midpoint of the values that land in a bucket
+uint64_t histogram_value(int index) {
+    if (index < HIST_SUB_COUNT) {
+        return (uint64_t)index;
+    }
+    int shift = (index - HIST_SUB_COUNT) / HIST_HALF_COUNT + 1;
+    uint64_t top = (uint64_t)((index - HIST_SUB_COUNT) % HIST_HALF_COUNT + HIST_HALF_COUNT);
+    return (top << shift) + ((1ULL << shift) >> 1);
+}
+
+void histogram_record(Histogram *h, uint64_t value) {
+    h->counts[histogram_index(value)]++;
+    h->total++;
+    if (value > h->max) {
+        h->max = value;
+    }
+}
+
+uint64_t histogram_percentile(Histogram *h, double percentile) {
+    uint64_t rank = (uint64_t)(percentile / 100.0 * h->total);
+    if (rank >= h->total) {
+        rank = h->total - 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen > rank) {
+            uint64_t value = histogram_value(i);
+            return value < h->max ? value : h->max;
+        }
+    }
+    return h->max;
+}
+
+// Function to derive a command fingerprint: runs of digits (with their decimal points) become '#'
+void command_fingerprint(const char *command, char *fingerprint) {
+    int length = 0;
+    for (const char *c = command; *c && length < STATS_FINGERPRINT_LENGTH - 1; c++) {
+        if (*c >= '0' && *c <= '9') {
+            while ((c[1] >= '0' && c[1] <= '9') || (c[1] == '.' && c[2] >= '0' && c[2] <= '9')) c++;
+            fingerprint[length++] = '#';
+        } else {
+            fingerprint[length++] = *c;
+        }
+    }
+    fingerprint[length] = '\0';
+}
+
+int stats_fingerprint_group(const char *command) {
+    char fingerprint[STATS_FINGERPRINT_LENGTH];
+    command_fingerprint(command, fingerprint);
+    uint64_t h = 1469598103934665603ULL;  // FNV-1a
+    for (const unsigned char *c = (const unsigned char *)fingerprint; *c; c++) {
+        h = (h ^ *c) * 1099511628211ULL;
+    }
+
+    for (int i = 0; i < sched_stats.fingerprints; i++) {
+        StatsGroup *g = &sched_stats.groups[STATS_FIRST_FINGERPRINT + i];
+        if (g->hash == h && strcmp(g->name, fingerprint) == 0) {
+            return STATS_FIRST_FINGERPRINT + i;
+        }
+    }
+    if (sched_stats.fingerprints == STATS_MAX_FINGERPRINTS) {
+        return STATS_OTHER_GROUP;
+    }
+    StatsGroup *g = &sched_stats.groups[STATS_FIRST_FINGERPRINT + sched_stats.fingerprints];
+    strcpy(g->name, fingerprint);
+    g->hash = h;
+    return STATS_FIRST_FINGERPRINT + sched_stats.fingerprints++;
+}
+
+void stats_group_record(int group, StatMetric metric, uint64_t value) {
+    StatsGroup *g = &sched_stats.groups[group];
+    if (g->metrics[metric] == NULL) {
+        g->metrics[metric] = (Histogram *)calloc(1, sizeof(Histogram));
+    }
+    histogram_record(g->metrics[metric], value);
+}
+
+void stats_record(int level, int fingerprint_group, StatMetric metric, uint64_t value) {
+    stats_group_record(0, metric, value);
+    if (sched_stats.has_levels && level >= 0 && level < STATS_MAX_LEVELS) {
+        stats_group_record(STATS_LEVEL_GROUP(level), metric, value);
+    }
+    stats_group_record(fingerprint_group, metric, value);
+}
+
+// Function to start collecting for a scheduler run; levels are reported only for MLFQ-like policies
+void stats_begin_run(const char *policy, bool has_levels) {
+    for (int g = 0; g < STATS_GROUPS; g++) {
+        for (int m = 0; m < STAT_METRICS; m++) {
+            free(sched_stats.groups[g].metrics[m]);
+        }
+    }
+    memset(&sched_stats, 0, sizeof(sched_stats));
+    sched_stats.policy = policy;
+    sched_stats.has_levels = has_levels;
+    strcpy(sched_stats.groups[0].name, "all");
+    for (int level = 0; level < STATS_MAX_LEVELS; level++) {
+        snprintf(sched_stats.groups[STATS_LEVEL_GROUP(level)].name, sizeof(sched_stats.groups[0].name), "level %d", level);
+    }
+    strcpy(sched_stats.groups[STATS_OTHER_GROUP].name, "(other)");
+}
+
+// Function to record one executed slice; a slice that used its whole quantum overshot by the excess
+void stats_record_slice(int level, const char *command, uint64_t slice_ns, uint64_t quantum_ns, bool exited) {
+    int group = stats_fingerprint_group(command);
+    stats_record(level, group, STAT_SLICE, slice_ns);
+    if (!exited && quantum_ns != UINT64_MAX) {
+        stats_record(level, group, STAT_OVERSHOOT, slice_ns > quantum_ns ? slice_ns - quantum_ns : 0);
+    }
+}
+
+// Function to record a finished job from its raw timestamps
+void stats_record_completion(int level, const char *command, uint64_t arrival_ns, uint64_t first_run_ns,
+                             uint64_t completion_ns, uint64_t cpu_ns) {
+    int group = stats_fingerprint_group(command);
+    uint64_t turnaround = completion_ns - arrival_ns;
+    stats_record(level, group, STAT_TURNAROUND, turnaround);
+    stats_record(level, group, STAT_WAITING, turnaround > cpu_ns ? turnaround - cpu_ns : 0);
+    stats_record(level, group, STAT_RESPONSE, first_run_ns - arrival_ns);
+}
+
+void stats_print_summary(FILE *fp) {
+    static const double percentiles[] = {50, 90, 99, 99.9};
+    fprintf(fp, "%s latency summary (ms)\n", sched_stats.policy);
+    fprintf(fp, "%-11s %-32s %10s %10s %10s %10s %10s %10s\n", "metric", "group", "count", "p50", "p90", "p99", "p99.9", "max");
+    for (int m = 0; m < STAT_METRICS; m++) {
+        for (int g = 0; g < STATS_GROUPS; g++) {
+            Histogram *h = sched_stats.groups[g].metrics[m];
+            if (h == NULL || h->total == 0) {
+                continue;
+            }
+            fprintf(fp, "%-11s %-32.32s %10lu", stat_metric_names[m], sched_stats.groups[g].name, h->total);
+            for (int p = 0; p < 4; p++) {
+                fprintf(fp, " %10.3f", (double)histogram_percentile(h, percentiles[p]) / NS_PER_MS);
+            }
+            fprintf(fp, " %10.3f\n", (double)h->max / NS_PER_MS);
+        }
+    }
+    fflush(fp);
+}
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "sched_clock.h"
+#include "sched_sink.h"
+
+// Binary trace of a scheduler run. Enabled by setting SCHED_TRACE=<file> before the
+// scheduler starts; every run of the process is appended to that file.
+//
+// Layout: the 8 byte magic "SCHTRACE", then records. A record is a type byte followed
+// by unsigned LEB128 varints. Timestamps are nanoseconds since the start of the run,
+// stored as the zigzag-encoded difference to the previous timestamp in the file.
+//
+//   TRACE_RUN      policy, param0..param3          (starts a run, resets the time base)
+//   TRACE_ARRIVAL  job, time, length, command bytes
+//   TRACE_SPAWN    job, time, pid
+//   TRACE_SLICE    job, start, end, quantum ns (0 when the job ran to completion)
+//   TRACE_EXIT     job, time, exit code, user cpu ns, system cpu ns
+//   TRACE_END                                       (the run finished)
+//
+// Records go through an AsyncSink (sched_sink.h) and are written out by its thread in
+// blocks of TRACE_FLUSH_BLOCK bytes, so the scheduler itself never makes a write call
+// for a record. The scheduler only waits at the end of a run (until the ring is on
+// disk) or when the disk falls TRACE_RING_SIZE bytes behind.
+
+#define TRACE_MAGIC "SCHTRACE"
+#define TRACE_MAGIC_LENGTH 8
+#define TRACE_RING_SIZE (4 << 20)
+#define TRACE_FLUSH_BLOCK (256 << 10)
+#define TRACE_MAX_COMMAND 4096
+#define TRACE_MAX_RECORD (TRACE_MAX_COMMAND + 64)
+#define TRACE_DEFAULT_PATH "context_switches.trace"
+
+typedef enum {
+    TRACE_RUN = 1,
+    TRACE_ARRIVAL,
+    TRACE_SPAWN,
+    TRACE_SLICE,
+    TRACE_EXIT,
+    TRACE_END
+} TraceRecordType;
+
+// Policies as recorded in TRACE_RUN
+typedef enum {
+    POLICY_FCFS,
+    POLICY_RR,
+    POLICY_MLFQ,
+    POLICY_SJF,
+    POLICY_ONLINE_MLFQ,
+    POLICY_CFS,
+    POLICY_ONLINE_CFS,
+    POLICY_STRIDE,
+    POLICY_ONLINE_STRIDE,
+    POLICY_LOTTERY,
+    POLICY_ONLINE_LOTTERY,
+    POLICY_EDF,
+    POLICY_DAG,
+    POLICY_ADAPTIVE_MLFQ,
+    POLICY_ONLINE_ADAPTIVE_MLFQ,
+    POLICY_FAIR_SHARE,
+    POLICY_COUNT
+} SchedPolicy;
+
+static const char *sched_policy_names[POLICY_COUNT] = {
+    "FCFS", "RR", "MLFQ", "SJF", "online MLFQ", "CFS", "online CFS",
+    "stride", "online stride", "lottery", "online lottery", "EDF", "DAG",
+    "adaptive MLFQ", "online adaptive MLFQ", "fair share"
+};
+
+// Function to name a recorded policy, "unknown" for ids from newer builds
+const char *sched_policy_name(uint64_t policy) {
+    return policy < POLICY_COUNT ? sched_policy_names[policy] : "unknown";
+}
+
+// How the schedulers report context switches, SCHED_SWITCH_OUTPUT=text|binary|none.
+// text prints "command|start|end" lines to stdout, binary only records them in the
+// trace (SCHED_TRACE, or TRACE_DEFAULT_PATH when that is unset).
+typedef enum {
+    SWITCH_OUTPUT_TEXT,
+    SWITCH_OUTPUT_BINARY,
+    SWITCH_OUTPUT_NONE
+} SwitchOutputMode;
+
+SwitchOutputMode switch_output_mode = SWITCH_OUTPUT_TEXT;
+
+typedef struct {
+    TraceRecordType type;
+    int job;
+    uint64_t time_ns;
+    uint64_t end_ns;            // TRACE_SLICE only
+    uint64_t values[5];         // TRACE_RUN: policy, params; TRACE_SPAWN: pid; TRACE_SLICE: quantum; TRACE_EXIT: code, user, system
+    char command[TRACE_MAX_COMMAND];
+} TraceRecord;
+
+typedef struct {
+    AsyncSink sink;             // sink.fd is -1 while tracing is off
+    pid_t owner;                // Forked jobs inherit the writer but not its thread
+    uint8_t record[TRACE_MAX_RECORD];
+    size_t record_length;       // Record being encoded, handed to the sink as a whole
+    uint64_t last_ns;
+} TraceWriter;
+
+TraceWriter trace_writer = {.sink = {.fd = -1}};
+
+// Function to wait until every record is in the file
+void trace_flush() {
+    sink_flush(&trace_writer.sink);
+}
+
+// Function to flush and stop the writer thread, registered with atexit. A later run opens the trace again.
+void trace_close() {
+    if (trace_writer.owner == getpid()) {
+        sink_close(&trace_writer.sink);
+    }
+}
+
+bool trace_open(const char *path) {
+    if (!sink_open(&trace_writer.sink, path, TRACE_RING_SIZE, TRACE_FLUSH_BLOCK, DURABILITY_BATCH)) {
+        return false;
+    }
+    sink_write(&trace_writer.sink, TRACE_MAGIC, TRACE_MAGIC_LENGTH);
+    trace_writer.owner = getpid();
+    atexit(trace_close);
+    return true;
+}
+
+void trace_commit() {
+    sink_write(&trace_writer.sink, trace_writer.record, trace_writer.record_length);
+    trace_writer.record_length = 0;
+}
+
+void trace_put_byte(uint8_t byte) {
+    trace_writer.record[trace_writer.record_length++] = byte;
+}
+
+void trace_put_varint(uint64_t value) {
+    while (value >= 0x80) {
+        trace_put_byte((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    trace_put_byte((uint8_t)value);
+}
+
+// Timestamps are written relative to the run start and to the previous timestamp
+void trace_put_time(uint64_t timestamp_ns) {
+    uint64_t t = timestamp_ns - sched_epoch_ns;
+    int64_t delta = (int64_t)(t - trace_writer.last_ns);
+    trace_put_varint(((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+    trace_writer.last_ns = t;
+}
+
+// Function to start recording a run, if SCHED_TRACE is set or context switches go to the
+// binary trace. Call after sched_clock_reset().
+void trace_begin_run(SchedPolicy policy, uint64_t param0, uint64_t param1, uint64_t param2, uint64_t param3) {
+    const char *mode = getenv("SCHED_SWITCH_OUTPUT");
+    if (mode != NULL && strcmp(mode, "text") == 0) {
+        switch_output_mode = SWITCH_OUTPUT_TEXT;
+    } else if (mode != NULL && strcmp(mode, "binary") == 0) {
+        switch_output_mode = SWITCH_OUTPUT_BINARY;
+    } else if (mode != NULL && strcmp(mode, "none") == 0) {
+        switch_output_mode = SWITCH_OUTPUT_NONE;
+    } else if (mode != NULL && mode[0] != '\0') {
+        fprintf(stderr, "Unknown SCHED_SWITCH_OUTPUT %s, using text\n", mode);
+        switch_output_mode = SWITCH_OUTPUT_TEXT;
+    }
+
+    if (trace_writer.sink.fd == -1) {
+        const char *path = getenv("SCHED_TRACE");
+        if (path == NULL || path[0] == '\0') {
+            if (switch_output_mode != SWITCH_OUTPUT_BINARY) {
+                return;
+            }
+            path = TRACE_DEFAULT_PATH;
+        }
+        if (!trace_open(path)) {
+            return;
+        }
+    }
+
+    trace_writer.last_ns = 0;
+    trace_put_byte(TRACE_RUN);
+    trace_put_varint(policy);
+    trace_put_varint(param0);
+    trace_put_varint(param1);
+    trace_put_varint(param2);
+    trace_put_varint(param3);
+    trace_commit();
+}
+
+void trace_end_run() {
+    if (trace_writer.sink.fd == -1) {
+        return;
+    }
+    trace_put_byte(TRACE_END);
+    trace_commit();
+    trace_flush();
+}
+
+void trace_arrival(int job, uint64_t arrival_ns, const char *command) {
+    if (trace_writer.sink.fd == -1) {
+        return;
+    }
+    size_t length = strlen(command);
+    if (length >= TRACE_MAX_COMMAND) {
+        length = TRACE_MAX_COMMAND - 1;
+    }
+    trace_put_byte(TRACE_ARRIVAL);
+    trace_put_varint(job);
+    trace_put_time(arrival_ns);
+    trace_put_varint(length);
+    memcpy(trace_writer.record + trace_writer.record_length, command, length);
+    trace_writer.record_length += length;
+    trace_commit();
+}
+
+void trace_spawn(int job, uint64_t time_ns, int pid) {
+    if (trace_writer.sink.fd == -1) {
+        return;
+    }
+    trace_put_byte(TRACE_SPAWN);
+    trace_put_varint(job);
+    trace_put_time(time_ns);
+    trace_put_varint((uint64_t)pid);
+    trace_commit();
+}
+
+// quantum_ns is the slice's budget, UINT64_MAX (stored as 0) when the job may run to completion
+void trace_slice(int job, uint64_t start_ns, uint64_t end_ns, uint64_t quantum_ns) {
+    if (trace_writer.sink.fd == -1) {
+        return;
+    }
+    trace_put_byte(TRACE_SLICE);
+    trace_put_varint(job);
+    trace_put_time(start_ns);
+    trace_put_time(end_ns);
+    trace_put_varint(quantum_ns == UINT64_MAX ? 0 : quantum_ns);
+    trace_commit();
+}
+
+void trace_exit(int job, uint64_t time_ns, int exit_code, uint64_t user_ns, uint64_t system_ns) {
+    if (trace_writer.sink.fd == -1) {
+        return;
+    }
+    trace_put_byte(TRACE_EXIT);
+    trace_put_varint(job);
+    trace_put_time(time_ns);
+    trace_put_varint((uint64_t)exit_code);
+    trace_put_varint(user_ns);
+    trace_put_varint(system_ns);
+    trace_commit();
+}
+
+// Reading side, used by replays
+
+bool trace_get_varint(FILE *fp, uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = fgetc(fp);
+        if (byte == EOF) {
+            return false;
+        }
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool trace_get_time(FILE *fp, uint64_t *last_ns, uint64_t *time_ns) {
+    uint64_t zigzag;
+    if (!trace_get_varint(fp, &zigzag)) {
+        return false;
+    }
+    int64_t delta = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+    *last_ns += (uint64_t)delta;
+    *time_ns = *last_ns;
+    return true;
+}
+
+// Function to check (and skip) the magic at the start of a trace file
+bool is_trace_file(FILE *fp) {
+    char magic[TRACE_MAGIC_LENGTH];
+    if (fread(magic, 1, TRACE_MAGIC_LENGTH, fp) == TRACE_MAGIC_LENGTH &&
+        memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LENGTH) == 0) {
+        return true;
+    }
+    rewind(fp);
+    return false;
+}
+
+// Function to read the next record, false at the end of the file or on a malformed record.
+// last_ns carries the delta base between calls and must start at 0.
+bool read_trace_record(FILE *fp, uint64_t *last_ns, TraceRecord *r) {
+    int type = fgetc(fp);
+    if (type == EOF) {
+        return false;
+    }
+    r->type = (TraceRecordType)type;
+
+    uint64_t job = 0, length;
+    switch (r->type) {
+        case TRACE_RUN:
+            *last_ns = 0;
+            for (int i = 0; i < 5; i++) {
+                if (!trace_get_varint(fp, &r->values[i])) return false;
+            }
+            return true;
+        case TRACE_ARRIVAL:
+            if (!trace_get_varint(fp, &job) || !trace_get_time(fp, last_ns, &r->time_ns) ||
+                !trace_get_varint(fp, &length) || length >= TRACE_MAX_COMMAND ||
+                fread(r->command, 1, length, fp) != length) {
+                return false;
+            }
+            r->command[length] = '\0';
+            break;
+        case TRACE_SPAWN:
+            if (!trace_get_varint(fp, &job) || !trace_get_time(fp, last_ns, &r->time_ns) ||
+                !trace_get_varint(fp, &r->values[0])) {
+                return false;
+            }
+            break;
+        case TRACE_SLICE:
+            if (!trace_get_varint(fp, &job) || !trace_get_time(fp, last_ns, &r->time_ns) ||
+                !trace_get_time(fp, last_ns, &r->end_ns) || !trace_get_varint(fp, &r->values[0])) {
+                return false;
+            }
+            break;
+        case TRACE_EXIT:
+            if (!trace_get_varint(fp, &job) || !trace_get_time(fp, last_ns, &r->time_ns)) {
+                return false;
+            }
+            for (int i = 0; i < 3; i++) {
+                if (!trace_get_varint(fp, &r->values[i])) return false;
+            }
+            break;
+        case TRACE_END:
+            return true;
+        default:
+            return false;
+    }
+    r->job = (int)job;
+    return true;
+}
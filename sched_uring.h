@@ -0,0 +1,294 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/io_uring.h>
+
+#include "sched_clock.h"
+#include "sched_input.h"
+
+// io_uring backend of the dispatcher, enabled by SCHED_URING=1 for real runs. One ring
+// carries everything the dispatcher waits for: the exit of the running job (WAITID) with
+// the end of its quantum as a linked timeout, the standing read of stdin during online
+// runs, and the writes of the result and trace files (sched_sink.h), which take the
+// place of the sinks' writer threads. Requests are only queued where they arise and go
+// to the kernel together, with the next io_uring_enter: a slice that does not exit costs
+// SIGCONT, one io_uring_enter and SIGSTOP, instead of polling wait4 until the quantum is
+// over, and the result rows written meanwhile ride along with it.
+//
+// The ring is set up with raw system calls, liburing is not needed. Kernels without
+// WAITID (before 6.7) or without io_uring fall back to the default backend with a note.
+
+#define URING_ENTRIES 64
+#define URING_OP_WAITID 50          // Not in <linux/io_uring.h> before 6.7
+
+// One request in flight on the ring; the completion's user_data points to it
+typedef struct UringRequest UringRequest;
+struct UringRequest {
+    void (*complete)(UringRequest *request);   // Called once the result is in (may be NULL)
+    int result;
+    bool pending;               // Queued or submitted, not completed yet
+};
+
+typedef struct {
+    int fd;                     // -1 while not set up
+    unsigned entries;
+    _Atomic unsigned *sq_head;
+    _Atomic unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    _Atomic unsigned *cq_head;
+    _Atomic unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned tail;              // Next free submission slot, published on io_uring_enter
+} Uring;
+
+Uring sched_uring = {.fd = -1};
+UringRequest uring_input;       // Standing read of stdin for online runs, into submission_input
+int uring_state = 0;            // 0 until SCHED_URING is read, 1 in use, -1 off
+uint64_t slice_syscalls = 0;    // System calls made to run slices, for the benchmarks
+
+// Function to set up the ring and check that the kernel has every operation used here.
+// NULL on success, else why not.
+const char *uring_setup(Uring *u) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    u->fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (u->fd < 0) {
+        u->fd = -1;
+        return strerror(errno);
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        close(u->fd);
+        u->fd = -1;
+        return "kernel too old";
+    }
+
+    size_t probe_size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = (struct io_uring_probe *)calloc(1, probe_size);
+    static const int needed[] = {URING_OP_WAITID, IORING_OP_LINK_TIMEOUT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC};
+    bool supported = syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (size_t i = 0; supported && i < sizeof(needed) / sizeof(needed[0]); i++) {
+        supported = needed[i] <= probe->last_op && (probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    if (!supported) {
+        close(u->fd);
+        u->fd = -1;
+        return "no IORING_OP_WAITID";
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    size_t size = sq_size > cq_size ? sq_size : cq_size;
+    uint8_t *rings = (uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    void *sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (rings == MAP_FAILED || sqes == MAP_FAILED) {
+        close(u->fd);
+        u->fd = -1;
+        return strerror(errno);
+    }
+    u->entries = params.sq_entries;
+    u->sq_head = (_Atomic unsigned *)(rings + params.sq_off.head);
+    u->sq_tail = (_Atomic unsigned *)(rings + params.sq_off.tail);
+    u->sq_mask = *(unsigned *)(rings + params.sq_off.ring_mask);
+    u->sq_array = (unsigned *)(rings + params.sq_off.array);
+    u->sqes = (struct io_uring_sqe *)sqes;
+    u->cq_head = (_Atomic unsigned *)(rings + params.cq_off.head);
+    u->cq_tail = (_Atomic unsigned *)(rings + params.cq_off.tail);
+    u->cq_mask = *(unsigned *)(rings + params.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(rings + params.cq_off.cqes);
+    u->tail = atomic_load(u->sq_tail);
+    return NULL;
+}
+
+// Function to tell whether the dispatcher goes through the ring (SCHED_URING=1), setting
+// the ring up on the first call
+bool uring_enabled() {
+    if (uring_state == 0) {
+        const char *env = getenv("SCHED_URING");
+        uring_state = -1;
+        if (env != NULL && env[0] != '\0' && strcmp(env, "0") != 0) {
+            const char *error = sched_uring.fd == -1 ? uring_setup(&sched_uring) : NULL;
+            if (error != NULL) {
+                fprintf(stderr, "SCHED_URING: io_uring unavailable (%s), using the default backend\n", error);
+            } else {
+                uring_state = 1;
+            }
+        }
+    }
+    return uring_state == 1;
+}
+
+// Function to run what comes next with or without the ring regardless of SCHED_URING
+// (benchmarks). Sinks opened before keep the way they were opened with.
+void uring_select(bool on) {
+    uring_state = 0;
+    setenv("SCHED_URING", on ? "1" : "0", 1);
+    uring_enabled();
+}
+
+// Function to call the completion of every finished request
+void uring_reap(Uring *u) {
+    unsigned head = atomic_load_explicit(u->cq_head, memory_order_relaxed);
+    while (head != atomic_load_explicit(u->cq_tail, memory_order_acquire)) {
+        struct io_uring_cqe *cqe = &u->cqes[head & u->cq_mask];
+        UringRequest *request = (UringRequest *)(uintptr_t)cqe->user_data;
+        int result = cqe->res;
+        atomic_store_explicit(u->cq_head, ++head, memory_order_release);
+        if (request != NULL) {
+            request->result = result;
+            request->pending = false;
+            if (request->complete != NULL) {
+                request->complete(request);
+            }
+        }
+    }
+}
+
+// Function to submit everything queued and wait for at least wait completions (at most
+// timeout_ns when not 0), then handle every completion there is
+void uring_enter(Uring *u, unsigned wait, uint64_t timeout_ns) {
+    atomic_store_explicit(u->sq_tail, u->tail, memory_order_release);
+    struct __kernel_timespec ts = {(long long)(timeout_ns / NS_PER_SEC), (long long)(timeout_ns % NS_PER_SEC)};
+    struct io_uring_getevents_arg arg = {0, 0, 0, (uint64_t)(uintptr_t)&ts};
+    while (true) {
+        unsigned queued = u->tail - atomic_load_explicit(u->sq_head, memory_order_acquire);
+        unsigned flags = (wait > 0 ? IORING_ENTER_GETEVENTS : 0) | (timeout_ns > 0 ? IORING_ENTER_EXT_ARG : 0);
+        slice_syscalls++;
+        long result = syscall(__NR_io_uring_enter, u->fd, queued, wait, flags,
+                              timeout_ns > 0 ? (void *)&arg : NULL, timeout_ns > 0 ? sizeof(arg) : 0);
+        if (result >= 0 || errno == ETIME) {
+            break;
+        }
+        if (errno == EINTR) {
+            if (timeout_ns > 0) {
+                break;      // The caller waits again if it needs to
+            }
+            continue;
+        }
+        if (errno != EAGAIN && errno != EBUSY) {
+            perror("io_uring_enter failed");
+            break;
+        }
+        uring_reap(u);  // Make room in the completion queue and try again
+    }
+    uring_reap(u);
+}
+
+// Function to queue a request; it goes to the kernel with the next uring_enter
+struct io_uring_sqe *uring_queue(Uring *u, UringRequest *request) {
+    if (u->tail - atomic_load_explicit(u->sq_head, memory_order_acquire) == u->entries) {
+        uring_enter(u, 0, 0);
+    }
+    unsigned index = u->tail & u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = (uint64_t)(uintptr_t)request;
+    u->sq_array[index] = index;
+    u->tail++;
+    if (request != NULL) {
+        request->pending = true;
+    }
+    return sqe;
+}
+
+// Function to wait until pid exits or the monotonic clock reaches deadline_ns (UINT64_MAX:
+// no limit), or until a submission line comes in when they end slices (see sched_input.h).
+// True when it exited (left unreaped for wait4 to collect its status and CPU time) or
+// cannot be waited for. Everything else queued is submitted along.
+bool uring_wait_exit(pid_t pid, uint64_t deadline_ns) {
+    static UringRequest exit_request, timeout_request, cancel_request;
+    static siginfo_t info;
+    struct __kernel_timespec ts = {(long long)(deadline_ns / NS_PER_SEC), (long long)(deadline_ns % NS_PER_SEC)};
+
+    struct io_uring_sqe *sqe = uring_queue(&sched_uring, &exit_request);
+    sqe->opcode = URING_OP_WAITID;
+    sqe->fd = pid;
+    sqe->len = P_PID;
+    sqe->file_index = WEXITED | WNOWAIT;
+    sqe->addr2 = (uint64_t)(uintptr_t)&info;
+    if (deadline_ns != UINT64_MAX) {
+        sqe->flags |= IOSQE_IO_LINK;
+        sqe = uring_queue(&sched_uring, &timeout_request);
+        sqe->opcode = IORING_OP_LINK_TIMEOUT;
+        sqe->addr = (uint64_t)(uintptr_t)&ts;
+        sqe->len = 1;
+        sqe->timeout_flags = IORING_TIMEOUT_ABS;
+    }
+    // The timeout always completes too (cancelled when the job exited first)
+    uint64_t lines = submission_input.lines_read;
+    bool cancelled = false;
+    while (exit_request.pending || timeout_request.pending || cancel_request.pending) {
+        uring_enter(&sched_uring, 1, 0);
+        bool arrived = submission_input.ends_slices && submission_input.lines_read != lines;
+        if (arrived && exit_request.pending && !cancelled) {
+            sqe = uring_queue(&sched_uring, &cancel_request);
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = (uint64_t)(uintptr_t)&exit_request;
+            cancelled = true;
+        }
+    }
+    return exit_request.result != -ECANCELED;
+}
+
+void uring_queue_input();
+
+// Function to take in what the standing read brought, stamped with when it was reaped, and
+// read on while slices run (see sched_input.h)
+void uring_input_complete(UringRequest *request) {
+    if (request->result > 0) {
+        input_received((size_t)request->result, sched_now_ns());
+    } else if (request->result != -EINTR && request->result != -EAGAIN) {
+        submission_input.eof = true;    // End of input, or input that cannot be read
+    }
+    if (submission_input.during_slices) {
+        uring_queue_input();
+    }
+}
+
+// Function to keep a read of stdin queued while there is room for more input
+void uring_queue_input() {
+    SubmissionInput *in = &submission_input;
+    if (uring_input.pending || in->eof || !input_make_room()) {
+        return;
+    }
+    uring_input.complete = uring_input_complete;
+    struct io_uring_sqe *sqe = uring_queue(&sched_uring, &uring_input);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = STDIN_FILENO;
+    sqe->addr = (uint64_t)(uintptr_t)(in->buffer + in->used);
+    sqe->len = INPUT_BUFFER_SIZE - in->used;
+    sqe->off = (uint64_t)-1;    // Current position, also for pipes and terminals
+}
+
+// Function to take the next line of stdin that arrived through the ring, without blocking,
+// with the time it was read. False when no whole line is in yet; a read stays queued for
+// the rest.
+bool uring_read_line(char *line, size_t size, uint64_t *read_ns) {
+    if (input_take_line(line, size, read_ns)) {
+        return true;
+    }
+    uring_queue_input();
+    return false;
+}
+
+// Function to sleep until input arrives or timeout_ns passes (online runs with nothing runnable)
+void uring_wait_input(uint64_t timeout_ns) {
+    uring_queue_input();
+    uring_enter(&sched_uring, 1, timeout_ns);
+}
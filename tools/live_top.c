@@ -0,0 +1,94 @@
+// Samples the live stats page of a running scheduler (started with SCHED_LIVE=<name>)
+// and prints one line per sample.
+//
+//   live_top [--interval MS] [--count N] [name]
+//
+// The name defaults to $SCHED_LIVE, or /sched_live. The interval defaults to 1000 ms;
+// without --count it samples until the run is done. Reading never blocks the scheduler:
+// the page is mapped read-only and copied under its seqlock.
+#include <signal.h>
+#include <time.h>
+
+#include "../sched_trace.h"
+#include "../sched_live.h"
+
+static const char *state_names[] = {"idle", "running", "done"};
+
+void print_sample(LiveStats *s) {
+    printf("%10.3fs %-11s %-7s submitted %lu completed %lu errors %lu slices %lu boosts %lu"
+           " in system %lu deferred %lu rejected %lu queues",
+           (double)s->updated_ns / NS_PER_SEC, sched_policy_name(s->policy),
+           s->state < 3 ? state_names[s->state] : "?", s->submitted, s->completed, s->errors, s->slices, s->boosts,
+           s->in_system, s->deferred, s->rejected);
+    for (uint32_t level = 0; level < s->levels && level < LIVE_MAX_LEVELS; level++) {
+        printf(" %lu", s->queue_depth[level]);
+    }
+    if (s->running_job >= 0) {
+        s->running_command[LIVE_COMMAND_LENGTH - 1] = '\0';
+        printf(" | job %ld", s->running_job);
+        if (s->running_level >= 0) {
+            printf(" (level %d)", s->running_level);
+        }
+        printf(" since %.3fs: %s", (double)s->running_since_ns / NS_PER_SEC, s->running_command);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    int interval_ms = 1000;
+    long count = -1;
+    const char *name = getenv("SCHED_LIVE");
+    if (name == NULL || name[0] == '\0') {
+        name = "/sched_live";
+    }
+
+    int arg = 1;
+    for (; arg + 1 < argc && strncmp(argv[arg], "--", 2) == 0; arg += 2) {
+        if (strcmp(argv[arg], "--interval") == 0) {
+            interval_ms = atoi(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "--count") == 0) {
+            count = atol(argv[arg + 1]);
+        } else {
+            break;
+        }
+    }
+    if (arg < argc) {
+        name = argv[arg++];
+    }
+    if (arg != argc || interval_ms < 0) {
+        fprintf(stderr, "Usage: %s [--interval MS] [--count N] [name]\n", argv[0]);
+        return 1;
+    }
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1) {
+        perror("Error opening the live stats page");
+        return 1;
+    }
+    void *page = mmap(NULL, sizeof(LiveStats), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        perror("Error mapping the live stats page");
+        return 1;
+    }
+
+    struct timespec delay = {interval_ms / 1000, (long)(interval_ms % 1000) * 1000000L};
+    for (long sample = 0; count < 0 || sample < count; sample++) {
+        LiveStats snapshot;
+        if (!live_read((const LiveStats *)page, &snapshot)) {
+            fprintf(stderr, "%s holds no consistent live stats\n", name);
+            return 1;
+        }
+        print_sample(&snapshot);
+        if (snapshot.state == LIVE_DONE && count < 0) {
+            break;
+        }
+        if (snapshot.state != LIVE_DONE && kill(snapshot.pid, 0) != 0 && count < 0) {
+            fprintf(stderr, "Scheduler %d is gone\n", snapshot.pid);
+            return 1;
+        }
+        nanosleep(&delay, NULL);
+    }
+    return 0;
+}
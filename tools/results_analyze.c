@@ -0,0 +1,245 @@
+// Per-command (or per-level) aggregates over a columnar result file, written by a run
+// with SCHED_RESULT_FORMAT=columnar or both.
+//
+//   results_analyze [--metric turnaround|waiting|response|cpu|all] [--by command|level] [--top N] <result.cols>
+//
+// The file is mmap'd and every column is used in place. Each metric is one pass that
+// scatters the column into per-group runs (a counting sort on the group key) followed by
+// a sort of each run for exact percentiles; totals, maxima and error counts are plain
+// loops over contiguous arrays that the compiler vectorizes (build with -O3).
+// Groups are listed by job count, the largest --top (default 20) of them.
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../sched_columnar.h"
+
+typedef struct {
+    const ColumnarHeader *header;
+    const void *columns[COLUMNAR_COLUMNS];
+    uint64_t rows;
+} ColumnarFile;
+
+typedef struct {
+    uint32_t key;
+    uint64_t count;
+    uint64_t start;         // First row of the group in the scattered order
+    uint64_t errors;
+} Group;
+
+int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+int compare_groups(const void *a, const void *b) {
+    const Group *x = (const Group *)a, *y = (const Group *)b;
+    if (x->count != y->count) {
+        return x->count > y->count ? -1 : 1;
+    }
+    return x->key < y->key ? -1 : x->key > y->key;
+}
+
+bool open_columnar(const char *path, ColumnarFile *f) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) != 0) {
+        perror("Error opening result file");
+        return false;
+    }
+    if ((size_t)st.st_size < sizeof(ColumnarHeader)) {
+        fprintf(stderr, "%s is not a columnar result file\n", path);
+        return false;
+    }
+    const uint8_t *base = (const uint8_t *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("Error mapping result file");
+        return false;
+    }
+
+    f->header = (const ColumnarHeader *)base;
+    if (memcmp(f->header->magic, COLUMNAR_MAGIC, 8) != 0 || f->header->version != COLUMNAR_VERSION ||
+        sizeof(ColumnarHeader) + f->header->column_count * sizeof(ColumnarColumn) > (size_t)st.st_size) {
+        fprintf(stderr, "%s is not a version %d columnar result file\n", path, COLUMNAR_VERSION);
+        return false;
+    }
+    f->rows = f->header->row_count;
+
+    // Columns are looked up by name so later versions can add some
+    const ColumnarColumn *directory = (const ColumnarColumn *)(base + sizeof(ColumnarHeader));
+    for (int column = 0; column < COLUMNAR_COLUMNS; column++) {
+        f->columns[column] = NULL;
+        for (uint32_t i = 0; i < f->header->column_count; i++) {
+            const ColumnarColumn *col = &directory[i];
+            if (strncmp(col->name, columnar_column_names[column], sizeof(col->name)) == 0 &&
+                col->offset + col->length <= (uint64_t)st.st_size) {
+                f->columns[column] = base + col->offset;
+            }
+        }
+        if (f->columns[column] == NULL) {
+            fprintf(stderr, "%s has no valid %s column\n", path, columnar_column_names[column]);
+            return false;
+        }
+    }
+    return true;
+}
+
+void group_name(ColumnarFile *f, bool by_level, uint32_t key, char *name, size_t size) {
+    if (by_level) {
+        if (key == COLUMNAR_NO_LEVEL) {
+            snprintf(name, size, "(no level)");
+        } else {
+            snprintf(name, size, "level %u", key);
+        }
+        return;
+    }
+    const int32_t *offsets = (const int32_t *)f->columns[COLUMNAR_DATA_COLUMNS];
+    const char *data = (const char *)f->columns[COLUMNAR_DATA_COLUMNS + 1];
+    int length = offsets[key + 1] - offsets[key];
+    snprintf(name, size, "%.*s", length, data + offsets[key]);
+}
+
+void print_row(const char *name, uint64_t count, uint64_t errors, uint64_t *sorted) {
+    double sum = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        sum += (double)sorted[i];
+    }
+    printf("%-40.40s %10lu %8lu %10.3f %10.3f %10.3f %10.3f %10.3f\n", name, count, errors,
+           sum / count / NS_PER_MS,
+           (double)sorted[(uint64_t)((count - 1) * 0.50)] / NS_PER_MS,
+           (double)sorted[(uint64_t)((count - 1) * 0.90)] / NS_PER_MS,
+           (double)sorted[(uint64_t)((count - 1) * 0.99)] / NS_PER_MS,
+           (double)sorted[count - 1] / NS_PER_MS);
+}
+
+void analyze_metric(ColumnarFile *f, int metric, bool by_level, const uint32_t *keys, Group *groups, int group_count,
+                    uint64_t *key_start, uint64_t *scratch, int top) {
+    const uint64_t *values = (const uint64_t *)f->columns[metric];
+    const uint8_t *errors = (const uint8_t *)f->columns[COL_ERROR];
+    uint64_t total_errors = 0;
+    for (uint64_t i = 0; i < f->rows; i++) {
+        total_errors += errors[i];
+    }
+
+    printf("\n%s (ms)\n", columnar_column_names[metric]);
+    printf("%-40s %10s %8s %10s %10s %10s %10s %10s\n", "group", "count", "errors", "mean", "p50", "p90", "p99", "max");
+
+    memcpy(scratch, values, f->rows * sizeof(uint64_t));
+    qsort(scratch, f->rows, sizeof(uint64_t), compare_u64);
+    print_row("all", f->rows, total_errors, scratch);
+
+    // Scatter the column into one contiguous run per group, then sort each run
+    for (uint64_t i = 0; i < f->rows; i++) {
+        scratch[key_start[keys[i]]++] = values[i];
+    }
+    for (int g = 0; g < group_count; g++) {
+        key_start[groups[g].key] = groups[g].start;  // Undo the advance for the next metric
+    }
+    for (int g = 0; g < group_count && g < top; g++) {
+        char name[128];
+        group_name(f, by_level, groups[g].key, name, sizeof(name));
+        qsort(scratch + groups[g].start, groups[g].count, sizeof(uint64_t), compare_u64);
+        print_row(name, groups[g].count, groups[g].errors, scratch + groups[g].start);
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *metric_name = "turnaround";
+    bool by_level = false;
+    int top = 20;
+    int arg = 1;
+    for (; arg + 1 < argc && strncmp(argv[arg], "--", 2) == 0; arg += 2) {
+        if (strcmp(argv[arg], "--metric") == 0) {
+            metric_name = argv[arg + 1];
+        } else if (strcmp(argv[arg], "--by") == 0) {
+            by_level = strcmp(argv[arg + 1], "level") == 0;
+        } else if (strcmp(argv[arg], "--top") == 0) {
+            top = atoi(argv[arg + 1]);
+        } else {
+            break;
+        }
+    }
+    if (arg != argc - 1) {
+        fprintf(stderr, "Usage: %s [--metric turnaround|waiting|response|cpu|all] [--by command|level] [--top N] <result.cols>\n", argv[0]);
+        return 1;
+    }
+
+    int metrics[4];
+    int metric_count = 0;
+    static const struct { const char *name; int column; } metric_columns[] = {
+        {"turnaround", COL_TURNAROUND}, {"waiting", COL_WAITING}, {"response", COL_RESPONSE}, {"cpu", COL_CPU}
+    };
+    for (int m = 0; m < 4; m++) {
+        if (strcmp(metric_name, "all") == 0 || strcmp(metric_name, metric_columns[m].name) == 0) {
+            metrics[metric_count++] = metric_columns[m].column;
+        }
+    }
+    if (metric_count == 0) {
+        fprintf(stderr, "Unknown metric %s\n", metric_name);
+        return 1;
+    }
+
+    ColumnarFile f;
+    if (!open_columnar(argv[arg], &f)) {
+        return 1;
+    }
+    printf("%s: %s, %lu jobs, %lu commands\n", argv[arg], f.header->policy, f.rows, f.header->dictionary_count);
+    if (f.rows == 0) {
+        return 0;
+    }
+
+    // Group keys as u32, so both groupings share one code path
+    uint64_t key_count = by_level ? COLUMNAR_NO_LEVEL + 1 : f.header->dictionary_count;
+    uint32_t *keys = (uint32_t *)f.columns[COL_COMMAND_ID];
+    if (by_level) {
+        const uint8_t *levels = (const uint8_t *)f.columns[COL_LEVEL];
+        keys = (uint32_t *)malloc(f.rows * sizeof(uint32_t));
+        for (uint64_t i = 0; i < f.rows; i++) {
+            keys[i] = levels[i];
+        }
+    }
+
+    uint64_t *counts = (uint64_t *)calloc(key_count, sizeof(uint64_t));
+    uint64_t *error_counts = (uint64_t *)calloc(key_count, sizeof(uint64_t));
+    const uint8_t *errors = (const uint8_t *)f.columns[COL_ERROR];
+    for (uint64_t i = 0; i < f.rows; i++) {
+        if (keys[i] >= key_count) {
+            fprintf(stderr, "Row %lu has an out of range group %u\n", i, keys[i]);
+            return 1;
+        }
+        counts[keys[i]]++;
+        error_counts[keys[i]] += errors[i];
+    }
+
+    // Groups in key order get consecutive runs of the scattered column
+    Group *groups = (Group *)malloc(key_count * sizeof(Group));
+    uint64_t *key_start = (uint64_t *)malloc(key_count * sizeof(uint64_t));
+    int group_count = 0;
+    uint64_t start = 0;
+    for (uint64_t k = 0; k < key_count; k++) {
+        key_start[k] = start;
+        if (counts[k] > 0) {
+            groups[group_count++] = (Group){(uint32_t)k, counts[k], start, error_counts[k]};
+        }
+        start += counts[k];
+    }
+    qsort(groups, group_count, sizeof(Group), compare_groups);
+
+    uint64_t *scratch = (uint64_t *)malloc(f.rows * sizeof(uint64_t));
+    for (int m = 0; m < metric_count; m++) {
+        analyze_metric(&f, metrics[m], by_level, keys, groups, group_count, key_start, scratch, top);
+    }
+    if (group_count > top) {
+        printf("\n(%d more groups, see --top)\n", group_count - top);
+    }
+
+    free(scratch);
+    free(key_start);
+    free(groups);
+    free(counts);
+    free(error_counts);
+    if (by_level) {
+        free(keys);
+    }
+    return 0;
+}
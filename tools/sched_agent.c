@@ -0,0 +1,119 @@
+// Worker agent for distributed runs (see sched_remote.h): listens at an address and runs
+// the slices a coordinator sends it, one at a time, through the usual run_slice().
+//
+//   sched_agent <unix:/path | tcp:host:port>
+//
+// Coordinators are served one after the other. When one disconnects, the jobs it left
+// stopped on the agent are killed. Job output follows the coordinator's default (inherit
+// for online runs, else discard) unless the agent captures it with SCHED_JOB_OUTPUT.
+#include <sys/resource.h>
+
+#include "../sched_remote.h"
+
+uint64_t timeval_ns(struct timeval t) {
+    return (uint64_t)t.tv_sec * NS_PER_SEC + (uint64_t)t.tv_usec * 1000;
+}
+
+// Function to run a coordinator's slices until it disconnects
+void serve_coordinator(int fd) {
+    RemoteMessage m;
+    remote_begin(&m, REMOTE_HELLO);
+    remote_put(&m, REMOTE_MAGIC, 4);
+    remote_put(&m, REMOTE_VERSION, 2);
+    remote_put(&m, getpid(), 4);
+    if (!remote_send(fd, &m)) {
+        return;
+    }
+
+    // Process of every job started here, -1 when it has none (yet or anymore)
+    pid_t *pids = NULL;
+    uint32_t capacity = 0;
+    while (remote_receive(fd, &m) && remote_get(&m, 1) == REMOTE_RUN) {
+        uint32_t job = (uint32_t)remote_get(&m, 4);
+        int flags = (int)remote_get(&m, 1);
+        uint64_t quantum_ns = remote_get(&m, 8);
+        size_t length = (size_t)remote_get(&m, 2);
+        if (!remote_complete(&m) || length >= MAX_COMMAND_LENGTH || m.position + length > m.length) {
+            fprintf(stderr, "Malformed request, dropping the coordinator\n");
+            break;
+        }
+        char command[MAX_COMMAND_LENGTH];
+        memcpy(command, m.data + m.position, length);
+        command[length] = '\0';
+
+        if (job >= capacity) {
+            uint32_t grown = capacity ? capacity : 64;
+            while (grown <= job) {
+                grown *= 2;
+            }
+            pids = (pid_t *)realloc(pids, grown * sizeof(pid_t));
+            for (uint32_t i = capacity; i < grown; i++) {
+                pids[i] = -1;
+            }
+            capacity = grown;
+        }
+
+        SliceResult r = {0, 0, true, true};
+        struct rusage before, after;
+        getrusage(RUSAGE_CHILDREN, &before);
+        if (pids[job] != -1 || length > 0) {
+            if (!job_output_captured()) {
+                job_output_mode = flags & REMOTE_RUN_INHERIT_OUTPUT ? JOB_OUTPUT_INHERIT : JOB_OUTPUT_DISCARD;
+            }
+            r = run_slice(job, &pids[job], command, quantum_ns);
+        }
+        getrusage(RUSAGE_CHILDREN, &after);
+
+        // Only the job reaped by this slice adds to the children's CPU time
+        remote_begin(&m, REMOTE_DONE);
+        remote_put(&m, job, 4);
+        remote_put(&m, (r.exited ? REMOTE_DONE_EXITED : 0) | (r.error ? REMOTE_DONE_ERROR : 0), 1);
+        remote_put(&m, (uint32_t)pids[job], 4);
+        remote_put(&m, r.end_ns - r.start_ns, 8);
+        remote_put(&m, timeval_ns(after.ru_utime) - timeval_ns(before.ru_utime), 8);
+        remote_put(&m, timeval_ns(after.ru_stime) - timeval_ns(before.ru_stime), 8);
+        if (r.exited) {
+            pids[job] = -1;
+        }
+        if (!remote_send(fd, &m)) {
+            break;
+        }
+    }
+
+    for (uint32_t i = 0; i < capacity; i++) {
+        if (pids[i] > 0) {
+            kill(pids[i], SIGKILL);
+            waitpid(pids[i], NULL, 0);
+        }
+    }
+    free(pids);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <unix:/path | tcp:host:port>\n", argv[0]);
+        return 1;
+    }
+    int listener = remote_open(argv[1], true);
+    if (listener == -1) {
+        return 1;
+    }
+    job_output_begin_run(JOB_OUTPUT_DISCARD);  // SCHED_JOB_OUTPUT captures on the agent's side
+    fprintf(stderr, "Agent %d listening on %s\n", (int)getpid(), argv[1]);
+
+    while (true) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("accept failed");
+            return 1;
+        }
+        fcntl(fd, F_SETFD, FD_CLOEXEC);  // Not inherited by the jobs
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // Fails harmlessly on unix sockets
+        serve_coordinator(fd);
+        close(fd);
+    }
+}
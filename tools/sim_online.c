@@ -0,0 +1,127 @@
+// Runs an online scheduler on the virtual clock against a declared arrival profile, or
+// replays a run recorded with SCHED_TRACE=<file>.
+//
+//   sim_online [--run N] [--cpu] <profile|trace> [SJF | MLFQ <q0> <q1> <q2> <boost> | ADAPTIVE <min_quantum> <max_quantum> | CFS <latency> <granularity> | STRIDE <quantum> | LOTTERY <quantum> <seed> | EDF <quantum> <reject> | FAIR <inner> <quantum> <half_life>]
+//
+// Profile lines are "arrival_ms burst_ms exit_status command", in arrival order; each
+// job is submitted when the virtual clock reaches its arrival time. A trace replays
+// run N (default 0) with the policy it was recorded with unless another one is given;
+// job bursts are the recorded slice times, or the kernel-reported CPU times with --cpu.
+// The CSV and the context-switch lines are the same as for a real run. Set
+// SIM_SWITCH_COST_MS to charge time for every slice. FAIR takes the tenants' policy as
+// 0 (SJF), 1 (MLFQ) or 2 (Round Robin).
+#include "../online_schedulers.h"
+
+int main(int argc, char **argv) {
+    int run = 0;
+    bool use_cpu_time = false;
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++) {
+        if (strcmp(argv[arg], "--run") == 0 && arg + 1 < argc) {
+            run = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "--cpu") == 0) {
+            use_cpu_time = true;
+        } else {
+            break;
+        }
+    }
+    if (arg >= argc) {
+        fprintf(stderr, "Usage: %s [--run N] [--cpu] <profile|trace> [SJF | MLFQ <q0> <q1> <q2> <boost> | ADAPTIVE <min_quantum> <max_quantum> | CFS <latency> <granularity> | STRIDE <quantum> | LOTTERY <quantum> <seed> | EDF <quantum> <reject> | FAIR <inner> <quantum> <half_life>]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *fp = fopen(argv[arg], "rb");
+    if (fp == NULL) {
+        perror("Error opening profile");
+        return 1;
+    }
+    SimProfile profile = {0};
+    uint64_t recorded[5] = {0};
+    bool replay = is_trace_file(fp);
+    if (replay ? !load_trace_profile(fp, run, use_cpu_time, &profile, recorded) : !load_sim_profile(fp, &profile)) {
+        return 1;
+    }
+    fclose(fp);
+    arg++;
+
+    // Without an explicit policy a trace replays the one it was recorded with
+    SchedPolicy policy;
+    int params[4] = {0};
+    if (arg < argc) {
+        int count = argc - arg - 1;
+        if (strcmp(argv[arg], "SJF") == 0 && count == 0) {
+            policy = POLICY_SJF;
+        } else if (strcmp(argv[arg], "MLFQ") == 0 && count == 4) {
+            policy = POLICY_ONLINE_MLFQ;
+        } else if (strcmp(argv[arg], "ADAPTIVE") == 0 && count == 2) {
+            policy = POLICY_ONLINE_ADAPTIVE_MLFQ;
+        } else if (strcmp(argv[arg], "CFS") == 0 && count == 2) {
+            policy = POLICY_ONLINE_CFS;
+        } else if (strcmp(argv[arg], "STRIDE") == 0 && count == 1) {
+            policy = POLICY_ONLINE_STRIDE;
+        } else if (strcmp(argv[arg], "LOTTERY") == 0 && count == 2) {
+            policy = POLICY_ONLINE_LOTTERY;
+        } else if (strcmp(argv[arg], "EDF") == 0 && count == 2) {
+            policy = POLICY_EDF;
+        } else if (strcmp(argv[arg], "FAIR") == 0 && count == 3) {
+            policy = POLICY_FAIR_SHARE;
+        } else {
+            fprintf(stderr, "Unknown policy or wrong number of arguments: %s\n", argv[arg]);
+            return 1;
+        }
+        for (int i = 0; i < count; i++) {
+            params[i] = atoi(argv[arg + 1 + i]);
+        }
+    } else if (replay) {
+        policy = (SchedPolicy)recorded[0];
+        for (int i = 0; i < 4; i++) {
+            params[i] = (int)recorded[i + 1];
+        }
+    } else {
+        fprintf(stderr, "A policy is required for a profile\n");
+        return 1;
+    }
+
+    const char *switch_cost = getenv("SIM_SWITCH_COST_MS");
+    if (switch_cost != NULL) {
+        profile.switch_cost_ns = (uint64_t)(atof(switch_cost) * NS_PER_MS);
+    }
+
+    // Every profile job is submitted, so the process list must be able to hold them all
+    if (profile.count > max_processes) {
+        max_processes = profile.count;
+    }
+
+    begin_simulation(&profile);
+    switch (policy) {
+        case POLICY_SJF:
+            ShortestJobFirst();
+            break;
+        case POLICY_ONLINE_MLFQ:
+            MultiLevelFeedbackQueue(params[0], params[1], params[2], params[3]);
+            break;
+        case POLICY_ONLINE_ADAPTIVE_MLFQ:
+            AdaptiveMultiLevelFeedbackQueue(params[0], params[1]);
+            break;
+        case POLICY_ONLINE_CFS:
+            CompletelyFairScheduler(params[0], params[1]);
+            break;
+        case POLICY_ONLINE_STRIDE:
+            StrideScheduling(params[0]);
+            break;
+        case POLICY_ONLINE_LOTTERY:
+            LotteryScheduling(params[0], params[1]);
+            break;
+        case POLICY_EDF:
+            EarliestDeadlineFirst(params[0], params[1]);
+            break;
+        case POLICY_FAIR_SHARE:
+            FairShareScheduler((TenantPolicy)params[0], params[1], params[2]);
+            break;
+        default:
+            fprintf(stderr, "Run %d was recorded by an offline scheduler, use sim_offline\n", run);
+            return 1;
+    }
+    end_simulation();
+    return 0;
+}
@@ -0,0 +1,243 @@
+// Converts a trace recorded with SCHED_TRACE=<file> (or SCHED_SWITCH_OUTPUT=binary) into
+// Chrome trace-event JSON, which chrome://tracing and ui.perfetto.dev both open.
+//
+//   trace_export [--run N] <trace> [output.json]
+//
+// Every run becomes a process and every job a thread of it, so each job gets its own
+// timeline: "run" for its slices, "waiting" from its arrival or previous slice to the
+// next one, "overshoot" nested in a slice for the time it ran past its quantum, and
+// instant events for spawn and exit. The "dispatcher" thread shows the gaps between
+// consecutive slices, i.e. where the scheduler itself (or idleness) took the CPU.
+// All runs are exported unless --run picks one (0 = first). Output goes to stdout by default.
+#include "../sched_trace.h"
+
+typedef struct {
+    uint64_t ready_ns;      // Arrival or end of the last slice
+    bool arrived;
+} JobTimeline;
+
+typedef struct {
+    FILE *out;
+    bool first_event;
+    int pid;
+    JobTimeline *jobs;
+    int capacity;
+    uint64_t last_slice_end_ns;
+    bool any_slice;
+
+    // A slice is held back until the next record tells whether the job exited with it
+    bool pending;
+    TraceRecord slice;
+} Exporter;
+
+void write_json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (const unsigned char *c = (const unsigned char *)s; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(out, "\\%c", *c);
+        } else if (*c < 0x20) {
+            fprintf(out, "\\u%04x", *c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// Function to start the next event object; the caller prints the fields and the closing brace
+void begin_event(Exporter *e, const char *phase, int tid) {
+    fprintf(e->out, "%s\n{\"ph\":\"%s\",\"pid\":%d,\"tid\":%d", e->first_event ? "" : ",", phase, e->pid, tid);
+    e->first_event = false;
+}
+
+void write_span(Exporter *e, int tid, const char *name, const char *category, uint64_t start_ns, uint64_t end_ns) {
+    begin_event(e, "X", tid);
+    fprintf(e->out, ",\"name\":\"%s\",\"cat\":\"%s\",\"ts\":%.3f,\"dur\":%.3f", name, category,
+            start_ns / 1000.0, (end_ns - start_ns) / 1000.0);
+}
+
+void write_thread_name(Exporter *e, int tid, const char *name) {
+    begin_event(e, "M", tid);
+    fprintf(e->out, ",\"name\":\"thread_name\",\"args\":{\"name\":");
+    write_json_string(e->out, name);
+    fprintf(e->out, "}}");
+    begin_event(e, "M", tid);
+    fprintf(e->out, ",\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":%d}}", tid);
+}
+
+JobTimeline *job_timeline(Exporter *e, int job) {
+    if (job >= e->capacity) {
+        int capacity = e->capacity ? e->capacity : 1024;
+        while (capacity <= job) {
+            capacity *= 2;
+        }
+        e->jobs = (JobTimeline *)realloc(e->jobs, capacity * sizeof(JobTimeline));
+        memset(e->jobs + e->capacity, 0, (capacity - e->capacity) * sizeof(JobTimeline));
+        e->capacity = capacity;
+    }
+    return &e->jobs[job];
+}
+
+void write_slice(Exporter *e, TraceRecord *s, bool exited) {
+    JobTimeline *j = job_timeline(e, s->job);
+    int tid = s->job + 1;
+    uint64_t quantum = s->values[0];
+
+    if (j->arrived && s->time_ns > j->ready_ns) {
+        write_span(e, tid, "waiting", "wait", j->ready_ns, s->time_ns);
+        fprintf(e->out, "}");
+    }
+    j->ready_ns = s->end_ns;
+    j->arrived = true;
+
+    write_span(e, tid, "run", "slice", s->time_ns, s->end_ns);
+    fprintf(e->out, ",\"args\":{\"quantum_ms\":%.3f,\"exited\":%s", quantum / 1e6, exited ? "true" : "false");
+    bool overshot = !exited && quantum != 0 && s->end_ns - s->time_ns > quantum;
+    if (overshot) {
+        fprintf(e->out, ",\"overshoot_ms\":%.3f", (s->end_ns - s->time_ns - quantum) / 1e6);
+    }
+    fprintf(e->out, "}}");
+    if (overshot) {
+        write_span(e, tid, "overshoot", "overshoot", s->time_ns + quantum, s->end_ns);
+        fprintf(e->out, "}");
+    }
+
+    if (e->any_slice && s->time_ns > e->last_slice_end_ns) {
+        write_span(e, 0, "gap", "dispatch", e->last_slice_end_ns, s->time_ns);
+        fprintf(e->out, "}");
+    }
+    e->last_slice_end_ns = s->end_ns;
+    e->any_slice = true;
+}
+
+void flush_pending_slice(Exporter *e, bool exited) {
+    if (e->pending) {
+        write_slice(e, &e->slice, exited);
+        e->pending = false;
+    }
+}
+
+void begin_run(Exporter *e, TraceRecord *r, int run) {
+    e->pid = run + 1;
+    e->any_slice = false;
+    memset(e->jobs, 0, e->capacity * sizeof(JobTimeline));
+
+    char name[128];
+    const char *policy = sched_policy_name(r->values[0]);
+    snprintf(name, sizeof(name), "run %d: %s (%lu, %lu, %lu, %lu)", run, policy,
+             r->values[1], r->values[2], r->values[3], r->values[4]);
+    begin_event(e, "M", 0);
+    fprintf(e->out, ",\"name\":\"process_name\",\"args\":{\"name\":\"%s\"}}", name);
+    write_thread_name(e, 0, "dispatcher");
+}
+
+void export_record(Exporter *e, TraceRecord *r) {
+    if (r->type == TRACE_EXIT && e->pending && e->slice.job == r->job) {
+        flush_pending_slice(e, true);
+    } else {
+        flush_pending_slice(e, false);
+    }
+
+    char name[TRACE_MAX_COMMAND + 32];
+    switch (r->type) {
+        case TRACE_ARRIVAL: {
+            JobTimeline *j = job_timeline(e, r->job);
+            j->ready_ns = r->time_ns;
+            j->arrived = true;
+            snprintf(name, sizeof(name), "job %d: %s", r->job, r->command);
+            write_thread_name(e, r->job + 1, name);
+            break;
+        }
+        case TRACE_SPAWN:
+            begin_event(e, "i", r->job + 1);
+            fprintf(e->out, ",\"name\":\"spawn\",\"s\":\"t\",\"ts\":%.3f,\"args\":{\"pid\":%lu}}",
+                    r->time_ns / 1000.0, r->values[0]);
+            break;
+        case TRACE_SLICE:
+            e->slice = *r;
+            e->pending = true;
+            break;
+        case TRACE_EXIT:
+            begin_event(e, "i", r->job + 1);
+            fprintf(e->out, ",\"name\":\"exit\",\"s\":\"t\",\"ts\":%.3f,\"args\":{\"code\":%lu,\"user_ms\":%.3f,\"system_ms\":%.3f}}",
+                    r->time_ns / 1000.0, r->values[0], r->values[1] / 1e6, r->values[2] / 1e6);
+            break;
+        default:
+            break;
+    }
+}
+
+int main(int argc, char **argv) {
+    int only_run = -1;
+    int arg = 1;
+    if (arg + 1 < argc && strcmp(argv[arg], "--run") == 0) {
+        only_run = atoi(argv[arg + 1]);
+        arg += 2;
+    }
+    if (arg >= argc) {
+        fprintf(stderr, "Usage: %s [--run N] <trace> [output.json]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *fp = fopen(argv[arg], "rb");
+    if (fp == NULL) {
+        perror("Error opening trace");
+        return 1;
+    }
+    if (!is_trace_file(fp)) {
+        fprintf(stderr, "%s is not a scheduler trace\n", argv[arg]);
+        return 1;
+    }
+
+    Exporter e = {0};
+    e.out = stdout;
+    if (arg + 1 < argc) {
+        e.out = fopen(argv[arg + 1], "w");
+        if (e.out == NULL) {
+            perror("Error opening output file");
+            return 1;
+        }
+    }
+    static char buffer[1 << 20];
+    setvbuf(e.out, buffer, _IOFBF, sizeof(buffer));
+    e.first_event = true;
+    fprintf(e.out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    TraceRecord *r = (TraceRecord *)malloc(sizeof(TraceRecord));
+    e.slice.job = -1;
+    uint64_t last_ns = 0;
+    int run = -1;
+    bool truncated = false;
+    while (true) {
+        if (!read_trace_record(fp, &last_ns, r)) {
+            truncated = !feof(fp);
+            break;
+        }
+        if (r->type == TRACE_RUN) {
+            flush_pending_slice(&e, false);
+            if (++run == only_run || only_run == -1) {
+                begin_run(&e, r, run);
+            }
+            continue;
+        }
+        if (only_run == -1 || run == only_run) {
+            export_record(&e, r);
+        }
+    }
+    flush_pending_slice(&e, false);
+    fprintf(e.out, "\n]}\n");
+
+    if (truncated) {
+        fprintf(stderr, "Malformed record after run %d, the export stops there\n", run);
+    }
+    if (only_run >= 0 && run < only_run) {
+        fprintf(stderr, "Trace has no run %d\n", only_run);
+    }
+    free(r);
+    free(e.jobs);
+    fclose(fp);
+    if (e.out != stdout) {
+        fclose(e.out);
+    }
+    return truncated ? 1 : 0;
+}
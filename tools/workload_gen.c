@@ -0,0 +1,387 @@
+// Synthetic workload generator, and the job binary its workloads run.
+//
+//   workload_gen [options]                 emit a job stream
+//   workload_gen run <phase>[,<phase>...]  run one job, e.g. "cpu:12.5,io:3,sleep:20"
+//
+// A job is a sequence of phases, each with a duration in (fractional) milliseconds:
+//   cpu:MS    busy-loop until MS of CPU time has been used (not wall time, so being
+//             stopped by the scheduler does not shorten it)
+//   io:MS     write and fdatasync 64 KiB blocks to a temporary file for MS of wall time
+//   sleep:MS  sleep for MS
+//
+// Options:
+//   -n N                       number of jobs (default 100)
+//   --format profile|stdin|offline
+//       profile: simulation profile lines "arrival_ms burst_ms exit_status command" (default)
+//       stdin:   print each command at its arrival time, for piping into an online scheduler
+//       offline: a C array "Process workload[]" (plus workload_count) for the offline API
+//   --arrival poisson:RATE | bursty:RATE:BURST:IDLE_MS | batch
+//       poisson: exponential gaps, RATE jobs per second (default poisson:10)
+//       bursty:  BURST jobs at RATE per second, then IDLE_MS of silence, repeated
+//       batch:   every job arrives at t=0
+//   --duration fixed:MS | exp:MEAN_MS | pareto:ALPHA:MIN_MS | lognormal:MU:SIGMA
+//       total duration of a job (default exp:100); lognormal parameters are for ln(ms)
+//   --max MS                   cap on a job's duration (default none)
+//   --mix cpu=W,io=W,sleep=W   relative weight of each phase kind (default cpu=1)
+//   --phases K                 phases per job, the duration is split randomly (default 1)
+//   --seed S                   random seed (default 1), the same seed gives the same stream
+//   --runner PATH              program named in the emitted commands (default: this binary)
+//
+// Build: gcc -O2 -o workload_gen tools/workload_gen.c -lm
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+#include "../sched_clock.h"
+
+#define MAX_PHASES 16
+#define MAX_JOB_COMMAND 1024
+
+typedef enum { PHASE_CPU, PHASE_IO, PHASE_SLEEP, PHASE_KINDS } PhaseKind;
+static const char *phase_names[] = {"cpu", "io", "sleep"};
+
+typedef enum { DIST_FIXED, DIST_EXP, DIST_PARETO, DIST_LOGNORMAL } DistributionKind;
+typedef enum { ARRIVAL_POISSON, ARRIVAL_BURSTY, ARRIVAL_BATCH } ArrivalKind;
+typedef enum { FORMAT_PROFILE, FORMAT_STDIN, FORMAT_OFFLINE } OutputFormat;
+
+typedef struct {
+    int jobs;
+    OutputFormat format;
+    ArrivalKind arrival;
+    double rate;            // Jobs per second
+    int burst_length;
+    double idle_ms;
+    DistributionKind duration;
+    double duration_a;
+    double duration_b;
+    double max_ms;
+    double mix[PHASE_KINDS];
+    int phases;
+    uint64_t seed;
+    const char *runner;
+} WorkloadConfig;
+
+// Running a job
+
+void run_cpu_phase(double ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    uint64_t start = (uint64_t)ts.tv_sec * NS_PER_SEC + (uint64_t)ts.tv_nsec;
+    uint64_t target = (uint64_t)(ms * NS_PER_MS);
+    volatile uint64_t spin = 0;
+    while (1) {
+        for (int i = 0; i < 1000; i++) {
+            spin++;
+        }
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        if ((uint64_t)ts.tv_sec * NS_PER_SEC + (uint64_t)ts.tv_nsec - start >= target) {
+            return;
+        }
+    }
+}
+
+void run_io_phase(double ms) {
+    static char block[65536];
+    FILE *fp = tmpfile();
+    if (fp == NULL) {
+        perror("tmpfile");
+        exit(1);
+    }
+    int fd = fileno(fp);
+    uint64_t start = sched_now_ns();
+    uint64_t target = (uint64_t)(ms * NS_PER_MS);
+    int blocks = 0;
+    while (sched_now_ns() - start < target) {
+        if (write(fd, block, sizeof(block)) < 0) {
+            perror("write");
+            exit(1);
+        }
+        fdatasync(fd);
+        // Keep the file small, the point is the I/O wait, not the disk usage
+        if (++blocks == 64) {
+            lseek(fd, 0, SEEK_SET);
+            blocks = 0;
+        }
+    }
+    fclose(fp);
+}
+
+void run_sleep_phase(double ms) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ms / 1000);
+    ts.tv_nsec = (long)((ms - ts.tv_sec * 1000.0) * NS_PER_MS);
+    while (nanosleep(&ts, &ts) != 0) {
+    }
+}
+
+int run_job(const char *spec) {
+    char *copy = strdup(spec);
+    for (char *phase = strtok(copy, ","); phase != NULL; phase = strtok(NULL, ",")) {
+        char *colon = strchr(phase, ':');
+        if (colon == NULL) {
+            fprintf(stderr, "Malformed phase: %s\n", phase);
+            return 2;
+        }
+        *colon = '\0';
+        double ms = atof(colon + 1);
+        if (strcmp(phase, "cpu") == 0) {
+            run_cpu_phase(ms);
+        } else if (strcmp(phase, "io") == 0) {
+            run_io_phase(ms);
+        } else if (strcmp(phase, "sleep") == 0) {
+            run_sleep_phase(ms);
+        } else {
+            fprintf(stderr, "Unknown phase kind: %s\n", phase);
+            return 2;
+        }
+    }
+    free(copy);
+    return 0;
+}
+
+// Generating a workload
+
+uint64_t rng_state;
+
+// splitmix64, uniform in (0, 1)
+double next_uniform() {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return ((z >> 11) + 0.5) / 9007199254740992.0;
+}
+
+double next_exponential(double mean) {
+    return -mean * log(next_uniform());
+}
+
+double next_normal() {
+    return sqrt(-2.0 * log(next_uniform())) * cos(2.0 * M_PI * next_uniform());
+}
+
+double next_duration(WorkloadConfig *c) {
+    double ms;
+    switch (c->duration) {
+        case DIST_FIXED:
+            ms = c->duration_a;
+            break;
+        case DIST_EXP:
+            ms = next_exponential(c->duration_a);
+            break;
+        case DIST_PARETO:
+            ms = c->duration_b / pow(next_uniform(), 1.0 / c->duration_a);
+            break;
+        default:
+            ms = exp(c->duration_a + c->duration_b * next_normal());
+            break;
+    }
+    if (c->max_ms > 0 && ms > c->max_ms) {
+        ms = c->max_ms;
+    }
+    return ms < 0.001 ? 0.001 : ms;
+}
+
+double next_gap_ms(WorkloadConfig *c, int job) {
+    switch (c->arrival) {
+        case ARRIVAL_POISSON:
+            return next_exponential(1000.0 / c->rate);
+        case ARRIVAL_BURSTY:
+            if (job > 0 && job % c->burst_length == 0) {
+                return c->idle_ms + next_exponential(1000.0 / c->rate);
+            }
+            return next_exponential(1000.0 / c->rate);
+        default:
+            return 0;
+    }
+}
+
+PhaseKind next_phase_kind(WorkloadConfig *c) {
+    double total = c->mix[PHASE_CPU] + c->mix[PHASE_IO] + c->mix[PHASE_SLEEP];
+    double pick = next_uniform() * total;
+    for (int k = 0; k < PHASE_KINDS - 1; k++) {
+        if (pick < c->mix[k]) {
+            return (PhaseKind)k;
+        }
+        pick -= c->mix[k];
+    }
+    return PHASE_SLEEP;
+}
+
+// Function to build the command line of one job, returns its total duration in ms
+double make_job(WorkloadConfig *c, char *command, size_t length) {
+    double total = next_duration(c);
+    double weights[MAX_PHASES], weight_sum = 0;
+    for (int i = 0; i < c->phases; i++) {
+        weights[i] = next_uniform();
+        weight_sum += weights[i];
+    }
+
+    int used = snprintf(command, length, "%s run ", c->runner);
+    for (int i = 0; i < c->phases && used < (int)length; i++) {
+        PhaseKind kind = next_phase_kind(c);
+        used += snprintf(command + used, length - used, "%s%s:%.3f", i ? "," : "", phase_names[kind],
+                         total * weights[i] / weight_sum);
+    }
+    return total;
+}
+
+void sleep_until(uint64_t start_ns, double offset_ms) {
+    uint64_t target = start_ns + (uint64_t)(offset_ms * NS_PER_MS);
+    uint64_t now = sched_now_ns();
+    if (target > now) {
+        run_sleep_phase((double)(target - now) / NS_PER_MS);
+    }
+}
+
+void generate(WorkloadConfig *c) {
+    char command[MAX_JOB_COMMAND];
+    double arrival_ms = 0;
+    uint64_t start_ns = sched_now_ns();
+    rng_state = c->seed;
+
+    if (c->format == FORMAT_PROFILE) {
+        printf("# arrival_ms burst_ms exit_status command\n");
+    } else if (c->format == FORMAT_OFFLINE) {
+        printf("// Generated by workload_gen, include after offline_schedulers.h\n");
+        printf("Process workload[] = {\n");
+    }
+
+    for (int i = 0; i < c->jobs; i++) {
+        arrival_ms += next_gap_ms(c, i);
+        double duration_ms = make_job(c, command, sizeof(command));
+        switch (c->format) {
+            case FORMAT_PROFILE:
+                printf("%.3f %.3f 0 %s\n", arrival_ms, duration_ms, command);
+                break;
+            case FORMAT_STDIN:
+                sleep_until(start_ns, arrival_ms);
+                printf("%s\n", command);
+                fflush(stdout);
+                break;
+            case FORMAT_OFFLINE:
+                printf("    {\"%s\"},\n", command);
+                break;
+        }
+    }
+
+    if (c->format == FORMAT_OFFLINE) {
+        printf("};\n");
+        printf("int workload_count = sizeof(workload) / sizeof(workload[0]);\n");
+    }
+}
+
+bool parse_mix(WorkloadConfig *c, char *spec) {
+    c->mix[PHASE_CPU] = c->mix[PHASE_IO] = c->mix[PHASE_SLEEP] = 0;
+    for (char *part = strtok(spec, ","); part != NULL; part = strtok(NULL, ",")) {
+        char *eq = strchr(part, '=');
+        if (eq == NULL) {
+            return false;
+        }
+        *eq = '\0';
+        int k = 0;
+        while (k < PHASE_KINDS && strcmp(part, phase_names[k]) != 0) k++;
+        if (k == PHASE_KINDS) {
+            return false;
+        }
+        c->mix[k] = atof(eq + 1);
+    }
+    return c->mix[PHASE_CPU] + c->mix[PHASE_IO] + c->mix[PHASE_SLEEP] > 0;
+}
+
+bool parse_arrival(WorkloadConfig *c, const char *spec) {
+    if (strcmp(spec, "batch") == 0) {
+        c->arrival = ARRIVAL_BATCH;
+        return true;
+    }
+    if (sscanf(spec, "poisson:%lf", &c->rate) == 1) {
+        c->arrival = ARRIVAL_POISSON;
+        return c->rate > 0;
+    }
+    if (sscanf(spec, "bursty:%lf:%d:%lf", &c->rate, &c->burst_length, &c->idle_ms) == 3) {
+        c->arrival = ARRIVAL_BURSTY;
+        return c->rate > 0 && c->burst_length > 0;
+    }
+    return false;
+}
+
+bool parse_duration(WorkloadConfig *c, const char *spec) {
+    if (sscanf(spec, "fixed:%lf", &c->duration_a) == 1) {
+        c->duration = DIST_FIXED;
+    } else if (sscanf(spec, "exp:%lf", &c->duration_a) == 1) {
+        c->duration = DIST_EXP;
+    } else if (sscanf(spec, "pareto:%lf:%lf", &c->duration_a, &c->duration_b) == 2) {
+        c->duration = DIST_PARETO;
+        return c->duration_a > 0 && c->duration_b > 0;
+    } else if (sscanf(spec, "lognormal:%lf:%lf", &c->duration_a, &c->duration_b) == 2) {
+        c->duration = DIST_LOGNORMAL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "run") == 0) {
+        return argc == 3 ? run_job(argv[2]) : 2;
+    }
+
+    WorkloadConfig c = {0};
+    c.jobs = 100;
+    c.format = FORMAT_PROFILE;
+    c.arrival = ARRIVAL_POISSON;
+    c.rate = 10;
+    c.duration = DIST_EXP;
+    c.duration_a = 100;
+    c.mix[PHASE_CPU] = 1;
+    c.phases = 1;
+    c.seed = 1;
+    c.runner = argv[0];
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        bool ok = value != NULL;
+        if (strcmp(argv[i], "-n") == 0 && ok) {
+            c.jobs = atoi(value);
+        } else if (strcmp(argv[i], "--format") == 0 && ok) {
+            if (strcmp(value, "profile") == 0) c.format = FORMAT_PROFILE;
+            else if (strcmp(value, "stdin") == 0) c.format = FORMAT_STDIN;
+            else if (strcmp(value, "offline") == 0) c.format = FORMAT_OFFLINE;
+            else ok = false;
+        } else if (strcmp(argv[i], "--arrival") == 0 && ok) {
+            ok = parse_arrival(&c, value);
+        } else if (strcmp(argv[i], "--duration") == 0 && ok) {
+            ok = parse_duration(&c, value);
+        } else if (strcmp(argv[i], "--max") == 0 && ok) {
+            c.max_ms = atof(value);
+        } else if (strcmp(argv[i], "--mix") == 0 && ok) {
+            char spec[256];
+            strncpy(spec, value, sizeof(spec) - 1);
+            spec[sizeof(spec) - 1] = '\0';
+            ok = parse_mix(&c, spec);
+        } else if (strcmp(argv[i], "--phases") == 0 && ok) {
+            c.phases = atoi(value);
+            ok = c.phases >= 1 && c.phases <= MAX_PHASES;
+        } else if (strcmp(argv[i], "--seed") == 0 && ok) {
+            c.seed = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--runner") == 0 && ok) {
+            c.runner = value;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Invalid option: %s%s%s (see the top of workload_gen.c)\n", argv[i],
+                    value ? " " : "", value ? value : "");
+            return 1;
+        }
+        i++;
+    }
+
+    generate(&c);
+    return 0;
+}